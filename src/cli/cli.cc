@@ -529,7 +529,7 @@ namespace PeterDB {
     }
 
     RC CLI::run(Iterator *it) {
-        void *data = malloc(PAGE_SIZE);
+        void *data = malloc(MAX_PAGE_SIZE);
         std::vector <Attribute> attrs;
         std::vector <std::string> outputBuffer;
         it->getAttributes(attrs);
@@ -605,7 +605,7 @@ namespace PeterDB {
 
         Value value;
         value.type = attr.type;
-        value.data = malloc(PAGE_SIZE);
+        value.data = malloc(MAX_PAGE_SIZE);
         token = next();
         attribute = std::string(token);
 
@@ -948,7 +948,7 @@ namespace PeterDB {
         // Set up the iterator
         RM_ScanIterator rmsi;
         RID rid;
-        void *data_returned = malloc(PAGE_SIZE);
+        void *data_returned = malloc(MAX_PAGE_SIZE);
 
         // convert attributes to vector<string>
         std::vector <std::string> stringAttributes;
@@ -1002,7 +1002,7 @@ namespace PeterDB {
         // Set up the iterator
         Attribute attr;
         RM_ScanIterator rmsi;
-        void *data_returned = malloc(PAGE_SIZE);
+        void *data_returned = malloc(MAX_PAGE_SIZE);
 
         // convert attributes to vector<string>
         std::vector <std::string> stringAttributes;
@@ -1167,8 +1167,8 @@ namespace PeterDB {
         this->getAttributesFromCatalog(tableName, attributes);
         uint offset = 0, index = 0, keyIndex = 0;
         uint length;
-        void *buffer = malloc(PAGE_SIZE);
-        void *key = malloc(PAGE_SIZE);
+        void *buffer = malloc(MAX_PAGE_SIZE);
+        void *key = malloc(MAX_PAGE_SIZE);
         RID rid;
 
         // find out if there is any index for tableName
@@ -1176,7 +1176,7 @@ namespace PeterDB {
         for (uint i = 0; i < attributes.size(); i++) {
             if (this->checkAttribute(tableName, attributes.at(i).name, rid, false))
                 // add index to index-map
-                indexMap[i] = malloc(PAGE_SIZE);
+                indexMap[i] = malloc(MAX_PAGE_SIZE);
         }
 
         // read file
@@ -1286,9 +1286,9 @@ namespace PeterDB {
         this->getAttributesFromCatalog(tableName, attributes);
         int offset = 0, index = 0;
         int length;
-        void *buffer = malloc(PAGE_SIZE);
-        memset(buffer, 0, PAGE_SIZE);
-        void *key = malloc(PAGE_SIZE);
+        void *buffer = malloc(MAX_PAGE_SIZE);
+        memset(buffer, 0, MAX_PAGE_SIZE);
+        void *key = malloc(MAX_PAGE_SIZE);
         RID rid;
 
         // find out if there is any index for tableName
@@ -1296,7 +1296,7 @@ namespace PeterDB {
         for (uint i = 0; i < attributes.size(); i++) {
             if (this->checkAttribute(tableName, attributes.at(i).name, rid, false))
                 // add index to index-map
-                indexMap[i] = malloc(PAGE_SIZE);
+                indexMap[i] = malloc(MAX_PAGE_SIZE);
         }
 
         // Assume that we don't have any NULL values when inserting data.
@@ -1426,7 +1426,7 @@ namespace PeterDB {
 
         std::vector <std::string> outputBuffer;
         RID rid;
-        char key[PAGE_SIZE];
+        char key[MAX_PAGE_SIZE];
 
         outputBuffer.emplace_back("PageNum");
         outputBuffer.emplace_back("SlotNum");
@@ -1737,7 +1737,7 @@ namespace PeterDB {
 
         // Set up the iterator
         RM_ScanIterator rmsi;
-        void *data_returned = malloc(PAGE_SIZE);
+        void *data_returned = malloc(MAX_PAGE_SIZE);
 
         // convert attributes to vector<string>
         std::vector <std::string> stringAttributes;
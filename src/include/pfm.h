@@ -1,9 +1,45 @@
 #ifndef _pfm_h_
 #define _pfm_h_
 
+// Default page size; a file can pick any power of two from MIN_PAGE_SIZE to MAX_PAGE_SIZE at createFile
 #define PAGE_SIZE 4096
+#define MIN_PAGE_SIZE 4096
+#define MAX_PAGE_SIZE 65536
+
+// A write-ahead log longer than this is shortened by the next commit: records covered by a fuzzy checkpoint
+// are dropped, and if that is not enough the file is checkpointed
+#define WAL_CHECKPOINT_BYTES (64u << 20)
+
+// Most pages a background flusher writes in one round
+#define FLUSH_BATCH_PAGES 32
+
+// Largest sequential read-ahead window of a handle, in pages
+#define READ_AHEAD_PAGES 64
+
+// Submission queue entries of a handle's io_uring; larger batches are submitted in parts
+#define IO_URING_DEPTH 64
+
+// Alignment of the memory, file offsets and lengths of IO_DIRECT transfers; pool frames and scratch
+// buffers are allocated on this boundary
+#define DIRECT_IO_ALIGNMENT 4096
+
+// Default number of frames in the shared buffer pool (256 frames = 1 MB of default-size pages)
+#define DEFAULT_BUFFER_FRAMES 256
+
+// Space map value of a reserved page, e.g. one holding overflow data; it never receives inserts.
+// Other values count a data page's free space in pageSize / 256 byte steps.
+#define SPACE_MAP_RESERVED 255
 
 #include <string>
+#include <cstdio>
+#include <sys/types.h>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <condition_variable>
+#include <memory>
 
 namespace PeterDB
 {
@@ -11,16 +47,46 @@ namespace PeterDB
     typedef unsigned PageNum;
     typedef int RC;
 
+    // How a FileHandle talks to its file
+    typedef enum
+    {
+        IO_POSIX = 0, // pread/pwrite on a raw file descriptor, no shared seek position
+        IO_STDIO,     // fseek + fread/fwrite on a FILE *
+        IO_DIRECT     // like IO_POSIX, but whole pages bypass the kernel page cache (O_DIRECT)
+    } IOMode;
+
+    // When page writes are forced to stable storage
+    typedef enum
+    {
+        DURABILITY_PER_WRITE = 0, // every writePage/appendPage reaches the disk before returning
+        DURABILITY_GROUP_COMMIT,  // sync after N changed pages or N milliseconds
+        DURABILITY_ON_CLOSE,      // sync only at closeFile or an explicit FileHandle::sync()
+        DURABILITY_WAL            // changed pages go to a write-ahead log; commit() flushes the log sequentially
+    } DurabilityMode;
+
+    // How batches of page reads and writes are issued (IO_POSIX and IO_DIRECT handles)
+    typedef enum
+    {
+        IO_ENGINE_PREAD = 0, // one pread/pwrite after the other
+        IO_ENGINE_URING      // the whole batch is submitted to an io_uring and completes in parallel
+    } IOEngine;
+
     class FileHandle;
+    class IORing;
+
+    // CRC32C (Castagnoli) of a buffer; uses the CPU's CRC32 instruction when there is one
+    unsigned crc32c(const void *data, size_t length);
 
     class PagedFileManager
     {
     public:
         static PagedFileManager &instance(); // Access to the singleton instance
 
-        RC createFile(const std::string &fileName);                       // Create a new file
+        RC createFile(const std::string &fileName,
+                      unsigned pageSize = PAGE_SIZE);                     // Create a new file
         RC destroyFile(const std::string &fileName);                      // Destroy a file
-        RC openFile(const std::string &fileName, FileHandle &fileHandle); // Open a file
+        RC openFile(const std::string &fileName, FileHandle &fileHandle,
+                    IOMode ioMode = IO_POSIX);                            // Open a file
         RC closeFile(FileHandle &fileHandle);                             // Close a file
 
     protected:
@@ -30,6 +96,146 @@ namespace PeterDB
         PagedFileManager &operator=(const PagedFileManager &); // Prevent assignment
     };
 
+    // Process-wide pool of page frames shared by every open FileHandle.
+    // Frames are looked up by (file id, physical page number), replaced with the clock
+    // algorithm and written back to disk only when a dirty frame is evicted or its file is closed.
+    // A miss reserves its frame under the latch and reads the page without it, and flushes mark their
+    // frames the same way before writing them, so only the threads that want the same page wait for the I/O.
+    class BufferManager
+    {
+    public:
+        static BufferManager &instance(); // Access to the singleton instance
+
+        RC setNumFrames(unsigned numFrames); // Resize the pool; fails while any page is pinned
+        unsigned getNumFrames();             // Get the number of frames in the pool
+
+        // Pin a page of the file into a frame and return a pointer to the frame.
+        // If loadFromDisk is false the caller promises to overwrite the whole frame.
+        RC pinPage(FileHandle &fileHandle, PageNum physicalPageNum, char *&frameData, bool loadFromDisk = true);
+        // Release a pinned page; lsn is the log record of the change when the file uses a write-ahead log
+        RC unpinPage(FileHandle &fileHandle, PageNum physicalPageNum, bool isDirty, unsigned long long lsn = 0);
+
+        RC flushPage(FileHandle &fileHandle, PageNum physicalPageNum); // Write back one frame if it is dirty
+        RC flushFile(FileHandle &fileHandle);     // Write back every dirty frame of the file
+        RC releaseFile(FileHandle &fileHandle);   // Flush, then drop the frames once no handle uses the file
+        void discardFile(const std::string &fileName); // Drop the frames of a file without writing them
+
+        unsigned registerFile(const std::string &fileName); // Map a file name to its pool-wide id
+        unsigned getOpenHandles(unsigned fileId);           // Handles registered on the file
+
+        // Read the physical pages that are not in the pool yet into unpinned frames with one batch. Under
+        // io_uring the batch is only submitted: its pages enter the pool as they arrive, picked up by the
+        // handle's next pins, and a pin of a page still in flight waits for it.
+        RC prefetchPages(FileHandle &fileHandle, const std::vector<PageNum> &physicalPageNums);
+        RC finishReadAhead(FileHandle &fileHandle); // Wait for the handle's batch in flight and pool its pages
+
+        // Background flushing (see PageFlusher). Only unpinned frames of handles with a file descriptor are
+        // written, and a frame with a logged change only once its log record is durable, so the log is never
+        // touched.
+        unsigned getDirtyFrames();
+        // Write up to maxPages dirty frames in (file, page) order, continuing the sweep of the last call.
+        // Unless urgent or a checkpoint is in progress, frames used since the clock last passed are skipped.
+        // The frames are picked under the latch and written without it; only pins of those pages wait.
+        RC flushDirtyFrames(unsigned maxPages, unsigned &pagesWritten, bool urgent = false);
+        unsigned takeBackgroundWrites(unsigned fileId); // Pages of the file written by the flusher since the last call
+        void logFlushed(FileHandle &fileHandle);        // The handle's log is durable up to its flushedLsn
+
+        // Fuzzy checkpoint: note the frames dirty now and, per file, the last LSN stamped on a frame. Once each
+        // noted frame has been written back the files are synced, and every log record up to that LSN
+        // describes a page that is on disk. Only one checkpoint is in progress at a time.
+        RC beginCheckpoint();
+        bool isCheckpointFlushed();
+        RC completeCheckpoint();
+        void abortCheckpoint();
+        unsigned long long getCheckpointLsn(unsigned fileId); // 0 until a checkpoint covered the file
+
+    protected:
+        BufferManager();                                 // Prevent construction
+        ~BufferManager();                                // Prevent unwanted destruction
+        BufferManager(const BufferManager &);            // Prevent construction by copying
+        BufferManager &operator=(const BufferManager &); // Prevent assignment
+
+    private:
+        struct Frame
+        {
+            char *data;         // PAGE_SIZE bytes of the pool, or its own buffer once it held a larger page
+            unsigned capacity;
+            FileHandle *owner;  // Handle used to write the frame back
+            unsigned fileId;
+            PageNum pageNum;    // Physical page number inside the file
+            unsigned pinCount;
+            unsigned long long lsn; // Page LSN: last logged change, which must be on disk before the page
+            unsigned long long writes; // Write-backs of the frame, so a checkpoint can tell it was written
+            bool logPending;    // Changed under DURABILITY_WAL but not logged yet
+            bool dirty;
+            bool referenced;    // Second-chance bit for the clock
+            bool valid;
+            bool loading;       // Being read from disk without the latch; pins of the page wait for it
+            bool writing;       // Being written back without the latch; pins of the page wait for it
+        };
+
+        std::vector<Frame> frames;
+        char *frameData;
+        unsigned clockHand;
+        std::unordered_map<unsigned long long, unsigned> pageTable; // (file id, page) -> frame index
+        std::unordered_map<std::string, unsigned> fileIds;
+        std::unordered_map<unsigned, unsigned> openHandles;         // file id -> number of open handles
+        // Frames an asynchronous batch of the handle is reading into, in batch order. They stay pinned and out
+        // of the page table until their page has arrived, so nothing else waits on another thread's ring.
+        std::unordered_map<FileHandle *, std::vector<unsigned>> readAheads;
+        std::mutex latch;
+        std::condition_variable ioDone; // Signalled when a frame finishes loading or being written back
+
+        // Page LSNs by file id: highest stamped on a frame, durable in the log, and covered by a checkpoint
+        std::unordered_map<unsigned, unsigned long long> stampedLsns, durableLsns, checkpointLsns;
+        std::unordered_map<unsigned, unsigned> backgroundWrites;
+        unsigned long long sweepKey; // Last frame key written by flushDirtyFrames
+        struct CheckpointPage
+        {
+            unsigned frameIndex;
+            unsigned long long key;
+            unsigned long long writes;
+        };
+        std::vector<CheckpointPage> checkpointPages; // Frames dirty when the checkpoint began, not written since
+        std::unordered_map<unsigned, unsigned long long> checkpointTargets; // File id -> LSN the checkpoint covers
+        bool checkpointPending;
+
+        static unsigned long long frameKey(unsigned fileId, PageNum pageNum);
+        RC allocateFrames(unsigned numFrames);
+        void freeFrames();
+        RC fitFrame(Frame &frame, unsigned pageSize);
+        RC findVictim(unsigned &frameIndex);
+        RC writeBack(Frame &frame);
+        bool canWriteInBackground(const Frame &frame);
+        void waitForWrites(std::unique_lock<std::mutex> &lock, unsigned fileId); // fileId 0 waits for every file
+        RC prefetchLocked(FileHandle &fileHandle, const std::vector<PageNum> &physicalPageNums,
+                          std::unique_lock<std::mutex> &lock);
+        RC collectReadAhead(FileHandle &fileHandle, std::unique_lock<std::mutex> &lock, bool wait);
+        bool isReadingAhead(FileHandle &fileHandle, PageNum physicalPageNum);
+        void forgetFile(unsigned fileId);
+    };
+
+    // Scratch memory for one operation: a buffer of at least the requested size is borrowed from a
+    // pool owned by the calling thread and given back when the ScratchBuffer goes out of scope.
+    // Returned buffers are kept for the next caller, so once a thread has warmed up its pool, code
+    // that needs a page image or a record image for the length of a call does no heap allocation.
+    // Buffers start on DIRECT_IO_ALIGNMENT, so a page image reaches an IO_DIRECT file without a copy.
+    class ScratchBuffer
+    {
+    public:
+        explicit ScratchBuffer(size_t size, bool zeroed = false); // Every buffer holds at least PAGE_SIZE bytes
+        ~ScratchBuffer();
+
+        ScratchBuffer(const ScratchBuffer &) = delete;
+        ScratchBuffer &operator=(const ScratchBuffer &) = delete;
+
+        char *data() const { return buffer; }
+
+    private:
+        char *buffer;
+        size_t capacity;
+    };
+
     class FileHandle
     {
     public:
@@ -37,8 +243,46 @@ namespace PeterDB
         unsigned readPageCounter;
         unsigned writePageCounter;
         unsigned appendPageCounter;
-        FILE *file_pointer;
+        FILE *file_pointer; // Used in IO_STDIO mode
+        int fd;             // Used in IO_POSIX and IO_DIRECT mode; opened with O_DIRECT in the latter
+        int metaFd;         // IO_DIRECT only: a buffered descriptor for transfers smaller than a block
+        IOMode ioMode;
         std::string fileName;
+        unsigned fileId; // Id of the file inside the buffer pool
+        unsigned numberOfPages;
+        unsigned formatTag; // Kept in the hidden page for the layer above, e.g. its page layout; 0 by default
+        unsigned writeGeneration; // Bumped by every change of a data page and kept in the hidden page, so a
+                                  // summary saved by the layer above can tell whether the file changed since
+        unsigned pageSize;  // Fixed when the file is created and kept in the hidden page
+        unsigned checksums; // 1 when every page has a checksum, i.e. the file was created with checksum pages
+        bool verifyChecksums;       // Check every page read from disk against its checksum; on by default
+        unsigned checksumFailures;  // Pages that did not match their checksum since the file was opened
+        unsigned checksumRepairs;   // Checksums rewritten when the file was opened after an unclean shutdown
+        bool unclean;               // This handle has set the hidden page's unclean flag and not cleared it yet
+        unsigned readAheadLimit;    // Largest read-ahead window in pages, 0 = off; READ_AHEAD_PAGES by default
+        unsigned readAheadWindow;   // Grows while the physical reads stay sequential
+        PageNum lastPhysicalRead;
+        unsigned sequentialReads;   // Physical reads in a row that followed the one before
+        PageNum readAheadEnd;       // First physical page after the pages already asked for
+        unsigned pagesReadAhead;    // Pages asked for ahead of the reads since the file was opened
+        std::vector<PageNum> prefetchQueue; // Physical pages read ahead into the pool after the current miss
+        IOEngine ioEngine;
+        std::shared_ptr<IORing> ring; // Set while ioEngine is IO_ENGINE_URING
+        unsigned headerFlushInterval;
+        unsigned ioSinceHeaderFlush;
+        std::vector<int> spaceMapMax; // Largest free-space byte of each space map page, -1 if unknown
+        DurabilityMode durability;
+        unsigned groupCommitPages;
+        unsigned groupCommitMs;
+        unsigned pagesSinceSync;
+        unsigned syncedWrites;              // writePageCounter + appendPageCounter when the file was last synced
+        std::chrono::steady_clock::time_point lastSync;
+        int logFd;                          // <fileName>.wal while the handle uses DURABILITY_WAL, -1 otherwise
+        std::vector<char> logBuffer;        // Log records not written to the log yet
+        std::unordered_map<PageNum, size_t> logSlots; // Physical page -> its record in logBuffer
+        unsigned long long nextLsn;
+        unsigned long long flushedLsn;      // Every record up to this LSN is on stable storage
+        size_t logLimit;                    // WAL_CHECKPOINT_BYTES unless set with setLogLimit
 
         FileHandle();  // Default constructor
         ~FileHandle(); // Destructor
@@ -47,22 +291,194 @@ namespace PeterDB
         RC writePage(PageNum pageNum, const void *data); // Write a specific page
         RC appendPage(const void *data);                 // Append a specific page
         unsigned getNumberOfPages();                     // Get the number of pages in the file
+        unsigned getPageSize();                          // Bytes per page; readPage and writePage move this many
         RC collectCounterValues(unsigned &readPageCount, unsigned &writePageCount,
                                 unsigned &appendPageCount); // Put current counter values into variables
-        int getReadPageCount();
-        RC setReadPageCount(unsigned readPageCnt);
-        int getWritePageCount();
-        RC setWritePageCount(unsigned writePageCnt);
-        int getAppendPageCount();
-        RC setAppendPageCount(unsigned appendPageCnt);
-        RC setTotalPageCount(unsigned numOfPages);
+
+        // Pin a page in the buffer pool and access it in place; every pin needs a matching unpin
+        RC pinPage(PageNum pageNum, char *&data);
+        RC unpinPage(PageNum pageNum, bool isDirty);
+
+        // Free-space map kept in hidden pages; getNumberOfPages() and page numbers never include them
+        RC setFreeSpace(PageNum pageNum, unsigned freeBytes);
+        RC findPageWithFreeSpace(unsigned bytesNeeded, PageNum &pageNum);
+        // Reserved pages are skipped by findPageWithFreeSpace until setFreeSpace is called on them again;
+        // readers can test for them through the space map without reading the page itself
+        RC setPageReserved(PageNum pageNum);
+        RC isPageReserved(PageNum pageNum, bool &reserved);
+        // The flags of every existing page in the space map group of pageNum, from one pin of its map page;
+        // reserved[i] belongs to page firstPageNum + i
+        RC getReservedPages(PageNum pageNum, PageNum &firstPageNum, std::vector<bool> &reserved);
+
+        // Durability policy; the default is DURABILITY_ON_CLOSE.
+        // sync() writes back every dirty page and the hidden page and forces them to disk.
+        // closeFile() is a sync point in every mode, unless no page was written since the last sync.
+        RC setDurability(DurabilityMode mode, unsigned groupCommitPages = 0, unsigned groupCommitMs = 0);
+        DurabilityMode getDurability();
+        RC sync();
+        RC syncDescriptor();
+
+        // Write-ahead log (DURABILITY_WAL). Every change of a page adds a redo record holding the whole page
+        // image and the page count; changes of the same page between two commits share one record.
+        // commit() makes the changes so far durable with one sequential log write and one sync; the pages
+        // stay in the pool. sync() and closeFile() write the pages back and empty the log, and openFile()
+        // replays a log left behind by a crash.
+        RC commit();
+        RC flushLog(unsigned long long lsn); // Make the log durable up to lsn; used before a page is written back
+        void setLogLimit(size_t bytes);      // Log size past which commit() shortens the log
+
+        // Physical page I/O used by the buffer pool; page numbers include the hidden page.
+        // Writes store the page checksum; reads verify it unless verification is off, and fail on a mismatch.
+        RC readPhysicalPage(PageNum physicalPageNum, void *data);
+        // A background write leaves the counters and the hidden page to the pool and the handle's own thread.
+        RC writePhysicalPage(PageNum physicalPageNum, const void *data, bool background = false);
+
+        void setChecksumVerification(bool enabled);
+        void setReadAhead(unsigned maxPages); // Largest read-ahead window; 0 turns read-ahead off
+
+        // Batched page I/O. With IO_ENGINE_URING a batch is submitted at once and many pages are in flight;
+        // read-ahead then reads its window into the pool instead of the page cache, without waiting for it.
+        // Asking for it succeeds on kernels without io_uring too, and getIOEngine() tells which engine is in use.
+        RC setIOEngine(IOEngine engine);
+        IOEngine getIOEngine();
+        RC readPhysicalPages(const std::vector<PageNum> &physicalPageNums, const std::vector<char *> &buffers);
+        RC writePhysicalPages(const std::vector<PageNum> &physicalPageNums, const std::vector<char *> &buffers);
+        RC prefetchPages(const std::vector<PageNum> &pageNums); // Bring pages into the pool ahead of a pin
+        // Asynchronous batch read through the ring: startPhysicalReads submits the pages and returns at once.
+        // finishPhysicalReads reports, by index in the batch, the pages that arrived since the last call and
+        // whether they match their checksums; with wait it returns once the whole batch is in.
+        RC startPhysicalReads(const std::vector<PageNum> &physicalPageNums, const std::vector<char *> &buffers);
+        RC finishPhysicalReads(bool wait, std::vector<size_t> &readPages, std::vector<size_t> &failedPages);
+        bool physicalReadsPending();
+        bool isChecksumPage(PageNum physicalPageNum); // Checksum pages carry no checksum of their own
+        // Read a physical page and compare it with its checksum without counting a page read
+        RC checkPhysicalPage(PageNum physicalPageNum, void *data, bool &intact);
+
+        // The hidden page is loaded once when the file is opened and kept in memory.
+        // It is written back at closeFile(), at checkpoint(), or every headerFlushInterval page I/Os.
+        RC checkpoint();                              // Persist the page count and counters now
+        void setHeaderFlushInterval(unsigned numOfIOs); // 0 = only at close and checkpoint
+        RC readHiddenPage();
+        RC writeHiddenPage();
         RC initializeHiddenPage();
-        void setOpenFile(FILE *pFile);
+        RC setOpenFile(FILE *pFile);
+        bool isOpen();
+        void closeDescriptor();
+        RC recoverLog();          // Replay <fileName>.wal left behind by a crash, then remove it
+        // A file with checksums is flagged unclean in its hidden page before the first page of a session is
+        // written. A crash between a page write and its checksum write leaves the flag set, and the first
+        // open after it rewrites the checksums that do not match. The last handle to close clears the flag.
+        RC repairChecksums();
+        RC markClean();
+        RC closeLog(bool remove); // Stop logging; remove the log only once the pages are on disk
         FILE *getFile();
         std::string getFileName();
         void setFileName(const std::string &fileName);
+
+    private:
+        void headerChanged();
+        RC markUnclean();
+        void readAhead(PageNum physicalPageNum);
+        RC applyDurability(PageNum physicalPageNum, bool buffered, const void *image = nullptr);
+        RC logPage(PageNum physicalPageNum, const void *image, unsigned long long &lsn);
+        RC compactLog(unsigned long long checkpointLsn);
+        RC openLog();
+        PageNum physicalPageNum(PageNum pageNum);
+        PageNum spaceMapPageNum(PageNum pageNum);
+        unsigned groupPages();
+        off_t checksumOffset(PageNum physicalPageNum);
+        RC storeChecksum(PageNum physicalPageNum, const void *data);
+        RC readChecksum(PageNum physicalPageNum, unsigned &checksum);
+        RC verifyChecksum(PageNum physicalPageNum, const void *data);
+        RC setSpaceMapEntry(PageNum pageNum, unsigned char category);
+        RC readBytes(off_t offset, void *buffer, size_t length);
+        RC writeBytes(off_t offset, const void *buffer, size_t length);
+        RC directBytes(off_t offset, void *buffer, size_t length, bool write);
+        bool canBatch(const std::vector<char *> &buffers);
+    };
+
+    // What a scrubber has found so far
+    typedef struct {
+        unsigned passes;                    // Complete passes over the file
+        unsigned pagesChecked;
+        std::vector<PageNum> corruptPages;  // Physical page numbers whose content does not match its checksum
+    } ScrubStats;
+
+    // Background scrubber: a thread that reads every page of a file from its own descriptor and checks it
+    // against its checksum, at most pagesPerSecond pages per second. It never goes through the buffer pool
+    // and never writes the file, so it can run next to open handles. A mismatch is read again after a
+    // short pause before it is reported, since a page may be caught between its write and its checksum.
+    class PageScrubber
+    {
+    public:
+        PageScrubber();
+        ~PageScrubber(); // Stops the thread
+
+        RC start(const std::string &fileName, unsigned pagesPerSecond, bool repeat = false);
+        RC stop();     // Stop the thread and wait for it
+        RC wait();     // Wait for a single-pass scrubber to finish
+        bool isRunning();
+        void getStats(ScrubStats &stats);
+
+    private:
+        PageScrubber(const PageScrubber &);
+        PageScrubber &operator=(const PageScrubber &);
+
+        void run(std::string fileName, unsigned pagesPerSecond, bool repeat);
+        bool pause(std::chrono::steady_clock::time_point until); // false once a stop was asked for
+
+        std::thread worker;
+        std::mutex latch;
+        std::condition_variable wakeup;
+        bool stopRequested;
+        bool running;
+        ScrubStats stats;
+    };
+
+    // Knobs of a background page flusher
+    typedef struct {
+        unsigned pagesPerSecond;   // Trickle rate while the pool is below the high-water mark
+        unsigned highWaterPercent; // Share of dirty frames that makes the flusher write at full speed...
+        unsigned lowWaterPercent;  // ...until the share is back down to this
+        unsigned checkpointMs;     // Time between fuzzy checkpoints, 0 = none
+    } FlusherOptions;
+
+    typedef struct {
+        unsigned long long pagesWritten;
+        unsigned checkpoints; // Completed fuzzy checkpoints
+    } FlusherStats;
+
+    // Background page flusher: a thread that writes dirty frames of the buffer pool back in page order, so
+    // that foreground inserts find clean victims instead of writing pages themselves. Below the high-water
+    // mark it trickles at pagesPerSecond; above it, it writes batches back to back down to the low-water
+    // mark. Every checkpointMs it takes a fuzzy checkpoint, which lets commit() drop old log records instead
+    // of writing every page back itself. Run at most one flusher per process.
+    class PageFlusher
+    {
+    public:
+        PageFlusher();
+        ~PageFlusher(); // Stops the thread
+
+        RC start(const FlusherOptions &options);
+        RC stop(); // Stop the thread and wait for it
+        bool isRunning();
+        void getStats(FlusherStats &stats);
+
+    private:
+        PageFlusher(const PageFlusher &);
+        PageFlusher &operator=(const PageFlusher &);
+
+        void run(FlusherOptions options);
+        bool pause(std::chrono::steady_clock::time_point until); // false once a stop was asked for
+
+        std::thread worker;
+        std::mutex latch;
+        std::condition_variable wakeup;
+        bool stopRequested;
+        bool running;
+        FlusherStats stats;
     };
 
 } // namespace PeterDB
 
-#endif // _pfm_h_
\ No newline at end of file
+#endif // _pfm_h_
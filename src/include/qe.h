@@ -107,7 +107,7 @@ namespace PeterDB {
         std::string tableName;
         std::string attrName;
         std::vector<Attribute> attrs;
-        char key[PAGE_SIZE];
+        char key[MAX_PAGE_SIZE];
         RID rid;
     public:
         IndexScan(RelationManager &rm, const std::string &tableName, const std::string &attrName,
@@ -2,9 +2,21 @@
 #define _rbfm_h_
 
 #include <vector>
+#include <cstring>
 
 #include "pfm.h"
 #include <map>
+#include <unordered_map>
+
+// Data pages summarised by one zone-map extent
+#define ZONE_MAP_EXTENT_PAGES 16
+// Leading bytes of a VarChar value kept in a zone map
+#define ZONE_MAP_PREFIX_SIZE 8
+// A record too large for a page keeps its longest VarChar values on chained overflow pages. Such a
+// value leaves its first OVERFLOW_PREFIX_SIZE bytes in the record, and its field-end directory entry
+// carries OVERFLOW_FIELD_FLAG.
+#define OVERFLOW_PREFIX_SIZE 16
+#define OVERFLOW_FIELD_FLAG 0x40000000
 
 namespace PeterDB {
     // Record ID
@@ -26,6 +38,12 @@ namespace PeterDB {
         AttrLength length; // attribute length
     } Attribute;
 
+    // How the records of a file are laid out on its pages; kept in the file's hidden page
+    typedef enum {
+        LAYOUT_NSM = 0, // Row by row: every record is stored contiguously behind a slot directory
+        LAYOUT_PAX      // Column by column within a page: every attribute has its own minipage
+    } PageLayout;
+
     // Comparison Operator (NOT needed for part 1 of the project)
     typedef enum {
         EQ_OP = 0, // no condition// =
@@ -38,6 +56,180 @@ namespace PeterDB {
     } CompOp;
 
 
+    //  RecordView is a read-only view of a stored record inside a pinned page.
+    //  Fields are reached through the record's offset directory, so nothing is copied or allocated.
+    //  A view filled by RecordBasedFileManager::readRecordView() keeps the page pinned until
+    //  release() is called or the view is destroyed; a view filled by a scan iterator is only
+    //  valid until the next call on that iterator.
+    class RecordView {
+    public:
+        RecordView();
+
+        ~RecordView();
+
+        RecordView(const RecordView &) = delete;
+        RecordView &operator=(const RecordView &) = delete;
+
+        bool isValid() const { return record != nullptr; }
+
+        unsigned getNumFields() const { return numFields; }
+
+        bool isNull(unsigned fieldIndex) const {
+            return nullIndicator[fieldIndex / 8] & (1 << (7 - fieldIndex % 8));
+        }
+
+        int getInt(unsigned fieldIndex) const {
+            int value;
+            memcpy(&value, record + fieldStart(fieldIndex), sizeof(int));
+            return value;
+        }
+
+        float getReal(unsigned fieldIndex) const {
+            float value;
+            memcpy(&value, record + fieldStart(fieldIndex), sizeof(float));
+            return value;
+        }
+
+        // Characters of a VarChar field; they are not null-terminated. For a value kept on overflow
+        // pages only its first OVERFLOW_PREFIX_SIZE characters are in the record and returned here.
+        const char *getVarChar(unsigned fieldIndex, unsigned &length) const {
+            unsigned start = fieldStart(fieldIndex);
+            length = isOverflow(fieldIndex) ? OVERFLOW_PREFIX_SIZE : fieldEnd(fieldIndex) - start;
+            return record + start;
+        }
+
+        // True when a VarChar value is kept on overflow pages; readAttribute() returns all of it
+        bool isOverflow(unsigned fieldIndex) const {
+            int end;
+            memcpy(&end, directory + fieldIndex * sizeof(int), sizeof(int));
+            return end & OVERFLOW_FIELD_FLAG;
+        }
+
+        // Raw stored bytes of the record
+        const char *getData() const { return record; }
+
+        RC release(); // Unpin the page, if this view pinned it
+
+    private:
+        friend class RecordBasedFileManager;
+        friend class RBFM_ScanIterator;
+
+        const char *record;
+        unsigned numFields;
+        const char *nullIndicator;
+        const char *directory;      // numFields field-end offsets
+        FileHandle *fileHandle;     // Set when the view owns a pin
+        PageNum pageNum;
+
+        void attach(const char *recordPtr);
+
+        unsigned fieldEnd(unsigned fieldIndex) const {
+            int end;
+            memcpy(&end, directory + fieldIndex * sizeof(int), sizeof(int));
+            return end & ~OVERFLOW_FIELD_FLAG;
+        }
+
+        unsigned fieldStart(unsigned fieldIndex) const {
+            return fieldIndex == 0 ? (unsigned) (directory + numFields * sizeof(int) - record) : fieldEnd(fieldIndex - 1);
+        }
+    };
+
+    // What a vacuum did to a file
+    typedef struct {
+        unsigned pagesBefore;       // Data pages before the vacuum
+        unsigned pagesAfter;        // Data pages after the vacuum
+        unsigned pagesReclaimed;    // Pages given back: removed from the file, or left empty by an online vacuum
+        unsigned recordsMoved;      // Records rewritten (offline) or brought back to their home page (online)
+        double elapsedMs;
+    } VacuumStats;
+
+    // Smallest and largest non-null value of one column over an extent. Int and Real values are kept
+    // exactly; VarChar values by their first ZONE_MAP_PREFIX_SIZE bytes, zero-padded.
+    typedef struct {
+        int hasValue;                       // 0 while the extent has no non-null value of the column
+        char min[ZONE_MAP_PREFIX_SIZE];
+        char max[ZONE_MAP_PREFIX_SIZE];
+    } ZoneEntry;
+
+    //  ZoneMap keeps a min/max summary per column for every extent of ZONE_MAP_EXTENT_PAGES data pages.
+    //  Inserts and updates widen it; deletes leave it alone, so it can only be too wide, never too narrow.
+    //  A conditional scan skips the extents whose summary rules the condition out.
+    //  It is stored next to the data file while the file is closed and dropped from disk on open,
+    //  so a crash leaves no stale summary behind; a missing summary is rebuilt by the next conditional scan.
+    class ZoneMap {
+    public:
+        ZoneMap();
+
+        bool isValid() const { return valid; }
+
+        // Widen the extent of pageNum with the fields of a stored record
+        void note(PageNum pageNum, const std::vector<Attribute> &recordDescriptor, const char *recordPtr);
+
+        // False when no record of the extent can satisfy "column compOp value"
+        bool mayMatch(PageNum pageNum, unsigned columnIndex, AttrType type, CompOp compOp, const void *value) const;
+
+        RC rebuild(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor);
+
+        // The saved map is only trusted while the file still has the page count and write generation it was saved with
+        RC load(const std::string &fileName, unsigned numberOfPages, unsigned writeGeneration);
+        RC save(const std::string &fileName, unsigned numberOfPages, unsigned writeGeneration);
+
+    private:
+        friend class RecordBasedFileManager;
+
+        unsigned openCount;     // Handles of the file opened through the record-based file manager
+        bool valid;
+        std::vector<std::vector<ZoneEntry>> extents; // extent -> column -> summary
+    };
+
+    //  RecordCodec converts records of one descriptor between the API format and the stored format.
+    //  The layout is worked out once: the null-indicator byte and mask of every field, which fields
+    //  are VarChar, and, when there is no VarChar at all, the field-end directory and data size of a
+    //  record without nulls. Such a record is then converted with a few block copies.
+    //  Only the types and lengths of the descriptor matter, not the attribute names.
+    class RecordCodec {
+    public:
+        RecordCodec();
+
+        explicit RecordCodec(const std::vector<Attribute> &recordDescriptor);
+
+        // True when the codec was built for a descriptor with these types and lengths
+        bool matches(const std::vector<Attribute> &recordDescriptor) const;
+
+        unsigned getNumFields() const { return fields.size(); }
+
+        // Largest stored size of a record
+        unsigned getMaxRecordSize() const { return maxRecordSize; }
+
+        // Convert a record from the API format into the stored format; returns the stored size
+        unsigned encode(const void *data, char *image) const;
+
+        // Convert a stored record back into the API format; returns the size written, or -1. Values
+        // kept on overflow pages are read through fileHandle.
+        int decode(const char *image, void *data, FileHandle *fileHandle = nullptr) const;
+
+        // Print a record in the API format as "name: value, ..."; names come from the descriptor
+        void print(const std::vector<Attribute> &recordDescriptor, const void *data, std::ostream &out) const;
+
+    private:
+        typedef struct {
+            AttrType type;
+            AttrLength length;
+            unsigned nullByte;      // Byte of the null indicator holding the field's bit
+            unsigned char nullMask;
+        } FieldLayout;
+
+        std::vector<FieldLayout> fields;
+        unsigned nullIndicatorSize;
+        unsigned headerSize;            // Field count, null indicator and field-end directory
+        unsigned maxRecordSize;
+        bool fixedOnly;                 // No VarChar field
+        std::vector<int> fixedEnds;     // fixedOnly: field-end directory of a record without nulls
+        unsigned fixedDataSize;         // fixedOnly: data bytes of a record without nulls
+
+        bool hasNulls(const char *nullIndicator) const;
+    };
+
     /********************************************************************
     * The scan iterator is NOT required to be implemented for Project 1 *
     ********************************************************************/
@@ -56,27 +248,74 @@ namespace PeterDB {
 
     class RBFM_ScanIterator {
     public:
-        RBFM_ScanIterator() = default;;
+        RBFM_ScanIterator();
 
-        ~RBFM_ScanIterator() = default;;
+        ~RBFM_ScanIterator();
 
         // Never keep the results in the memory. When getNextRecord() is called,
         // a satisfying record needs to be fetched from the file.
         // "data" follows the same format as RecordBasedFileManager::insertRecord().
-        RC getNextRecord(RID &rid, void *data) { return RBFM_EOF; };
-
-        RC close() { return -1; };
+        RC getNextRecord(RID &rid, void *data);
+
+        // Like getNextRecord(), but hand out a view of the stored record instead of a copy.
+        // The condition is applied; the projection is not.
+        RC getNextRecordView(RID &rid, RecordView &view);
+
+        // Return up to maxRows satisfying records in one call, possibly from several pages.
+        // The records are packed back to back into "data" in the getNextRecord() format; record i
+        // starts at offsets[i] and offsets[rids.size()] is the total size. The batch stops early
+        // when bufferSize could not hold another record. Returns RBFM_EOF when nothing is left.
+        RC getNextBatch(std::vector<RID> &rids, void *data, unsigned maxRows, unsigned bufferSize,
+                        std::vector<unsigned> &offsets);
+
+        // PAX files only, with exactly one projected attribute: return the satisfying values of the
+        // next page that has any, read straight from the attribute's minipage. Int and Real values
+        // are packed back to back (4 bytes each); VarChar values as [length][characters]. Null
+        // values are left out. Returns RBFM_EOF when nothing is left.
+        RC getNextColumnChunk(std::vector<RID> &rids, std::vector<char> &values);
+
+        RC close();
+
+    private:
+        friend class RecordBasedFileManager;
+
+        // The scan keeps exactly one page pinned and evaluates the condition on the stored
+        // record, so rejected records are never converted into the API format.
+        FileHandle *fileHandle;
+        unsigned pageSize;                  // Page size of the scanned file
+        std::vector<Attribute> recordDescriptor;
+        int conditionIndex;                 // -1 when there is no condition
+        CompOp compOp;
+        std::vector<char> value;            // Copy of the comparison value in the API format
+        std::vector<int> projectedIndexes;  // Descriptor index of every projected attribute
+        unsigned maxProjectedSize;          // Largest size a projected record can have
+        PageNum currentPage;
+        int currentSlot;
+        char *pageData;                     // Pinned frame of currentPage, nullptr if none
+        const ZoneMap *zoneMap;             // Used to skip extents, nullptr if there is none
+        PageNum reservedStart;              // First page of the space map group reservedPages covers
+        std::vector<bool> reservedPages;    // Overflow pages of that group, read once per group
+        bool paxLayout;
+        std::vector<char> rowBuffer;        // PAX files: the current record rebuilt in the stored row format
+        RecordCodec codec;
+        bool fullProjection;                // Every attribute is projected in descriptor order
+
+        RC pinCurrentPage();
+        bool rowMatches(int rowIndex);
+        RC nextMatch(RID &rid, const char *&recordPtr);
     };
 
     class RecordBasedFileManager {
     public:
         static RecordBasedFileManager &instance();                          // Access to the singleton instance
 
-        RC createFile(const std::string &fileName);                         // Create a new record-based file
+        RC createFile(const std::string &fileName, PageLayout layout = LAYOUT_NSM,
+                      unsigned pageSize = PAGE_SIZE);                       // Create a new record-based file
 
         RC destroyFile(const std::string &fileName);                        // Destroy a record-based file
 
-        RC openFile(const std::string &fileName, FileHandle &fileHandle);   // Open a record-based file
+        RC openFile(const std::string &fileName, FileHandle &fileHandle,
+                    IOMode ioMode = IO_POSIX);                              // Open a record-based file
 
         RC closeFile(FileHandle &fileHandle);                               // Close a record-based file
 
@@ -99,12 +338,20 @@ namespace PeterDB {
         RC insertRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor, const void *data,
                         RID &rid);
 
-        
+        // Insert a batch of records by packing them into new pages; each new page is written once.
+        // rids receives one RID per record, in the order of the batch.
+        RC insertRecords(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                         const std::vector<const void *> &records, std::vector<RID> &rids);
+
 
         // Read a record identified by the given rid.
         RC
         readRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor, const RID &rid, void *data);
 
+        // Pin the page of a record and point the view at it; the page stays pinned until view.release().
+        // Not available for PAX files, whose pages do not hold whole records.
+        RC readRecordView(FileHandle &fileHandle, const RID &rid, RecordView &view);
+
         // Print the record that is passed to this utility method.
         // This method will be mainly used for debugging/testing.
         // The format is as follows:
@@ -129,6 +376,11 @@ namespace PeterDB {
         RC readAttribute(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor, const RID &rid,
                          const std::string &attributeName, void *data);
 
+        // Read several attributes of a record in one call. "data" gets a null indicator for the
+        // requested attributes followed by their values, in the order of attributeNames.
+        RC readAttributes(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor, const RID &rid,
+                          const std::vector<std::string> &attributeNames, void *data);
+
         // Scan returns an iterator to allow the caller to go through the results one by one.
         RC scan(FileHandle &fileHandle,
                 const std::vector<Attribute> &recordDescriptor,
@@ -138,6 +390,16 @@ namespace PeterDB {
                 const std::vector<std::string> &attributeNames, // a list of projected attributes
                 RBFM_ScanIterator &rbfm_ScanIterator);
 
+        // Online vacuum of an open file. RIDs do not change: moved records are brought back to their
+        // home page where it has room, every page is compacted and the free-space map is rebuilt.
+        RC vacuum(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor, VacuumStats &stats);
+
+        // Offline vacuum: rewrite the file densely into a new file that replaces it. The file must not
+        // be open. Records get new RIDs; ridMap receives one (old RID, new RID) pair per record so
+        // that indexes can be remapped.
+        RC vacuumFile(const std::string &fileName, const std::vector<Attribute> &recordDescriptor,
+                      std::vector<std::pair<RID, RID>> &ridMap, VacuumStats &stats);
+
 
     protected:
         RecordBasedFileManager();                                                   // Prevent construction
@@ -145,6 +407,14 @@ namespace PeterDB {
         RecordBasedFileManager(const RecordBasedFileManager &);                     // Prevent construction by copying
         RecordBasedFileManager &operator=(const RecordBasedFileManager &);          // Prevent assignment
 
+    private:
+        std::unordered_map<unsigned, ZoneMap> zoneMaps; // Buffer-pool file id -> zone map of the open file
+
+        std::vector<std::shared_ptr<const RecordCodec>> codecs; // Codecs of the descriptors seen recently
+        unsigned nextCodec;                 // Entry replaced once the cache is full
+
+        ZoneMap *getZoneMap(FileHandle &fileHandle);
+        std::shared_ptr<const RecordCodec> getCodec(const std::vector<Attribute> &recordDescriptor);
     };
 
 } // namespace PeterDB
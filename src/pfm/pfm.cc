@@ -1,11 +1,438 @@
 #include "src/include/pfm.h"
 #include "stdio.h"
 #include "unistd.h"
+#include <fcntl.h>
 #include <stdlib.h>
 #include <cstring>
+#include <algorithm>
+#include <new>
+#include <sys/stat.h>
+#include <cstddef>
+#include <cerrno>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#endif
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#define HAVE_IO_URING 1
+#endif
+#endif
 
 namespace PeterDB
 {
+    // Offset of the unclean flag in the hidden page, after the eight header fields before it
+    static const off_t UNCLEAN_FLAG_OFFSET = 8 * sizeof(unsigned);
+
+    // One transfer of a batch: length bytes at offset, into or out of buffer
+    struct IORequest
+    {
+        void *buffer;
+        size_t length;
+        off_t offset;
+        bool write;
+        int fd;
+        ssize_t result; // Bytes moved, or -errno
+    };
+
+    // A minimal io_uring driven through the raw system calls, so no library is needed. Each request is one
+    // readv/writev, which every kernel with io_uring supports. A ring belongs to one handle and is used by
+    // the thread that owns the handle. run() submits a batch and waits for it; submit() leaves a batch in
+    // flight, and reap() picks up its completions later, so the thread can go on while the pages arrive.
+    class IORing
+    {
+    public:
+        IORing();
+        ~IORing();
+
+        RC setup(unsigned entries);                        // Fails when the kernel has no io_uring
+        RC run(std::vector<IORequest> &requests); // Submit in parts of the queue size, wait for all
+
+        // One asynchronous batch of at most the queue size is in flight at a time. reap() hands out the index
+        // in batch of every request completed since the last call, and with wait returns once none is left.
+        RC submit(const std::vector<IORequest> &requests);
+        RC reap(bool wait, std::vector<size_t> &completed);
+        bool pending(); // Part of the batch is in flight or not handed out by reap() yet
+
+        std::vector<IORequest> batch; // The asynchronous batch; results are filled in as completions arrive
+
+    private:
+        IORing(const IORing &);
+        IORing &operator=(const IORing &);
+
+        int ringFd;
+        unsigned entries;
+        unsigned outstanding;        // Requests of the batch without a completion
+        std::vector<size_t> arrived; // Completions of the batch seen by run(), for the next reap()
+#ifdef HAVE_IO_URING
+        void *sqRing, *cqRing;
+        size_t sqRingSize, cqRingSize, sqesSize;
+        io_uring_sqe *sqes;
+        io_uring_cqe *cqes;
+        unsigned *sqTail, *sqMask, *sqArray, *cqHead, *cqTail, *cqMask;
+        std::vector<iovec> iovecs, batchIovecs;
+
+        void queue(const IORequest &request, iovec &vector, unsigned long long tag);
+        void collect(std::vector<IORequest> *requests, unsigned &completed);
+#endif
+    };
+
+#ifdef HAVE_IO_URING
+    // user_data of a request in the asynchronous batch; requests of run() carry their plain index
+    static const unsigned long long ASYNC_REQUEST = 1ull << 63;
+
+    IORing::IORing() : ringFd(-1), entries(0), outstanding(0), sqRing(MAP_FAILED), cqRing(MAP_FAILED), sqRingSize(0),
+                       cqRingSize(0), sqesSize(0), sqes((io_uring_sqe *)MAP_FAILED), cqes(nullptr)
+    {
+    }
+
+    // A batch still in flight writes into its buffers, so it is waited for before they can go
+    IORing::~IORing()
+    {
+        std::vector<size_t> completed;
+        if (outstanding > 0)
+            reap(true, completed);
+        if (sqes != MAP_FAILED)
+            munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED && cqRing != sqRing)
+            munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED)
+            munmap(sqRing, sqRingSize);
+        if (ringFd >= 0)
+            close(ringFd);
+    }
+
+    RC IORing::setup(unsigned queue_entries)
+    {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        ringFd = syscall(__NR_io_uring_setup, queue_entries, &params);
+        if (ringFd < 0)
+        {
+            return -1;
+        }
+
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+        }
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                      IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED)
+        {
+            return -1;
+        }
+        cqRing = (params.features & IORING_FEAT_SINGLE_MMAP)
+                 ? sqRing
+                 : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                        IORING_OFF_CQ_RING);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = (io_uring_sqe *)mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                                    IORING_OFF_SQES);
+        if (cqRing == MAP_FAILED || sqes == MAP_FAILED)
+        {
+            return -1;
+        }
+
+        char *sq = (char *)sqRing, *cq = (char *)cqRing;
+        sqTail = (unsigned *)(sq + params.sq_off.tail);
+        sqMask = (unsigned *)(sq + params.sq_off.ring_mask);
+        sqArray = (unsigned *)(sq + params.sq_off.array);
+        cqHead = (unsigned *)(cq + params.cq_off.head);
+        cqTail = (unsigned *)(cq + params.cq_off.tail);
+        cqMask = (unsigned *)(cq + params.cq_off.ring_mask);
+        cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+        entries = params.sq_entries;
+        iovecs.resize(entries);
+        return 0;
+    }
+
+    // Fill the next submission queue entry; the kernel sees it once the tail is published
+    void IORing::queue(const IORequest &request, iovec &vector, unsigned long long tag)
+    {
+        unsigned tail = *sqTail;
+        unsigned index = tail & *sqMask;
+        io_uring_sqe *sqe = &sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        vector.iov_base = request.buffer;
+        vector.iov_len = request.length;
+        sqe->opcode = request.write ? IORING_OP_WRITEV : IORING_OP_READV;
+        sqe->fd = request.fd;
+        sqe->addr = (unsigned long long)&vector;
+        sqe->len = 1;
+        sqe->off = request.offset;
+        sqe->user_data = tag;
+        sqArray[index] = index;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    // Take every completion off the queue. Those of the asynchronous batch are kept for reap(), the others
+    // belong to the requests run() is waiting for.
+    void IORing::collect(std::vector<IORequest> *requests, unsigned &completed)
+    {
+        unsigned head = *cqHead;
+        while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE))
+        {
+            io_uring_cqe *cqe = &cqes[head & *cqMask];
+            if (cqe->user_data & ASYNC_REQUEST)
+            {
+                size_t index = cqe->user_data & ~ASYNC_REQUEST;
+                batch[index].result = cqe->res;
+                arrived.push_back(index);
+                outstanding--;
+            }
+            else if (requests != nullptr)
+            {
+                (*requests)[cqe->user_data].result = cqe->res;
+                completed++;
+            }
+            head++;
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+
+    RC IORing::run(std::vector<IORequest> &requests)
+    {
+        for (size_t first = 0; first < requests.size(); first += entries)
+        {
+            unsigned count = std::min((size_t)entries, requests.size() - first);
+            for (unsigned i = 0; i < count; i++)
+            {
+                queue(requests[first + i], iovecs[i], first + i);
+            }
+
+            // One call submits the part and waits for it; it only returns early on a signal or when
+            // completions of the asynchronous batch come in between
+            unsigned submitted = 0, completed = 0;
+            while (completed < count)
+            {
+                int rc = syscall(__NR_io_uring_enter, ringFd, count - submitted, count - completed,
+                                 IORING_ENTER_GETEVENTS, nullptr, 0);
+                if (rc < 0 && errno != EINTR)
+                {
+                    perror("Error: io_uring submission failed!");
+                    return -1;
+                }
+                submitted += rc > 0 ? rc : 0;
+                collect(&requests, completed);
+            }
+        }
+        return 0;
+    }
+
+    RC IORing::submit(const std::vector<IORequest> &requests)
+    {
+        if (pending() || requests.size() > entries)
+        {
+            return -1;
+        }
+
+        batch = requests;
+        batchIovecs.resize(batch.size());
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            queue(batch[i], batchIovecs[i], i | ASYNC_REQUEST);
+        }
+        unsigned submitted = 0;
+        while (submitted < batch.size())
+        {
+            int rc = syscall(__NR_io_uring_enter, ringFd, batch.size() - submitted, 0, 0, nullptr, 0);
+            if (rc < 0 && errno != EINTR)
+            {
+                // Take back what the kernel did not consume, and let the rest finish before the buffers go
+                __atomic_store_n(sqTail, *sqTail - (batch.size() - submitted), __ATOMIC_RELEASE);
+                outstanding = submitted;
+                std::vector<size_t> completed;
+                reap(true, completed);
+                perror("Error: io_uring submission failed!");
+                return -1;
+            }
+            submitted += rc > 0 ? rc : 0;
+        }
+        outstanding = batch.size();
+        return 0;
+    }
+
+    RC IORing::reap(bool wait, std::vector<size_t> &completed)
+    {
+        unsigned none = 0;
+        while (true)
+        {
+            collect(nullptr, none);
+            if (!wait || outstanding == 0)
+            {
+                break;
+            }
+            if (syscall(__NR_io_uring_enter, ringFd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) < 0 && errno != EINTR)
+            {
+                perror("Error: io_uring wait failed!");
+                return -1;
+            }
+        }
+        completed.swap(arrived);
+        arrived.clear();
+        return 0;
+    }
+
+    bool IORing::pending()
+    {
+        return outstanding > 0 || !arrived.empty();
+    }
+#else
+    IORing::IORing() : ringFd(-1), entries(0), outstanding(0) {}
+
+    IORing::~IORing() = default;
+
+    RC IORing::setup(unsigned queue_entries)
+    {
+        return -1;
+    }
+
+    RC IORing::run(std::vector<IORequest> &requests)
+    {
+        return -1;
+    }
+
+    RC IORing::submit(const std::vector<IORequest> &requests)
+    {
+        return -1;
+    }
+
+    RC IORing::reap(bool wait, std::vector<size_t> &completed)
+    {
+        return -1;
+    }
+
+    bool IORing::pending()
+    {
+        return false;
+    }
+#endif
+
+    // Issue a batch through the ring if there is one, else one pread/pwrite after the other.
+    // Every transfer must move all of its bytes.
+    static RC runBatch(IORing *ring, std::vector<IORequest> &requests)
+    {
+        if (ring != nullptr)
+        {
+            if (ring->run(requests) != 0)
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            for (IORequest &request : requests)
+            {
+                request.result = request.write ? pwrite(request.fd, request.buffer, request.length, request.offset)
+                                               : pread(request.fd, request.buffer, request.length, request.offset);
+            }
+        }
+
+        for (const IORequest &request : requests)
+        {
+            if (request.result != (ssize_t)request.length)
+            {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    // O_DIRECT moves whole blocks between aligned memory and aligned file offsets
+    static bool directAligned(off_t offset, size_t length)
+    {
+        return offset % DIRECT_IO_ALIGNMENT == 0 && length % DIRECT_IO_ALIGNMENT == 0;
+    }
+
+    static bool directAligned(const void *buffer)
+    {
+        return (uintptr_t)buffer % DIRECT_IO_ALIGNMENT == 0;
+    }
+
+    // Memory for pages that may be handed to an IO_DIRECT handle; give it back with free()
+    static char *allocateAligned(size_t size)
+    {
+        void *memory = nullptr;
+        return posix_memalign(&memory, DIRECT_IO_ALIGNMENT, size) == 0 ? (char *)memory : nullptr;
+    }
+
+    // CRC32C lookup tables for eight bytes at a time, built on first use
+    struct Crc32cTables
+    {
+        unsigned table[8][256];
+
+        Crc32cTables()
+        {
+            for (unsigned i = 0; i < 256; i++)
+            {
+                unsigned crc = i;
+                for (int bit = 0; bit < 8; bit++)
+                    crc = (crc >> 1) ^ (0x82F63B78 & (0 - (crc & 1)));
+                table[0][i] = crc;
+            }
+            for (unsigned i = 0; i < 256; i++)
+            {
+                for (int slice = 1; slice < 8; slice++)
+                    table[slice][i] = (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xFF];
+            }
+        }
+    };
+
+    static unsigned crc32cSoftware(unsigned crc, const unsigned char *data, size_t length)
+    {
+        static const Crc32cTables tables;
+        const unsigned (*table)[256] = tables.table;
+        for (; length >= 8; data += 8, length -= 8)
+        {
+            unsigned low, high;
+            memcpy(&low, data, sizeof(unsigned));
+            memcpy(&high, data + 4, sizeof(unsigned));
+            low ^= crc;
+            crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^ table[5][(low >> 16) & 0xFF] ^
+                  table[4][low >> 24] ^ table[3][high & 0xFF] ^ table[2][(high >> 8) & 0xFF] ^
+                  table[1][(high >> 16) & 0xFF] ^ table[0][high >> 24];
+        }
+        for (; length > 0; data++, length--)
+            crc = (crc >> 8) ^ table[0][(crc ^ *data) & 0xFF];
+        return crc;
+    }
+
+#if defined(__x86_64__)
+    __attribute__((target("sse4.2"))) static unsigned crc32cHardware(unsigned crc, const unsigned char *data,
+                                                                     size_t length)
+    {
+        unsigned long long crc64 = crc;
+        for (; length >= 8; data += 8, length -= 8)
+        {
+            unsigned long long word;
+            memcpy(&word, data, sizeof(word));
+            crc64 = _mm_crc32_u64(crc64, word);
+        }
+        crc = (unsigned)crc64;
+        for (; length > 0; data++, length--)
+            crc = _mm_crc32_u8(crc, *data);
+        return crc;
+    }
+#endif
+
+    unsigned crc32c(const void *data, size_t length)
+    {
+        const unsigned char *bytes = (const unsigned char *)data;
+#if defined(__x86_64__)
+        static const bool hardware = __builtin_cpu_supports("sse4.2");
+        if (hardware)
+            return ~crc32cHardware(~0u, bytes, length);
+#endif
+        return ~crc32cSoftware(~0u, bytes, length);
+    }
+
     PagedFileManager &PagedFileManager::instance()
     {
         static PagedFileManager _pf_manager = PagedFileManager();
@@ -20,10 +447,16 @@ namespace PeterDB
 
     PagedFileManager &PagedFileManager::operator=(const PagedFileManager &) = default;
 
-    // Create a new file with the given name.
-    // If the file already exists, return an error.
-    RC PagedFileManager::createFile(const std::string &file_name)
+    // Create a new file with the given name and page size.
+    // If the file already exists or the page size is not a power of two in range, return an error.
+    RC PagedFileManager::createFile(const std::string &file_name, unsigned page_size)
     {
+        if (page_size < MIN_PAGE_SIZE || page_size > MAX_PAGE_SIZE || (page_size & (page_size - 1)) != 0)
+        {
+            perror("Error: Unsupported page size!");
+            return -1;
+        }
+
         // Check if the file already exists
         if (access(file_name.c_str(), F_OK) == 0)
         {
@@ -42,10 +475,13 @@ namespace PeterDB
         // Create a hidden metadata page in the newly created file
         FileHandle file_handle;
         file_handle.file_pointer = new_file;
+        file_handle.ioMode = IO_STDIO;
+        file_handle.pageSize = page_size;
+        file_handle.checksums = 1;
         RC status = file_handle.initializeHiddenPage();
 
         // Close the file after creating the hidden page
-        fclose(new_file);
+        file_handle.closeDescriptor();
 
         return status; // Return the status of hidden page creation
     }
@@ -54,6 +490,9 @@ namespace PeterDB
     // If the file does not exist or cannot be removed, return an error.
     RC PagedFileManager::destroyFile(const std::string &file_name)
     {
+        // Buffered pages of a destroyed file must never be written back, nor its log replayed
+        BufferManager::instance().discardFile(file_name);
+        remove((file_name + ".wal").c_str());
 
         // Attempt to delete the file
         if (remove(file_name.c_str()) != 0)
@@ -67,26 +506,72 @@ namespace PeterDB
     }
 
     // Open an existing file with the given name and associate it with the provided FileHandle.
+    // The I/O mode picks between positional pread/pwrite on a file descriptor, the same with O_DIRECT, and stdio.
     // If the file does not exist or the FileHandle is already in use, return an error.
-    RC PagedFileManager::openFile(const std::string &file_name, FileHandle &file_handle)
+    RC PagedFileManager::openFile(const std::string &file_name, FileHandle &file_handle, IOMode io_mode)
     {
 
         // Check if the FileHandle is already associated with another open file
-        if (file_handle.file_pointer != nullptr)
+        if (file_handle.isOpen())
         {
             perror("Error: FileHandle is already in use for another open file!");
+            return -1;
         }
 
-        // Attempt to open the file in read-write binary mode
-        FILE *opened_file = fopen(file_name.c_str(), "rb+");
-        if (opened_file == nullptr)
+        file_handle.ioMode = io_mode;
+        file_handle.file_pointer = nullptr;
+        file_handle.fd = -1;
+        file_handle.metaFd = -1;
+
+        // Attempt to open the file for reading and writing
+        if (io_mode == IO_STDIO)
+        {
+            file_handle.file_pointer = fopen(file_name.c_str(), "rb+");
+        }
+        else if (io_mode == IO_DIRECT)
+        {
+#ifdef O_DIRECT
+            // Pages go through the O_DIRECT descriptor; the hidden page header and the checksums are smaller
+            // than a block and use a second, buffered one
+            file_handle.metaFd = open(file_name.c_str(), O_RDWR);
+            if (file_handle.metaFd >= 0)
+            {
+                file_handle.fd = open(file_name.c_str(), O_RDWR | O_DIRECT);
+            }
+#endif
+        }
+        else
+        {
+            file_handle.fd = open(file_name.c_str(), O_RDWR);
+        }
+        if (!file_handle.isOpen())
         {
             perror("Error: Failed to open the file!");
+            file_handle.closeDescriptor();
+            return -1;
         }
 
-        // Associate the opened file with the provided FileHandle
-        file_handle.setOpenFile(opened_file);
+        // The hidden page is read once here and kept in the handle
+        file_handle.ioSinceHeaderFlush = 0;
+        file_handle.spaceMapMax.clear();
+        if (file_handle.readHiddenPage() != 0)
+        {
+            file_handle.closeDescriptor();
+            return -1;
+        }
+        file_handle.syncedWrites = file_handle.writePageCounter + file_handle.appendPageCounter;
         file_handle.setFileName(file_name);
+        file_handle.fileId = BufferManager::instance().registerFile(file_name);
+
+        // A log is only left behind by a crash; the first handle replays it, then repairs the checksums
+        // if the crash may have come between a page write and its checksum write
+        if (BufferManager::instance().getOpenHandles(file_handle.fileId) == 1 &&
+            (file_handle.recoverLog() != 0 || (file_handle.unclean && file_handle.repairChecksums() != 0)))
+        {
+            BufferManager::instance().releaseFile(file_handle);
+            file_handle.closeDescriptor();
+            return -1;
+        }
 
         return 0; // Success
     }
@@ -96,315 +581,2419 @@ namespace PeterDB
     RC PagedFileManager::closeFile(FileHandle &file_handle)
     {
         // Check if there is no file currently associated with the FileHandle
-        if (file_handle.file_pointer == NULL)
+        if (!file_handle.isOpen())
         {
             perror("Error: No open file to close!");
             return -1;
         }
 
-        // Close the file and reset the FileHandle pointer
-        fclose(file_handle.file_pointer);
-        file_handle.file_pointer = NULL;
+        // Write back the dirty pages of this file before the handle goes away,
+        // then persist the page count and counters kept in memory.
+        // Closing is a sync point under every durability mode, but a file with no page written or
+        // appended since its last sync is not synced again.
+        RC status = BufferManager::instance().releaseFile(file_handle);
+        bool written = file_handle.writePageCounter + file_handle.appendPageCounter != file_handle.syncedWrites;
+        if (file_handle.checkpoint() != 0 || (written && file_handle.syncDescriptor() != 0))
+        {
+            status = -1;
+        }
+
+        // With every page and checksum on disk, the last handle marks the file clean
+        if (status == 0 && BufferManager::instance().getOpenHandles(file_handle.fileId) == 0 &&
+            file_handle.markClean() != 0)
+        {
+            status = -1;
+        }
+
+        // Once the pages are on disk the log is not needed; keep it for recovery if they may not be
+        if (file_handle.logFd >= 0 && file_handle.closeLog(status == 0) != 0)
+        {
+            status = -1;
+        }
 
-        return 0; // Success
+        // Close the file and reset the FileHandle
+        file_handle.closeDescriptor();
+
+        return status;
     }
 
-    FileHandle::FileHandle()
+    BufferManager &BufferManager::instance()
     {
-        readPageCounter = 0;
-        writePageCounter = 0;
-        appendPageCounter = 0;
+        static BufferManager _buffer_manager;
+        return _buffer_manager;
     }
 
-    FileHandle::~FileHandle() = default;
-
-    // Reads the content of the specified page into the provided buffer.
-    // If the page does not exist, returns an error.
-    RC FileHandle::readPage(PageNum page_num, void *buffer)
+    BufferManager::BufferManager()
     {
-        PageNum total_pages = getNumberOfPages();
-
-        // Check if the requested page exists
-        if (page_num >= total_pages)
-        {
-            perror("Error: Attempting to read a non-existent page!");
-            return -1;
-        }
+        frameData = nullptr;
+        clockHand = 0;
+        sweepKey = 0;
+        checkpointPending = false;
+        allocateFrames(DEFAULT_BUFFER_FRAMES);
+    }
 
-        // Seek to the page position, skipping the hidden page
-        fseek(file_pointer, page_num * PAGE_SIZE + PAGE_SIZE, SEEK_SET);
-        size_t read_bytes = fread(buffer, sizeof(char), PAGE_SIZE, file_pointer);
+    BufferManager::~BufferManager()
+    {
+        freeFrames();
+    }
 
-        // Verify if the read operation was successful
-        if (read_bytes != PAGE_SIZE)
-        {
-            perror("Error: Failed to read page data!");
-            return -1;
-        }
+    BufferManager::BufferManager(const BufferManager &)
+    {
+        frameData = nullptr;
+        clockHand = 0;
+        sweepKey = 0;
+        checkpointPending = false;
+        allocateFrames(DEFAULT_BUFFER_FRAMES);
+    }
 
-        // Update the read page counter
-        readPageCounter = getReadPageCount();
-        readPageCounter++;
-        setReadPageCount(readPageCounter);
+    BufferManager &BufferManager::operator=(const BufferManager &) { return *this; }
 
-        return 0; // Success
+    unsigned long long BufferManager::frameKey(unsigned fileId, PageNum pageNum)
+    {
+        return ((unsigned long long)fileId << 32) | pageNum;
     }
 
-    // Writes data to the specified page. If the page does not exist, returns an error.
-    RC FileHandle::writePage(PageNum page_num, const void *buffer)
+    // Allocate an empty pool of the given number of frames.
+    RC BufferManager::allocateFrames(unsigned numFrames)
     {
-        PageNum total_pages = getNumberOfPages();
-
-        // Check if the page is valid
-        if (page_num >= total_pages)
+        if (numFrames == 0)
         {
-            perror("Error: Attempting to write to a non-existent page!");
             return -1;
         }
 
-        // Seek to the page position, skipping the hidden page
-        fseek(file_pointer, page_num * PAGE_SIZE + PAGE_SIZE, SEEK_SET);
-        size_t written_bytes = fwrite(buffer, sizeof(char), PAGE_SIZE, file_pointer);
-
-        // Verify if the write operation was successful
-        if (written_bytes != PAGE_SIZE)
+        char *newData = allocateAligned((size_t)numFrames * PAGE_SIZE);
+        if (newData == nullptr)
         {
-            perror("Error: Failed to write page data!");
+            perror("Error: Failed to allocate the buffer pool!");
             return -1;
         }
 
-        // Flush the file to ensure data integrity
-        if (fflush(file_pointer) != 0)
+        freeFrames();
+        frameData = newData;
+        frames.assign(numFrames, Frame());
+        for (unsigned i = 0; i < numFrames; i++)
         {
-            perror("Error: Failed to flush file after writing!");
-            return -1;
+            Frame &frame = frames[i];
+            frame.data = frameData + (size_t)i * PAGE_SIZE;
+            frame.capacity = PAGE_SIZE;
+            frame.owner = nullptr;
+            frame.fileId = 0;
+            frame.pageNum = 0;
+            frame.pinCount = 0;
+            frame.lsn = 0;
+            frame.writes = 0;
+            frame.logPending = false;
+            frame.dirty = false;
+            frame.referenced = false;
+            frame.valid = false;
+            frame.loading = false;
+            frame.writing = false;
         }
-
-        // Update the write page counter
-        writePageCounter = getWritePageCount();
-        writePageCounter++;
-        setWritePageCount(writePageCounter);
-
-        return 0; // Success
+        pageTable.clear();
+        clockHand = 0;
+        return 0;
     }
 
-    // Appends a new page to the end of the file with the provided data.
-    // Updates the total page count and counters accordingly.
-    RC FileHandle::appendPage(const void *buffer)
+    // Give back the pool memory, including the buffers frames got for larger pages.
+    void BufferManager::freeFrames()
     {
-        fseek(file_pointer, 0, SEEK_END);
-        size_t written_bytes = fwrite(buffer, sizeof(char), PAGE_SIZE, file_pointer);
+        for (Frame &frame : frames)
+        {
+            if (frame.capacity > PAGE_SIZE)
+            {
+                free(frame.data);
+            }
+        }
+        frames.clear();
+        free(frameData);
+        frameData = nullptr;
+    }
 
-        // Verify if the append operation was successful
-        if (written_bytes != PAGE_SIZE)
+    // Make an unused frame large enough for a page of the given size. A frame keeps a larger buffer
+    // once it has one, so a pool serving the same page sizes stops allocating after warm-up.
+    RC BufferManager::fitFrame(Frame &frame, unsigned pageSize)
+    {
+        if (frame.capacity >= pageSize)
         {
-            perror("Error: Failed to append new page!");
-            return -1;
+            return 0;
         }
 
-        // Flush the file to ensure data integrity
-        if (fflush(file_pointer) != 0)
+        char *data = allocateAligned(pageSize);
+        if (data == nullptr)
         {
-            perror("Error: Failed to flush file after appending!");
+            perror("Error: Failed to allocate a frame!");
             return -1;
         }
-
-        // Update the append page counter
-        appendPageCounter = getAppendPageCount();
-        appendPageCounter++;
-        setAppendPageCount(appendPageCounter);
-
-        // Update the total number of pages
-        PageNum total_pages = getNumberOfPages();
-        total_pages++;
-        setTotalPageCount(total_pages);
-
-        return 0; // Success
+        if (frame.capacity > PAGE_SIZE)
+        {
+            free(frame.data);
+        }
+        frame.data = data;
+        frame.capacity = pageSize;
+        return 0;
     }
 
-    // Function to retrieve the total number of pages from the file.
-    // Returns the number of pages or 0 if an error occurs.
-    unsigned FileHandle::getNumberOfPages()
+    // Resize the pool. Every dirty frame is written back first, so this fails while pages are pinned.
+    RC BufferManager::setNumFrames(unsigned numFrames)
     {
-        fseek(file_pointer, 0, SEEK_SET); // Move file pointer to the beginning
-        unsigned totalPageCount = 0;
-        size_t bytesRead = fread(&totalPageCount, sizeof(unsigned), 1, file_pointer);
+        std::unique_lock<std::mutex> lock(latch);
+        waitForWrites(lock, 0);
+        while (!readAheads.empty())
+        {
+            collectReadAhead(*readAheads.begin()->first, lock, true);
+        }
 
-        if (bytesRead != 1)
+        for (unsigned i = 0; i < frames.size(); i++)
+        {
+            if (frames[i].valid && frames[i].pinCount > 0)
+            {
+                perror("Error: Cannot resize the buffer pool while pages are pinned!");
+                return -1;
+            }
+        }
+        for (unsigned i = 0; i < frames.size(); i++)
         {
-            perror("Error reading the total number of pages!");
-            return 0; // Placeholder for error handling
+            if (frames[i].valid && frames[i].dirty && writeBack(frames[i]) != 0)
+            {
+                return -1;
+            }
         }
-        return totalPageCount;
+        return allocateFrames(numFrames);
     }
 
-    RC FileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount)
+    unsigned BufferManager::getNumFrames()
     {
-        readPageCount = readPageCounter;
-        writePageCount = writePageCounter;
-        appendPageCount = appendPageCounter;
-        return 0;
+        std::lock_guard<std::mutex> guard(latch);
+        return frames.size();
     }
 
-    // Function to retrieve the read page counter value from the file.
-    // Returns the counter value or 0 if an error occurs.
-    int FileHandle::getReadPageCount()
+    unsigned BufferManager::registerFile(const std::string &fileName)
     {
-        fseek(file_pointer, sizeof(unsigned), SEEK_SET); // Position after the total page count
-        unsigned readCounter = 0;
-        size_t bytesRead = fread(&readCounter, sizeof(unsigned), 1, file_pointer);
+        std::lock_guard<std::mutex> guard(latch);
 
-        if (bytesRead != 1)
+        auto found = fileIds.find(fileName);
+        unsigned fileId;
+        if (found == fileIds.end())
         {
-            perror("Error reading the read page counter!");
-            return 0; // Placeholder for error handling
+            fileId = fileIds.size() + 1;
+            fileIds[fileName] = fileId;
         }
-        return readCounter;
-    }
-
-    // Function to write the read page counter value to the file.
-    // Returns 0 on success, -1 on error.
-    RC FileHandle::setReadPageCount(unsigned readPageCnt)
-    {
-        fseek(file_pointer, sizeof(unsigned), SEEK_SET); // Position after the total page count
-        size_t bytesWritten = fwrite(&readPageCnt, sizeof(unsigned), 1, file_pointer);
-
-        if (bytesWritten != 1)
+        else
         {
-            perror("Error writing the read page counter!");
-            return -1; // Error code
+            fileId = found->second;
         }
-        fflush(file_pointer); // Ensure changes are written to disk
-        return 0;             // Success
+        openHandles[fileId]++;
+        return fileId;
     }
 
-    // Function to retrieve the write page counter value from the file.
-    int FileHandle::getWritePageCount()
+    unsigned BufferManager::getOpenHandles(unsigned fileId)
     {
-        fseek(file_pointer, sizeof(unsigned) * 2, SEEK_SET); // Position after total and read counters
-        unsigned writeCounter = 0;
-        size_t bytesRead = fread(&writeCounter, sizeof(unsigned), 1, file_pointer);
+        std::lock_guard<std::mutex> guard(latch);
 
-        if (bytesRead != 1)
-        {
-            perror("Error reading the write page counter!");
-            return 0; // Placeholder for error handling
-        }
-        return writeCounter;
+        auto found = openHandles.find(fileId);
+        return found == openHandles.end() ? 0 : found->second;
     }
 
-    // Function to write the write page counter value to the file.
-    RC FileHandle::setWritePageCount(unsigned writeCounter)
+    // Write a dirty frame back through the handle that dirtied it, with the latch held.
+    // A logged change reaches the log on disk before the page does. The flusher writes its frames through
+    // flushDirtyFrames instead, and only those whose log records are durable already.
+    RC BufferManager::writeBack(Frame &frame)
     {
-        fseek(file_pointer, sizeof(unsigned) * 2, SEEK_SET); // Position after total and read counters
-        size_t bytesWritten = fwrite(&writeCounter, sizeof(unsigned), 1, file_pointer);
+        if (frame.owner == nullptr || (frame.lsn > 0 && frame.owner->flushLog(frame.lsn) != 0) ||
+            frame.owner->writePhysicalPage(frame.pageNum, frame.data) != 0)
+        {
+            perror("Error: Failed to write back a dirty frame!");
+            return -1;
+        }
 
-        if (bytesWritten != 1)
+        if (frame.lsn > 0)
         {
-            perror("Error writing the write page counter!");
-            return -1; // Error code
+            unsigned long long &durable = durableLsns[frame.fileId];
+            durable = std::max(durable, frame.owner->flushedLsn);
         }
-        fflush(file_pointer);
-        return 0; // Success
+        frame.dirty = false;
+        frame.writes++;
+        return 0;
     }
 
-    // Function to retrieve the append page counter value from the file.
-    int FileHandle::getAppendPageCount()
+    // Pick an unpinned frame with the clock algorithm, writing it back if it is dirty.
+    RC BufferManager::findVictim(unsigned &frameIndex)
     {
-        fseek(file_pointer, sizeof(unsigned) * 3, SEEK_SET); // Position after total, read, and write counters
-        unsigned appendCounter = 0;
-        size_t bytesRead = fread(&appendCounter, sizeof(unsigned), 1, file_pointer);
-
-        if (bytesRead != 1)
+        unsigned numFrames = frames.size();
+        for (unsigned step = 0; step < numFrames * 2; step++)
         {
-            perror("Error reading the append page counter!");
-            return 0; // Placeholder for error handling
+            unsigned candidate = clockHand;
+            clockHand = (clockHand + 1) % numFrames;
+
+            Frame &frame = frames[candidate];
+            if (!frame.valid)
+            {
+                frameIndex = candidate;
+                return 0;
+            }
+            if (frame.pinCount > 0 || frame.writing)
+            {
+                continue;
+            }
+            if (frame.referenced)
+            {
+                frame.referenced = false;
+                continue;
+            }
+
+            if (frame.dirty && writeBack(frame) != 0)
+            {
+                return -1;
+            }
+            pageTable.erase(frameKey(frame.fileId, frame.pageNum));
+            frame.valid = false;
+            frameIndex = candidate;
+            return 0;
         }
-        return appendCounter;
+
+        perror("Error: Every frame of the buffer pool is pinned!");
+        return -1;
     }
 
-    // Function to write the append page counter value to the file.
-    RC FileHandle::setAppendPageCount(unsigned appendCounter)
+    RC BufferManager::pinPage(FileHandle &fileHandle, PageNum physicalPageNum, char *&data, bool loadFromDisk)
     {
-        fseek(file_pointer, sizeof(unsigned) * 3, SEEK_SET); // Position after total, read, and write counters
-        size_t bytesWritten = fwrite(&appendCounter, sizeof(unsigned), 1, file_pointer);
+        std::unique_lock<std::mutex> lock(latch);
 
-        if (bytesWritten != 1)
+        // Read-ahead pages that arrived since the handle's last pin enter the pool first
+        if (!readAheads.empty())
         {
-            perror("Error writing the append page counter!");
-            return -1; // Error code
+            collectReadAhead(fileHandle, lock, false);
         }
-        fflush(file_pointer);
-        return 0; // Success
-    }
-
-    // Function to write the total number of pages to the file.
-    // Returns 0 on success, -1 on error.
-    RC FileHandle::setTotalPageCount(unsigned totalPageCount)
-    {
-        fseek(file_pointer, 0, SEEK_SET); // Move file pointer to the beginning
-        size_t bytesWritten = fwrite(&totalPageCount, sizeof(unsigned), 1, file_pointer);
 
-        if (bytesWritten != 1)
+        // A page another thread is reading or writing back is waited for; if a read fails the lookup starts
+        // over. A page the handle's own read-ahead still has in flight is waited for on its ring.
+        unsigned long long key = frameKey(fileHandle.fileId, physicalPageNum);
+        while (true)
         {
-            perror("Error writing the total number of pages!");
-            return -1; // Error code
+            auto found = pageTable.find(key);
+            if (found != pageTable.end() && (frames[found->second].loading || frames[found->second].writing))
+            {
+                ioDone.wait(lock);
+                continue;
+            }
+            if (found != pageTable.end())
+            {
+                // Buffer hit: no physical I/O
+                Frame &frame = frames[found->second];
+                frame.pinCount++;
+                frame.referenced = true;
+                data = frame.data;
+                return 0;
+            }
+            if (!isReadingAhead(fileHandle, physicalPageNum) || collectReadAhead(fileHandle, lock, true) != 0)
+            {
+                break;
+            }
         }
-        fflush(file_pointer);
-        return 0; // Success
-    }
 
-    // Function to initialize the hidden page with counter values and metadata.
-    RC FileHandle::initializeHiddenPage()
-    {
-        void *hiddenPageData = malloc(PAGE_SIZE); // Allocate memory for hidden page
-        if (!hiddenPageData)
+        unsigned frameIndex;
+        if (findVictim(frameIndex) != 0)
         {
-            perror("Memory allocation error for hidden page!");
             return -1;
         }
 
-        unsigned totalPageCount = 0;
-        unsigned readCounter = 0;
-        unsigned writeCounter = 0;
-        unsigned appendCounter = 0;
-        int dataOffset = 0;
-
-        // Pack counter values into the hidden page buffer
-        memcpy(static_cast<char *>(hiddenPageData) + dataOffset, &totalPageCount, sizeof(unsigned));
-        dataOffset += sizeof(unsigned);
-        memcpy(static_cast<char *>(hiddenPageData) + dataOffset, &readCounter, sizeof(unsigned));
-        dataOffset += sizeof(unsigned);
-        memcpy(static_cast<char *>(hiddenPageData) + dataOffset, &writeCounter, sizeof(unsigned));
-        dataOffset += sizeof(unsigned);
-        memcpy(static_cast<char *>(hiddenPageData) + dataOffset, &appendCounter, sizeof(unsigned));
-
-        // Write the hidden page to the file
-        size_t bytesWritten = fwrite(hiddenPageData, sizeof(char), PAGE_SIZE, file_pointer);
-        if (bytesWritten != PAGE_SIZE)
+        Frame &frame = frames[frameIndex];
+        if (fitFrame(frame, fileHandle.pageSize) != 0)
         {
-            perror("Error writing the hidden page!");
-            free(hiddenPageData);
             return -1;
         }
+        frame.owner = &fileHandle;
+        frame.fileId = fileHandle.fileId;
+        frame.pageNum = physicalPageNum;
+        frame.pinCount = 1;
+        frame.lsn = 0;
+        frame.logPending = false;
+        frame.dirty = false;
+        frame.referenced = true;
+        frame.valid = true;
+        frame.loading = loadFromDisk;
+        frame.writing = false;
+        pageTable[key] = frameIndex;
+
+        // The pinned frame cannot be handed out or resized, so the page is read without the latch
+        if (loadFromDisk)
+        {
+            lock.unlock();
+            RC rc = fileHandle.readPhysicalPage(physicalPageNum, frame.data);
+            lock.lock();
+            frame.loading = false;
+            ioDone.notify_all();
+            if (rc != 0)
+            {
+                pageTable.erase(key);
+                frame.pinCount = 0;
+                frame.valid = false;
+                fileHandle.prefetchQueue.clear();
+                return -1;
+            }
+        }
+        data = frame.data;
 
-        fflush(file_pointer); // Ensure changes are written to disk
-        free(hiddenPageData); // Free allocated memory
-        return 0;             // Success
+        // Read-ahead queued by this miss; if it fails the pages are simply read when they are pinned
+        if (!fileHandle.prefetchQueue.empty())
+        {
+            std::vector<PageNum> queue;
+            queue.swap(fileHandle.prefetchQueue);
+            prefetchLocked(fileHandle, queue, lock);
+        }
+        return 0;
     }
 
-    void FileHandle::setOpenFile(FILE *pFile)
+    RC BufferManager::unpinPage(FileHandle &fileHandle, PageNum physicalPageNum, bool isDirty, unsigned long long lsn)
     {
-        file_pointer = pFile;
-        readPageCounter = getReadPageCount();
-        writePageCounter = getWritePageCount();
-        appendPageCounter = getAppendPageCount();
-    }
+        std::lock_guard<std::mutex> guard(latch);
 
-    FILE *FileHandle::getFile()
-    {
-        return file_pointer;
-    }
+        auto found = pageTable.find(frameKey(fileHandle.fileId, physicalPageNum));
+        if (found == pageTable.end() || frames[found->second].pinCount == 0)
+        {
+            perror("Error: Unpinning a page that is not pinned!");
+            return -1;
+        }
+
+        Frame &frame = frames[found->second];
+        frame.pinCount--;
+        frame.lsn = std::max(frame.lsn, lsn);
+        if (lsn > 0)
+        {
+            unsigned long long &stamped = stampedLsns[frame.fileId];
+            stamped = std::max(stamped, lsn);
+            frame.logPending = false;
+        }
+        else if (isDirty && fileHandle.logFd >= 0)
+        {
+            // The handle logs the change right after this unpin; the flusher must not write it before
+            frame.logPending = true;
+        }
+        if (isDirty)
+        {
+            frame.dirty = true;
+            frame.owner = &fileHandle;
+        }
+        return 0;
+    }
+
+    // Write every dirty frame of the file in page order with one batch, after the log records they need.
+    // Any handle on the same file can write the pages. The frames are marked under the latch and written
+    // without it; a change made while they are written leaves the frame dirty again.
+    RC BufferManager::flushFile(FileHandle &fileHandle)
+    {
+        std::unique_lock<std::mutex> lock(latch);
+        waitForWrites(lock, fileHandle.fileId);
+
+        std::vector<std::pair<PageNum, unsigned>> dirtyFrames;
+        unsigned long long lsn = 0;
+        for (unsigned i = 0; i < frames.size(); i++)
+        {
+            Frame &frame = frames[i];
+            if (frame.valid && frame.fileId == fileHandle.fileId && frame.dirty)
+            {
+                dirtyFrames.push_back({frame.pageNum, i});
+                lsn = std::max(lsn, frame.lsn);
+            }
+        }
+        if (dirtyFrames.empty())
+        {
+            return 0;
+        }
+        std::sort(dirtyFrames.begin(), dirtyFrames.end());
+
+        std::vector<PageNum> pageNums;
+        std::vector<char *> buffers;
+        for (const auto &dirty : dirtyFrames)
+        {
+            Frame &frame = frames[dirty.second];
+            frame.writing = true;
+            frame.dirty = false;
+            pageNums.push_back(dirty.first);
+            buffers.push_back(frame.data);
+        }
+
+        lock.unlock();
+        RC rc = (lsn > 0 && fileHandle.flushLog(lsn) != 0) || fileHandle.writePhysicalPages(pageNums, buffers) != 0
+                ? -1 : 0;
+        lock.lock();
+        for (const auto &dirty : dirtyFrames)
+        {
+            Frame &frame = frames[dirty.second];
+            frame.writing = false;
+            if (rc != 0)
+            {
+                frame.dirty = true;
+                continue;
+            }
+            frame.owner = &fileHandle;
+            frame.writes++;
+        }
+        ioDone.notify_all();
+        if (rc != 0)
+        {
+            perror("Error: Failed to write back a dirty frame!");
+            return -1;
+        }
+
+        if (lsn > 0)
+        {
+            unsigned long long &durable = durableLsns[fileHandle.fileId];
+            durable = std::max(durable, fileHandle.flushedLsn);
+        }
+        return 0;
+    }
+
+    RC BufferManager::prefetchPages(FileHandle &fileHandle, const std::vector<PageNum> &physicalPageNums)
+    {
+        std::unique_lock<std::mutex> lock(latch);
+        return prefetchLocked(fileHandle, physicalPageNums, lock);
+    }
+
+    // Frames for the batch are taken like any other and pinned, so the clock does not hand one out twice, and
+    // the batch is read without the latch. At most a quarter of the pool is used. Without a ring the frames are
+    // entered as loading and pins of those pages wait for the batch. With one, the batch is only submitted and
+    // stays out of the page table until collectReadAhead finds its pages in. If the batch fails the frames are
+    // given up; a later pin reads the page again and reports the error.
+    RC BufferManager::prefetchLocked(FileHandle &fileHandle, const std::vector<PageNum> &physicalPageNums,
+                                     std::unique_lock<std::mutex> &lock)
+    {
+        bool async = fileHandle.ring != nullptr;
+        if (async && readAheads.count(&fileHandle) > 0 && collectReadAhead(fileHandle, lock, true) != 0)
+        {
+            return -1;
+        }
+
+        std::vector<unsigned> frameIndexes;
+        std::vector<PageNum> pageNums;
+        std::vector<char *> buffers;
+        for (PageNum physicalPageNum : physicalPageNums)
+        {
+            unsigned long long key = frameKey(fileHandle.fileId, physicalPageNum);
+            if (pageTable.count(key) > 0)
+            {
+                continue;
+            }
+
+            unsigned frameIndex;
+            if (frameIndexes.size() >= frames.size() / 4 || (async && frameIndexes.size() >= IO_URING_DEPTH) ||
+                findVictim(frameIndex) != 0 || fitFrame(frames[frameIndex], fileHandle.pageSize) != 0)
+            {
+                break;
+            }
+            Frame &frame = frames[frameIndex];
+            frame.owner = &fileHandle;
+            frame.fileId = fileHandle.fileId;
+            frame.pageNum = physicalPageNum;
+            frame.pinCount = 1;
+            frame.lsn = 0;
+            frame.logPending = false;
+            frame.dirty = false;
+            frame.referenced = true;
+            frame.valid = true;
+            frame.loading = true;
+            frame.writing = false;
+            if (!async)
+            {
+                pageTable[key] = frameIndex;
+            }
+            frameIndexes.push_back(frameIndex);
+            pageNums.push_back(physicalPageNum);
+            buffers.push_back(frame.data);
+        }
+        if (pageNums.empty())
+        {
+            return 0;
+        }
+
+        lock.unlock();
+        RC rc = async ? fileHandle.startPhysicalReads(pageNums, buffers) : fileHandle.readPhysicalPages(pageNums, buffers);
+        lock.lock();
+        if (async && rc == 0)
+        {
+            readAheads[&fileHandle] = frameIndexes;
+            return 0;
+        }
+        for (unsigned frameIndex : frameIndexes)
+        {
+            Frame &frame = frames[frameIndex];
+            frame.pinCount = 0;
+            frame.loading = false;
+            if (rc != 0)
+            {
+                if (!async)
+                {
+                    pageTable.erase(frameKey(frame.fileId, frame.pageNum));
+                }
+                frame.valid = false;
+            }
+        }
+        ioDone.notify_all();
+        return rc;
+    }
+
+    // Put the pages of the handle's asynchronous batch that have arrived into the pool, waiting for the rest
+    // if asked to. A page another thread has read in the meantime keeps that copy, and a failed page is left
+    // to be read again by its pin. The ring is waited on without the latch.
+    RC BufferManager::collectReadAhead(FileHandle &fileHandle, std::unique_lock<std::mutex> &lock, bool wait)
+    {
+        if (readAheads.count(&fileHandle) == 0)
+        {
+            return 0;
+        }
+
+        std::vector<size_t> readPages, failedPages;
+        lock.unlock();
+        RC rc = fileHandle.finishPhysicalReads(wait, readPages, failedPages);
+        bool pending = fileHandle.physicalReadsPending();
+        lock.lock();
+
+        auto found = readAheads.find(&fileHandle);
+        for (size_t i = 0; i < readPages.size() + failedPages.size(); i++)
+        {
+            bool arrived = i < readPages.size();
+            Frame &frame = frames[found->second[arrived ? readPages[i] : failedPages[i - readPages.size()]]];
+            unsigned long long key = frameKey(frame.fileId, frame.pageNum);
+            frame.pinCount = 0;
+            frame.loading = false;
+            if (arrived && pageTable.count(key) == 0)
+            {
+                pageTable[key] = found->second[readPages[i]];
+            }
+            else
+            {
+                frame.valid = false;
+            }
+        }
+        // Frames of a batch the ring lost track of stay pinned, since the kernel may still fill them
+        if (!pending || (rc != 0 && wait))
+        {
+            readAheads.erase(found);
+        }
+        return rc;
+    }
+
+    bool BufferManager::isReadingAhead(FileHandle &fileHandle, PageNum physicalPageNum)
+    {
+        auto found = readAheads.find(&fileHandle);
+        if (found == readAheads.end())
+        {
+            return false;
+        }
+        for (unsigned frameIndex : found->second)
+        {
+            const Frame &frame = frames[frameIndex];
+            if (frame.loading && frame.fileId == fileHandle.fileId && frame.pageNum == physicalPageNum)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    RC BufferManager::finishReadAhead(FileHandle &fileHandle)
+    {
+        std::unique_lock<std::mutex> lock(latch);
+        return collectReadAhead(fileHandle, lock, true);
+    }
+
+    RC BufferManager::flushPage(FileHandle &fileHandle, PageNum physicalPageNum)
+    {
+        std::unique_lock<std::mutex> lock(latch);
+        waitForWrites(lock, fileHandle.fileId);
+
+        auto found = pageTable.find(frameKey(fileHandle.fileId, physicalPageNum));
+        if (found == pageTable.end() || !frames[found->second].dirty)
+        {
+            return 0;
+        }
+
+        Frame &frame = frames[found->second];
+        frame.owner = &fileHandle;
+        return writeBack(frame);
+    }
+
+    RC BufferManager::releaseFile(FileHandle &fileHandle)
+    {
+        RC status = finishReadAhead(fileHandle);
+        if (flushFile(fileHandle) != 0)
+        {
+            status = -1;
+        }
+
+        std::unique_lock<std::mutex> lock(latch);
+        waitForWrites(lock, fileHandle.fileId);
+
+        unsigned &handles = openHandles[fileHandle.fileId];
+        if (handles > 0)
+        {
+            handles--;
+        }
+        fileHandle.writePageCounter += backgroundWrites[fileHandle.fileId];
+        backgroundWrites[fileHandle.fileId] = 0;
+        if (handles == 0)
+        {
+            // A handle opened later starts a new log, so the file's LSNs are not needed any more
+            forgetFile(fileHandle.fileId);
+        }
+
+        for (unsigned i = 0; i < frames.size(); i++)
+        {
+            Frame &frame = frames[i];
+            if (!frame.valid || frame.loading || frame.fileId != fileHandle.fileId)
+            {
+                continue;
+            }
+            if (handles == 0)
+            {
+                // Last handle on the file: its pages leave the pool
+                pageTable.erase(frameKey(frame.fileId, frame.pageNum));
+                frame.valid = false;
+            }
+            else if (frame.owner == &fileHandle)
+            {
+                frame.owner = nullptr;
+            }
+        }
+        return status;
+    }
+
+    void BufferManager::discardFile(const std::string &fileName)
+    {
+        std::unique_lock<std::mutex> lock(latch);
+
+        auto found = fileIds.find(fileName);
+        if (found == fileIds.end())
+        {
+            return;
+        }
+        waitForWrites(lock, found->second);
+
+        // A frame still being read belongs to its reader, which unpins it
+        for (Frame &frame : frames)
+        {
+            if (frame.valid && !frame.loading && frame.fileId == found->second)
+            {
+                pageTable.erase(frameKey(frame.fileId, frame.pageNum));
+                frame.valid = false;
+            }
+        }
+        forgetFile(found->second);
+    }
+
+    void BufferManager::forgetFile(unsigned fileId)
+    {
+        stampedLsns.erase(fileId);
+        durableLsns.erase(fileId);
+        checkpointLsns.erase(fileId);
+        checkpointTargets.erase(fileId);
+        backgroundWrites.erase(fileId);
+    }
+
+    // The flusher may write a frame nobody is using whose changes are durable in the log, if any.
+    // Handles in IO_STDIO mode share a stream position with their own thread and are left alone.
+    bool BufferManager::canWriteInBackground(const Frame &frame)
+    {
+        if (!frame.valid || !frame.dirty || frame.pinCount > 0 || frame.writing || frame.logPending ||
+            frame.owner == nullptr || frame.owner->ioMode == IO_STDIO)
+        {
+            return false;
+        }
+        if (frame.lsn == 0)
+        {
+            return true;
+        }
+        auto durable = durableLsns.find(frame.fileId);
+        return durable != durableLsns.end() && frame.lsn <= durable->second;
+    }
+
+    // Wait until no frame of the file is being written back without the latch. A closing handle waits here,
+    // so a write never outlives the handle it goes through.
+    void BufferManager::waitForWrites(std::unique_lock<std::mutex> &lock, unsigned fileId)
+    {
+        ioDone.wait(lock, [this, fileId] {
+            for (const Frame &frame : frames)
+            {
+                if (frame.writing && (fileId == 0 || frame.fileId == fileId))
+                {
+                    return false;
+                }
+            }
+            return true;
+        });
+    }
+
+    unsigned BufferManager::getDirtyFrames()
+    {
+        std::lock_guard<std::mutex> guard(latch);
+
+        unsigned dirty = 0;
+        for (const Frame &frame : frames)
+        {
+            if (frame.valid && frame.dirty)
+            {
+                dirty++;
+            }
+        }
+        return dirty;
+    }
+
+    RC BufferManager::flushDirtyFrames(unsigned maxPages, unsigned &pagesWritten, bool urgent)
+    {
+        std::unique_lock<std::mutex> lock(latch);
+
+        // A trickle leaves recently used pages alone, as they are likely to be changed again soon;
+        // a checkpoint or a pool past its high-water mark cannot wait for them
+        bool everyPage = urgent || checkpointPending;
+        pagesWritten = 0;
+        std::vector<unsigned long long> keys;
+        for (const Frame &frame : frames)
+        {
+            if (canWriteInBackground(frame) && (everyPage || !frame.referenced))
+            {
+                keys.push_back(frameKey(frame.fileId, frame.pageNum));
+            }
+        }
+        if (keys.empty())
+        {
+            return 0;
+        }
+        std::sort(keys.begin(), keys.end());
+
+        // Pick up above the last page written, like an elevator, so the file is written in ascending order;
+        // past the last page the sweep starts over from the lowest one
+        size_t start = std::upper_bound(keys.begin(), keys.end(), sweepKey) - keys.begin();
+        std::vector<unsigned> batch;
+        for (size_t i = 0; i < keys.size() && batch.size() < maxPages; i++)
+        {
+            unsigned long long key = keys[(start + i) % keys.size()];
+            Frame &frame = frames[pageTable[key]];
+            frame.writing = true;
+            frame.dirty = false;
+            batch.push_back(pageTable[key]);
+            sweepKey = key;
+        }
+
+        // The writes run without the latch, so foreground pins and evictions of other pages go on meanwhile.
+        // The frames cannot be evicted, and a pin of one waits, so its image stays put until it is written.
+        lock.unlock();
+        std::vector<RC> results;
+        for (unsigned frameIndex : batch)
+        {
+            const Frame &frame = frames[frameIndex];
+            results.push_back(frame.owner->writePhysicalPage(frame.pageNum, frame.data, true));
+        }
+        lock.lock();
+
+        RC status = 0;
+        for (size_t i = 0; i < batch.size(); i++)
+        {
+            Frame &frame = frames[batch[i]];
+            frame.writing = false;
+            if (results[i] != 0)
+            {
+                frame.dirty = true;
+                status = -1;
+                continue;
+            }
+            backgroundWrites[frame.fileId]++;
+            frame.writes++;
+            pagesWritten++;
+        }
+        ioDone.notify_all();
+        if (status != 0)
+        {
+            perror("Error: Failed to write back a dirty frame!");
+        }
+        return status;
+    }
+
+    unsigned BufferManager::takeBackgroundWrites(unsigned fileId)
+    {
+        std::lock_guard<std::mutex> guard(latch);
+
+        auto found = backgroundWrites.find(fileId);
+        if (found == backgroundWrites.end())
+        {
+            return 0;
+        }
+        unsigned written = found->second;
+        found->second = 0;
+        return written;
+    }
+
+    void BufferManager::logFlushed(FileHandle &fileHandle)
+    {
+        std::lock_guard<std::mutex> guard(latch);
+
+        unsigned long long &durable = durableLsns[fileHandle.fileId];
+        durable = std::max(durable, fileHandle.flushedLsn);
+    }
+
+    RC BufferManager::beginCheckpoint()
+    {
+        std::lock_guard<std::mutex> guard(latch);
+
+        if (checkpointPending)
+        {
+            perror("Error: A checkpoint is already in progress!");
+            return -1;
+        }
+
+        checkpointPages.clear();
+        checkpointTargets.clear();
+        for (unsigned i = 0; i < frames.size(); i++)
+        {
+            const Frame &frame = frames[i];
+            if (frame.valid && (frame.dirty || frame.writing))
+            {
+                checkpointPages.push_back({i, frameKey(frame.fileId, frame.pageNum), frame.writes});
+                checkpointTargets.insert({frame.fileId, 0});
+            }
+        }
+        // A change stamped by now is either in a noted frame or was written back before; both reach the
+        // disk by the end of the checkpoint
+        for (const auto &stamped : stampedLsns)
+        {
+            checkpointTargets[stamped.first] = stamped.second;
+        }
+        checkpointPending = true;
+        return 0;
+    }
+
+    // True once every frame noted by beginCheckpoint has been written back or evicted
+    bool BufferManager::isCheckpointFlushed()
+    {
+        std::lock_guard<std::mutex> guard(latch);
+
+        auto written = [this](const CheckpointPage &page) {
+            if (page.frameIndex >= frames.size())
+            {
+                return true; // The pool was resized, which writes back every frame
+            }
+            const Frame &frame = frames[page.frameIndex];
+            return !frame.valid || frameKey(frame.fileId, frame.pageNum) != page.key || frame.writes != page.writes;
+        };
+        checkpointPages.erase(std::remove_if(checkpointPages.begin(), checkpointPages.end(), written),
+                              checkpointPages.end());
+        return checkpointPages.empty();
+    }
+
+    // Sync the files of the checkpoint and publish the LSNs it covers. The files are synced through
+    // descriptors of their own, since syncing any descriptor of a file syncs the file.
+    RC BufferManager::completeCheckpoint()
+    {
+        std::vector<std::string> fileNames;
+        {
+            std::lock_guard<std::mutex> guard(latch);
+            for (const auto &file : fileIds)
+            {
+                if (checkpointTargets.count(file.second) > 0)
+                {
+                    fileNames.push_back(file.first);
+                }
+            }
+        }
+
+        RC status = 0;
+        for (const std::string &fileName : fileNames)
+        {
+            int file_fd = open(fileName.c_str(), O_RDONLY);
+            if (file_fd < 0 || fdatasync(file_fd) != 0)
+            {
+                status = -1;
+            }
+            if (file_fd >= 0)
+            {
+                close(file_fd);
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(latch);
+        // Files closed in the meantime were dropped from the targets, and a reopened file starts its LSNs over
+        for (const auto &target : checkpointTargets)
+        {
+            if (status == 0 && target.second > 0)
+            {
+                checkpointLsns[target.first] = target.second;
+            }
+        }
+        checkpointTargets.clear();
+        checkpointPages.clear();
+        checkpointPending = false;
+        if (status != 0)
+        {
+            perror("Error: Failed to sync the files of a checkpoint!");
+        }
+        return status;
+    }
+
+    // Give up a checkpoint before its frames are written back; it covers nothing
+    void BufferManager::abortCheckpoint()
+    {
+        std::lock_guard<std::mutex> guard(latch);
+
+        checkpointTargets.clear();
+        checkpointPages.clear();
+        checkpointPending = false;
+    }
+
+    unsigned long long BufferManager::getCheckpointLsn(unsigned fileId)
+    {
+        std::lock_guard<std::mutex> guard(latch);
+
+        auto found = checkpointLsns.find(fileId);
+        return found == checkpointLsns.end() ? 0 : found->second;
+    }
+
+    // Buffers given back by the ScratchBuffers of one thread, most recently returned last
+    struct ScratchPool
+    {
+        std::vector<std::pair<char *, size_t>> buffers;
+
+        ScratchPool() { buffers.reserve(MAX_POOLED); }
+
+        ~ScratchPool()
+        {
+            for (auto &buffer : buffers)
+                free(buffer.first);
+        }
+
+        static const size_t MAX_POOLED = 32; // Buffers beyond this are freed when given back
+    };
+
+    static thread_local ScratchPool scratchPool;
+
+    ScratchBuffer::ScratchBuffer(size_t size, bool zeroed)
+    {
+        // Take the most recently returned buffer that is large enough; it is likely still in cache
+        std::vector<std::pair<char *, size_t>> &buffers = scratchPool.buffers;
+        buffer = nullptr;
+        for (size_t i = buffers.size(); i-- > 0;)
+        {
+            if (buffers[i].second >= size)
+            {
+                buffer = buffers[i].first;
+                capacity = buffers[i].second;
+                buffers.erase(buffers.begin() + i);
+                break;
+            }
+        }
+        if (buffer == nullptr)
+        {
+            capacity = std::max(size, (size_t)PAGE_SIZE);
+            buffer = allocateAligned(capacity);
+            if (buffer == nullptr)
+                throw std::bad_alloc();
+        }
+        if (zeroed)
+            memset(buffer, 0, size);
+    }
+
+    ScratchBuffer::~ScratchBuffer()
+    {
+        std::vector<std::pair<char *, size_t>> &buffers = scratchPool.buffers;
+        if (buffers.size() < ScratchPool::MAX_POOLED)
+            buffers.push_back(std::make_pair(buffer, capacity));
+        else
+            free(buffer);
+    }
+
+    FileHandle::FileHandle()
+    {
+        readPageCounter = 0;
+        writePageCounter = 0;
+        appendPageCounter = 0;
+        file_pointer = nullptr;
+        fd = -1;
+        metaFd = -1;
+        ioMode = IO_POSIX;
+        fileId = 0;
+        numberOfPages = 0;
+        formatTag = 0;
+        writeGeneration = 0;
+        pageSize = PAGE_SIZE;
+        checksums = 0;
+        verifyChecksums = true;
+        checksumFailures = 0;
+        checksumRepairs = 0;
+        unclean = false;
+        readAheadLimit = READ_AHEAD_PAGES;
+        readAheadWindow = 0;
+        lastPhysicalRead = 0;
+        sequentialReads = 0;
+        readAheadEnd = 0;
+        pagesReadAhead = 0;
+        ioEngine = IO_ENGINE_PREAD;
+        headerFlushInterval = 0;
+        ioSinceHeaderFlush = 0;
+        durability = DURABILITY_ON_CLOSE;
+        groupCommitPages = 0;
+        groupCommitMs = 0;
+        pagesSinceSync = 0;
+        syncedWrites = 0;
+        lastSync = std::chrono::steady_clock::now();
+        logLimit = WAL_CHECKPOINT_BYTES;
+        logFd = -1;
+        nextLsn = 1;
+        flushedLsn = 0;
+    }
+
+    // A handle destroyed while open is closed first, so no frame of the pool is left pointing at it.
+    // The scrubber's private handle was never registered with the pool and only has its descriptor.
+    FileHandle::~FileHandle()
+    {
+        if (!isOpen())
+        {
+            return;
+        }
+        if (fileId != 0)
+        {
+            PagedFileManager::instance().closeFile(*this);
+        }
+        else
+        {
+            closeDescriptor();
+        }
+    }
+
+    // Reads the content of the specified page into the provided buffer.
+    // If the page does not exist, returns an error.
+    RC FileHandle::readPage(PageNum page_num, void *buffer)
+    {
+        char *frame;
+        if (pinPage(page_num, frame) != 0)
+        {
+            return -1;
+        }
+
+        memcpy(buffer, frame, pageSize);
+        return unpinPage(page_num, false);
+    }
+
+    // Writes data to the specified page. If the page does not exist, returns an error.
+    // The page is written back to disk when its frame is evicted or the file is closed.
+    RC FileHandle::writePage(PageNum page_num, const void *buffer)
+    {
+        // Check if the page is valid
+        if (page_num >= numberOfPages)
+        {
+            perror("Error: Attempting to write to a non-existent page!");
+            return -1;
+        }
+
+        // The whole page is overwritten, so there is no need to load it first
+        char *frame;
+        if (BufferManager::instance().pinPage(*this, physicalPageNum(page_num), frame, false) != 0)
+        {
+            perror("Error: Failed to write page data!");
+            return -1;
+        }
+
+        memcpy(frame, buffer, pageSize);
+        return unpinPage(page_num, true);
+    }
+
+    // Appends a new page to the end of the file with the provided data.
+    // Updates the total page count and counters accordingly.
+    RC FileHandle::appendPage(const void *buffer)
+    {
+        PageNum new_page = numberOfPages;
+        if (markUnclean() != 0)
+        {
+            return -1;
+        }
+
+        // The first page of every group is preceded by the space map page and the checksum page of the group
+        if (new_page % groupPages() == 0)
+        {
+            ScratchBuffer emptyMap(pageSize, true);
+            PageNum map_page_num = spaceMapPageNum(new_page);
+            if ((checksums && writeBytes((off_t)(map_page_num + 1) * pageSize, emptyMap.data(), pageSize) != 0) ||
+                writePhysicalPage(map_page_num, emptyMap.data()) != 0)
+            {
+                perror("Error: Failed to append a space map page!");
+                return -1;
+            }
+        }
+
+        PageNum physical_page_num = physicalPageNum(new_page);
+        if (writeBytes((off_t)physical_page_num * pageSize, buffer, pageSize) != 0 ||
+            storeChecksum(physical_page_num, buffer) != 0)
+        {
+            perror("Error: Failed to append new page!");
+            return -1;
+        }
+
+        // Update the append page counter and the total number of pages
+        appendPageCounter++;
+        numberOfPages++;
+        writeGeneration++;
+        headerChanged();
+
+        // The page itself is already in the file; only the header and the sync may be pending
+        if (applyDurability(physical_page_num, false, buffer) != 0)
+        {
+            return -1;
+        }
+
+        // Keep the new page in the pool; appended pages are usually read again right away
+        char *frame;
+        if (BufferManager::instance().pinPage(*this, physical_page_num, frame, false) == 0)
+        {
+            memcpy(frame, buffer, pageSize);
+            BufferManager::instance().unpinPage(*this, physical_page_num, false);
+        }
+
+        return 0; // Success
+    }
+
+    // Pins the specified page in the buffer pool and returns a pointer to its frame.
+    // If the page does not exist, returns an error.
+    RC FileHandle::pinPage(PageNum page_num, char *&data)
+    {
+        // Check if the requested page exists
+        if (page_num >= numberOfPages)
+        {
+            perror("Error: Attempting to read a non-existent page!");
+            return -1;
+        }
+
+        return BufferManager::instance().pinPage(*this, physicalPageNum(page_num), data);
+    }
+
+    // Releases a pinned page. A dirty unpin counts as a page write for the durability policy.
+    RC FileHandle::unpinPage(PageNum page_num, bool is_dirty)
+    {
+        PageNum physical_page_num = physicalPageNum(page_num);
+        RC status = is_dirty ? markUnclean() : 0;
+        if (BufferManager::instance().unpinPage(*this, physical_page_num, is_dirty) != 0 || status != 0)
+        {
+            return -1;
+        }
+        if (!is_dirty)
+        {
+            return 0;
+        }
+        writeGeneration++;
+        return applyDurability(physical_page_num, true);
+    }
+
+    // Data pages come in groups of K = groupPages(), each led by its space map page and checksum page:
+    // [hidden page][map 0][checksums 0][data 0 .. K-1][map 1][checksums 1][data K .. 2K-1] ...
+    // A space map page holds one free-space byte per data page of its group. The checksum page keeps the
+    // CRC32C of the map page and of every data page, so K = pageSize / 4 - 1. Files written before
+    // checksums existed have no checksum pages and K = pageSize.
+    PageNum FileHandle::physicalPageNum(PageNum page_num)
+    {
+        return spaceMapPageNum(page_num) + 1 + checksums + page_num % groupPages();
+    }
+
+    PageNum FileHandle::spaceMapPageNum(PageNum page_num)
+    {
+        return 1 + (page_num / groupPages()) * (groupPages() + 1 + checksums);
+    }
+
+    // A checksum page holds a 4-byte checksum for its map page and for each data page of the group
+    unsigned FileHandle::groupPages()
+    {
+        return checksums ? pageSize / sizeof(unsigned) - 1 : pageSize;
+    }
+
+    bool FileHandle::isChecksumPage(PageNum physical_page_num)
+    {
+        return checksums && physical_page_num > 0 && (physical_page_num - 1) % (groupPages() + 2) == 1;
+    }
+
+    // Where the checksum of a map or data page lives: entry 0 of the group's checksum page is the map page
+    off_t FileHandle::checksumOffset(PageNum physical_page_num)
+    {
+        PageNum group_start = 1 + (physical_page_num - 1) / (groupPages() + 2) * (groupPages() + 2);
+        unsigned entry = physical_page_num == group_start ? 0 : physical_page_num - group_start - 1;
+        return (off_t)(group_start + 1) * pageSize + entry * sizeof(unsigned);
+    }
+
+    // The checksum goes straight to the file after its page; checksum pages never enter the buffer pool
+    RC FileHandle::storeChecksum(PageNum physical_page_num, const void *buffer)
+    {
+        if (!checksums || physical_page_num == 0)
+        {
+            return 0;
+        }
+
+        unsigned checksum = crc32c(buffer, pageSize);
+        return writeBytes(checksumOffset(physical_page_num), &checksum, sizeof(unsigned));
+    }
+
+    RC FileHandle::readChecksum(PageNum physical_page_num, unsigned &checksum)
+    {
+        return readBytes(checksumOffset(physical_page_num), &checksum, sizeof(unsigned));
+    }
+
+    void FileHandle::setChecksumVerification(bool enabled)
+    {
+        verifyChecksums = enabled;
+    }
+
+    RC FileHandle::checkPhysicalPage(PageNum physical_page_num, void *buffer, bool &intact)
+    {
+        unsigned checksum;
+        if (readBytes((off_t)physical_page_num * pageSize, buffer, pageSize) != 0 ||
+            readChecksum(physical_page_num, checksum) != 0)
+        {
+            return -1;
+        }
+        intact = crc32c(buffer, pageSize) == checksum;
+        return 0;
+    }
+
+    // Records how many bytes are free on a data page. The space map keeps one byte per page,
+    // counting free space in pageSize / 256 steps rounded down, so a hit never overstates the room.
+    RC FileHandle::setFreeSpace(PageNum page_num, unsigned free_bytes)
+    {
+        if (page_num >= numberOfPages)
+        {
+            perror("Error: Attempting to set the free space of a non-existent page!");
+            return -1;
+        }
+
+        return setSpaceMapEntry(page_num, (unsigned char)std::min(free_bytes / (pageSize / 256), SPACE_MAP_RESERVED - 1u));
+    }
+
+    RC FileHandle::setPageReserved(PageNum page_num)
+    {
+        if (page_num >= numberOfPages)
+        {
+            perror("Error: Attempting to reserve a non-existent page!");
+            return -1;
+        }
+
+        return setSpaceMapEntry(page_num, SPACE_MAP_RESERVED);
+    }
+
+    RC FileHandle::isPageReserved(PageNum page_num, bool &reserved)
+    {
+        if (page_num >= numberOfPages)
+        {
+            perror("Error: Attempting to look up a non-existent page!");
+            return -1;
+        }
+
+        PageNum map_page_num = spaceMapPageNum(page_num);
+        char *map;
+        if (BufferManager::instance().pinPage(*this, map_page_num, map) != 0)
+        {
+            return -1;
+        }
+        reserved = ((unsigned char *)map)[page_num % groupPages()] == SPACE_MAP_RESERVED;
+        return BufferManager::instance().unpinPage(*this, map_page_num, false);
+    }
+
+    RC FileHandle::getReservedPages(PageNum page_num, PageNum &first_page_num, std::vector<bool> &reserved)
+    {
+        if (page_num >= numberOfPages)
+        {
+            perror("Error: Attempting to look up a non-existent page!");
+            return -1;
+        }
+
+        PageNum map_page_num = spaceMapPageNum(page_num);
+        char *map;
+        if (BufferManager::instance().pinPage(*this, map_page_num, map) != 0)
+        {
+            return -1;
+        }
+        first_page_num = page_num - page_num % groupPages();
+        reserved.resize(std::min(groupPages(), numberOfPages - first_page_num));
+        for (size_t i = 0; i < reserved.size(); i++)
+        {
+            reserved[i] = ((unsigned char *)map)[i] == SPACE_MAP_RESERVED;
+        }
+        return BufferManager::instance().unpinPage(*this, map_page_num, false);
+    }
+
+    RC FileHandle::setSpaceMapEntry(PageNum page_num, unsigned char category)
+    {
+        PageNum map_page_num = spaceMapPageNum(page_num);
+        char *map;
+        if (BufferManager::instance().pinPage(*this, map_page_num, map) != 0)
+        {
+            return -1;
+        }
+
+        unsigned char &entry = ((unsigned char *)map)[page_num % groupPages()];
+        if (entry == category)
+        {
+            return BufferManager::instance().unpinPage(*this, map_page_num, false);
+        }
+
+        // Keep the cached maximum of the group exact, or forget it when it may have dropped
+        unsigned group = page_num / groupPages();
+        if (group < spaceMapMax.size() && spaceMapMax[group] >= 0)
+        {
+            if (category != SPACE_MAP_RESERVED && category > spaceMapMax[group])
+            {
+                spaceMapMax[group] = category;
+            }
+            else if (entry == spaceMapMax[group])
+            {
+                spaceMapMax[group] = -1;
+            }
+        }
+        entry = category;
+
+        RC status = markUnclean();
+        if (BufferManager::instance().unpinPage(*this, map_page_num, true) != 0 || status != 0)
+        {
+            return -1;
+        }
+        return applyDurability(map_page_num, true);
+    }
+
+    // Finds a data page with at least bytes_needed free bytes, preferring the end of the file.
+    // Groups whose cached maximum is too small are skipped without touching their map page.
+    // Returns -1 when no page has enough room.
+    RC FileHandle::findPageWithFreeSpace(unsigned bytes_needed, PageNum &page_num)
+    {
+        unsigned needed = (bytes_needed + (pageSize / 256) - 1) / (pageSize / 256);
+        if (needed >= SPACE_MAP_RESERVED || numberOfPages == 0)
+        {
+            return -1;
+        }
+
+        unsigned num_groups = (numberOfPages + groupPages() - 1) / groupPages();
+        // New groups start out unknown; setFreeSpace keeps the known ones exact
+        spaceMapMax.resize(num_groups, -1);
+
+        for (unsigned group = num_groups; group-- > 0;)
+        {
+            if (spaceMapMax[group] >= 0 && (unsigned)spaceMapMax[group] < needed)
+            {
+                continue;
+            }
+
+            PageNum first_page = group * groupPages();
+            unsigned entries = std::min(groupPages(), numberOfPages - first_page);
+            PageNum map_page_num = spaceMapPageNum(first_page);
+            char *map;
+            if (BufferManager::instance().pinPage(*this, map_page_num, map) != 0)
+            {
+                return -1;
+            }
+
+            const unsigned char *categories = (const unsigned char *)map;
+            int found = -1;
+            int group_max = 0;
+            for (unsigned i = entries; i-- > 0;)
+            {
+                if (categories[i] == SPACE_MAP_RESERVED)
+                {
+                    continue;
+                }
+                if (found < 0 && categories[i] >= needed)
+                {
+                    found = i;
+                }
+                group_max = std::max(group_max, (int)categories[i]);
+            }
+            BufferManager::instance().unpinPage(*this, map_page_num, false);
+
+            spaceMapMax[group] = group_max;
+            if (found >= 0)
+            {
+                page_num = first_page + found;
+                return 0;
+            }
+        }
+
+        return -1;
+    }
+
+    // Chooses how often writes are forced to stable storage.
+    // Group commit syncs once groupCommitPages pages changed or groupCommitMs milliseconds passed
+    // since the last sync, whichever comes first; a zero value disables that trigger.
+    RC FileHandle::setDurability(DurabilityMode mode, unsigned commitPages, unsigned commitMs)
+    {
+        if (mode == DURABILITY_GROUP_COMMIT && commitPages == 0 && commitMs == 0)
+        {
+            perror("Error: Group commit needs a page or a time limit!");
+            return -1;
+        }
+
+        // Leaving the log writes every page back first, so the log is no longer needed
+        if (mode == DURABILITY_WAL && logFd < 0 && openLog() != 0)
+        {
+            return -1;
+        }
+        if (mode != DURABILITY_WAL && logFd >= 0 && (sync() != 0 || closeLog(true) != 0))
+        {
+            return -1;
+        }
+
+        durability = mode;
+        groupCommitPages = commitPages;
+        groupCommitMs = commitMs;
+        pagesSinceSync = 0;
+        lastSync = std::chrono::steady_clock::now();
+        return 0;
+    }
+
+    DurabilityMode FileHandle::getDurability()
+    {
+        return durability;
+    }
+
+    // Write back every dirty page and the hidden page, then force the file to stable storage.
+    // Under DURABILITY_WAL this is a checkpoint: the log is emptied once the pages are on disk.
+    RC FileHandle::sync()
+    {
+        if (BufferManager::instance().flushFile(*this) != 0 || writeHiddenPage() != 0 || syncDescriptor() != 0)
+        {
+            perror("Error: Failed to sync the file!");
+            return -1;
+        }
+
+        if (logFd >= 0)
+        {
+            logBuffer.clear();
+            logSlots.clear();
+            flushedLsn = nextLsn - 1;
+            if (ftruncate(logFd, 0) != 0 || fdatasync(logFd) != 0)
+            {
+                perror("Error: Failed to truncate the log!");
+                return -1;
+            }
+            BufferManager::instance().logFlushed(*this);
+        }
+
+        pagesSinceSync = 0;
+        lastSync = std::chrono::steady_clock::now();
+        return 0;
+    }
+
+    // Apply the durability policy after a page changed. A buffered page still sits in the pool.
+    RC FileHandle::applyDurability(PageNum physical_page_num, bool buffered, const void *image)
+    {
+        switch (durability)
+        {
+        case DURABILITY_PER_WRITE:
+            if (buffered && BufferManager::instance().flushPage(*this, physical_page_num) != 0)
+            {
+                return -1;
+            }
+            if (writeHiddenPage() != 0)
+            {
+                return -1;
+            }
+            return syncDescriptor();
+
+        case DURABILITY_GROUP_COMMIT:
+        {
+            pagesSinceSync++;
+            bool pageLimit = groupCommitPages > 0 && pagesSinceSync >= groupCommitPages;
+            bool timeLimit = groupCommitMs > 0 &&
+                             std::chrono::steady_clock::now() - lastSync >= std::chrono::milliseconds(groupCommitMs);
+            return pageLimit || timeLimit ? sync() : 0;
+        }
+
+        case DURABILITY_WAL:
+        {
+            unsigned long long lsn;
+            if (!buffered)
+            {
+                return logPage(physical_page_num, image, lsn);
+            }
+
+            // Log the page as it is in the pool, and stamp the frame with the LSN of the record
+            char *frame;
+            if (BufferManager::instance().pinPage(*this, physical_page_num, frame) != 0)
+            {
+                return -1;
+            }
+            RC rc = logPage(physical_page_num, frame, lsn);
+            BufferManager::instance().unpinPage(*this, physical_page_num, false, rc == 0 ? lsn : 0);
+            return rc;
+        }
+
+        default:
+            return 0; // DURABILITY_ON_CLOSE
+        }
+    }
+
+    // Redo record: this header, then the page image. The checksum covers both, with checksum set to 0,
+    // so a record torn by a crash ends the replay.
+    struct LogRecordHeader
+    {
+        unsigned long long lsn;
+        unsigned pageNum;       // Physical page number
+        unsigned numberOfPages; // Page count of the file after the change
+        unsigned checksum;
+        unsigned reserved;
+    };
+
+    // Add the page image to the log buffer, replacing the record of an earlier change of the same page
+    RC FileHandle::logPage(PageNum physical_page_num, const void *image, unsigned long long &lsn)
+    {
+        size_t recordSize = sizeof(LogRecordHeader) + pageSize;
+        size_t offset;
+        auto slot = logSlots.find(physical_page_num);
+        if (slot == logSlots.end())
+        {
+            offset = logBuffer.size();
+            logBuffer.resize(offset + recordSize);
+            logSlots[physical_page_num] = offset;
+        }
+        else
+        {
+            offset = slot->second;
+        }
+
+        lsn = nextLsn++;
+        LogRecordHeader header = {lsn, physical_page_num, numberOfPages, 0, 0};
+        memcpy(logBuffer.data() + offset, &header, sizeof(header));
+        memcpy(logBuffer.data() + offset + sizeof(header), image, pageSize);
+        return 0;
+    }
+
+    // Append the buffered records to the log with one write and force them to disk
+    RC FileHandle::flushLog(unsigned long long lsn)
+    {
+        if (logFd < 0 || lsn <= flushedLsn)
+        {
+            return 0;
+        }
+
+        size_t recordSize = sizeof(LogRecordHeader) + pageSize;
+        for (size_t offset = 0; offset < logBuffer.size(); offset += recordSize)
+        {
+            unsigned checksum = crc32c(logBuffer.data() + offset, recordSize);
+            memcpy(logBuffer.data() + offset + offsetof(LogRecordHeader, checksum), &checksum, sizeof(unsigned));
+        }
+        if (write(logFd, logBuffer.data(), logBuffer.size()) != (ssize_t)logBuffer.size() || fdatasync(logFd) != 0)
+        {
+            perror("Error: Failed to write the log!");
+            return -1;
+        }
+
+        logBuffer.clear();
+        logSlots.clear();
+        flushedLsn = nextLsn - 1;
+        return 0;
+    }
+
+    // Make every change so far durable. Under DURABILITY_WAL only the log is written; a log grown past
+    // logLimit first loses the records a fuzzy checkpoint covers, and is checkpointed here if it is still
+    // too long. Other modes write the pages back.
+    RC FileHandle::commit()
+    {
+        if (logFd < 0)
+        {
+            return sync();
+        }
+
+        if (flushLog(nextLsn - 1) != 0)
+        {
+            return -1;
+        }
+        BufferManager::instance().logFlushed(*this);
+
+        struct stat log_stat;
+        if (fstat(logFd, &log_stat) != 0 || log_stat.st_size <= (off_t)logLimit)
+        {
+            return 0;
+        }
+        unsigned long long checkpointLsn = BufferManager::instance().getCheckpointLsn(fileId);
+        if (checkpointLsn > 0 && compactLog(checkpointLsn) != 0)
+        {
+            return -1;
+        }
+        if (fstat(logFd, &log_stat) == 0 && log_stat.st_size > (off_t)logLimit)
+        {
+            return sync();
+        }
+        return 0;
+    }
+
+    void FileHandle::setLogLimit(size_t bytes)
+    {
+        logLimit = bytes;
+    }
+
+    // Drop the records whose pages a fuzzy checkpoint has put on disk: the rest are copied to a new log
+    // that replaces the old one. The page count of the dropped records is made durable first.
+    RC FileHandle::compactLog(unsigned long long checkpointLsn)
+    {
+        if (writeHiddenPage() != 0 || syncDescriptor() != 0)
+        {
+            return -1;
+        }
+
+        std::string logName = fileName + ".wal";
+        std::string tempName = logName + ".tmp";
+        int log_fd = open(logName.c_str(), O_RDONLY);
+        int temp_fd = open(tempName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        size_t recordSize = sizeof(LogRecordHeader) + pageSize;
+        ScratchBuffer record(recordSize);
+        RC status = log_fd < 0 || temp_fd < 0 ? -1 : 0;
+        for (off_t offset = 0; status == 0 && pread(log_fd, record.data(), recordSize, offset) == (ssize_t)recordSize;
+             offset += recordSize)
+        {
+            LogRecordHeader header;
+            memcpy(&header, record.data(), sizeof(header));
+            if (header.lsn > checkpointLsn && write(temp_fd, record.data(), recordSize) != (ssize_t)recordSize)
+            {
+                status = -1;
+            }
+        }
+        if (log_fd >= 0)
+        {
+            close(log_fd);
+        }
+        if (temp_fd >= 0 && (fdatasync(temp_fd) != 0 || close(temp_fd) != 0))
+        {
+            status = -1;
+        }
+        if (status != 0 || rename(tempName.c_str(), logName.c_str()) != 0)
+        {
+            unlink(tempName.c_str());
+            perror("Error: Failed to compact the log!");
+            return -1;
+        }
+
+        // Appends go to the new log from now on
+        close(logFd);
+        return openLog();
+    }
+
+    RC FileHandle::openLog()
+    {
+        logFd = open((fileName + ".wal").c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (logFd < 0)
+        {
+            perror("Error: Failed to open the log!");
+            return -1;
+        }
+        flushedLsn = nextLsn - 1;
+        return 0;
+    }
+
+    // Stop logging; the log file is removed only when the pages it protects are on disk
+    RC FileHandle::closeLog(bool remove)
+    {
+        close(logFd);
+        logFd = -1;
+        logBuffer.clear();
+        logSlots.clear();
+        if (remove && unlink((fileName + ".wal").c_str()) != 0)
+        {
+            perror("Error: Failed to remove the log!");
+            return -1;
+        }
+        return 0;
+    }
+
+    // Replay the log left by a crash: write every complete record's page image back in log order, restore
+    // the page count, then make the file durable and drop the log. Pages written by the replay get their
+    // checksums again, which also repairs pages torn by the crash.
+    // Records are whole page images, so a record whose page already reached the disk only writes the same
+    // bytes again, or bytes a later record of that page overwrites in turn. Replay is idempotent without a
+    // page LSN to compare against, which leaves every byte of a page to the layer above. LSNs go on after
+    // the highest one in the log, so the records of the next session never reuse one.
+    RC FileHandle::recoverLog()
+    {
+        std::string logName = fileName + ".wal";
+        int log_fd = open(logName.c_str(), O_RDONLY);
+        if (log_fd < 0)
+        {
+            return 0; // Clean shutdown
+        }
+
+        BufferManager::instance().discardFile(fileName);
+        size_t recordSize = sizeof(LogRecordHeader) + pageSize;
+        ScratchBuffer record(recordSize);
+        unsigned replayed = 0;
+        RC status = 0;
+        for (off_t offset = 0; pread(log_fd, record.data(), recordSize, offset) == (ssize_t)recordSize;
+             offset += recordSize)
+        {
+            LogRecordHeader header;
+            memcpy(&header, record.data(), sizeof(header));
+            unsigned stored = header.checksum;
+            header.checksum = 0;
+            memcpy(record.data(), &header, sizeof(header));
+            if (crc32c(record.data(), recordSize) != stored)
+            {
+                break; // Torn tail
+            }
+            if (writePhysicalPage(header.pageNum, record.data() + sizeof(header)) != 0)
+            {
+                status = -1;
+                break;
+            }
+            numberOfPages = std::max(numberOfPages, header.numberOfPages);
+            nextLsn = std::max(nextLsn, header.lsn + 1);
+            replayed++;
+        }
+        close(log_fd);
+
+        if (status != 0 || (replayed > 0 && (writeHiddenPage() != 0 || syncDescriptor() != 0)))
+        {
+            perror("Error: Failed to replay the log!");
+            return -1;
+        }
+        return unlink(logName.c_str()) == 0 ? 0 : -1;
+    }
+
+    // Force the data already handed to the kernel down to the device.
+    RC FileHandle::syncDescriptor()
+    {
+        if (ioMode == IO_STDIO && fflush(file_pointer) != 0)
+        {
+            return -1;
+        }
+        if (fdatasync(ioMode == IO_STDIO ? fileno(file_pointer) : fd) != 0)
+        {
+            return -1;
+        }
+        syncedWrites = writePageCounter + appendPageCounter;
+        return 0;
+    }
+
+    // The flag reaches the disk before any page of the session does, so a page whose checksum write was lost
+    // is always found with the flag set
+    RC FileHandle::markUnclean()
+    {
+        if (unclean || !checksums)
+        {
+            return 0;
+        }
+
+        unsigned flag = 1;
+        if (writeBytes(UNCLEAN_FLAG_OFFSET, &flag, sizeof(unsigned)) != 0 || syncDescriptor() != 0)
+        {
+            perror("Error: Failed to mark the file as being written!");
+            return -1;
+        }
+        unclean = true;
+        return 0;
+    }
+
+    // Clear the unclean flag once the pages and checksums written by every handle are on disk
+    RC FileHandle::markClean()
+    {
+        unsigned flag = unclean;
+        if (!checksums || (!flag && readBytes(UNCLEAN_FLAG_OFFSET, &flag, sizeof(unsigned)) != 0))
+        {
+            return 0;
+        }
+        if (flag == 0)
+        {
+            return 0;
+        }
+
+        flag = 0;
+        if (writeBytes(UNCLEAN_FLAG_OFFSET, &flag, sizeof(unsigned)) != 0 || syncDescriptor() != 0)
+        {
+            perror("Error: Failed to mark the file as clean!");
+            return -1;
+        }
+        unclean = false;
+        return 0;
+    }
+
+    // After an unclean shutdown, give every map and data page whose checksum does not match its image the
+    // checksum of that image. A page whose write reached the disk without its checksum write is intact, and
+    // would otherwise fail verification for good; pages torn inside a write are what the log is for. The
+    // fixes are synced before the flag is cleared, so a crash here repairs again at the next open.
+    RC FileHandle::repairChecksums()
+    {
+        PageNum last_page = numberOfPages == 0 ? 0 : physicalPageNum(numberOfPages - 1);
+        ScratchBuffer page(pageSize);
+        for (PageNum physical_page_num = 1; physical_page_num <= last_page; physical_page_num++)
+        {
+            bool intact;
+            if (isChecksumPage(physical_page_num))
+            {
+                continue;
+            }
+            if (checkPhysicalPage(physical_page_num, page.data(), intact) != 0 ||
+                (!intact && storeChecksum(physical_page_num, page.data()) != 0))
+            {
+                perror("Error: Failed to repair the page checksums!");
+                return -1;
+            }
+            if (!intact)
+            {
+                checksumRepairs++;
+            }
+        }
+
+        if (checksumRepairs > 0 && syncDescriptor() != 0)
+        {
+            perror("Error: Failed to repair the page checksums!");
+            return -1;
+        }
+        return markClean();
+    }
+
+    // Reads a page straight from the file. The page number includes the hidden page.
+    RC FileHandle::readPhysicalPage(PageNum physical_page_num, void *buffer)
+    {
+        // Verify if the read operation was successful
+        if (readBytes((off_t)physical_page_num * pageSize, buffer, pageSize) != 0)
+        {
+            perror("Error: Failed to read page data!");
+            return -1;
+        }
+
+        // Update the read page counter
+        readPageCounter++;
+        headerChanged();
+        readAhead(physical_page_num);
+
+        // A torn or corrupted page is reported instead of being handed to the layer above
+        return verifyChecksum(physical_page_num, buffer);
+    }
+
+    // Compare a page read from disk with its stored checksum, unless verification is off
+    RC FileHandle::verifyChecksum(PageNum physical_page_num, const void *buffer)
+    {
+        if (!checksums || !verifyChecksums || physical_page_num == 0)
+        {
+            return 0;
+        }
+
+        unsigned checksum;
+        if (readChecksum(physical_page_num, checksum) != 0 || crc32c(buffer, pageSize) != checksum)
+        {
+            checksumFailures++;
+            perror("Error: Page checksum mismatch!");
+            return -1;
+        }
+        return 0;
+    }
+
+    // Sequential read-ahead. After three physical reads in a row the kernel is asked to start reading the
+    // pages that follow, so later misses find them in the page cache. The window starts at 4 pages and
+    // doubles up to readAheadLimit, and the next one is asked for once the reads reach the middle of the
+    // last. Short skips, like the map and checksum pages or overflow pages a scan passes over, still count
+    // as sequential; anything else starts over. An IO_DIRECT handle reads past the page cache, so it only
+    // reads ahead when it has an io_uring to fill the pool with.
+    void FileHandle::readAhead(PageNum physical_page_num)
+    {
+        if (readAheadLimit == 0 || (ioMode == IO_DIRECT && ring == nullptr))
+        {
+            return;
+        }
+
+        if (physical_page_num > lastPhysicalRead && physical_page_num - lastPhysicalRead <= 3)
+        {
+            sequentialReads++;
+        }
+        else
+        {
+            sequentialReads = 0;
+            readAheadWindow = 0;
+            readAheadEnd = 0;
+        }
+        lastPhysicalRead = physical_page_num;
+        if (sequentialReads < 2 || physical_page_num + readAheadWindow / 2 < readAheadEnd)
+        {
+            return;
+        }
+
+        readAheadWindow = std::min(readAheadWindow == 0 ? 4 : readAheadWindow * 2, readAheadLimit);
+        PageNum start = std::max(physical_page_num + 1, readAheadEnd);
+        readAheadEnd = start + readAheadWindow;
+        pagesReadAhead += readAheadWindow;
+        if (ring == nullptr)
+        {
+            int file_fd = ioMode == IO_STDIO ? fileno(file_pointer) : fd;
+            posix_fadvise(file_fd, (off_t)start * pageSize, (off_t)readAheadWindow * pageSize, POSIX_FADV_WILLNEED);
+            return;
+        }
+
+        // With io_uring the window goes straight into the pool, as one batch read once the current miss is done
+        PageNum end = numberOfPages == 0 ? 0 : std::min(readAheadEnd, physicalPageNum(numberOfPages - 1) + 1);
+        for (PageNum page = start; page < end; page++)
+        {
+            if (!isChecksumPage(page))
+            {
+                prefetchQueue.push_back(page);
+            }
+        }
+    }
+
+    RC FileHandle::setIOEngine(IOEngine engine)
+    {
+        // Pages still in flight on the old ring are put in the pool first
+        if (ring != nullptr && BufferManager::instance().finishReadAhead(*this) != 0)
+        {
+            return -1;
+        }
+        ring.reset();
+        ioEngine = IO_ENGINE_PREAD;
+        if (engine == IO_ENGINE_PREAD)
+        {
+            return 0;
+        }
+        if (ioMode == IO_STDIO)
+        {
+            perror("Error: io_uring needs a handle in IO_POSIX or IO_DIRECT mode!");
+            return -1;
+        }
+
+        // Without kernel support the handle keeps using pread/pwrite
+        std::shared_ptr<IORing> new_ring = std::make_shared<IORing>();
+        if (new_ring->setup(IO_URING_DEPTH) == 0)
+        {
+            ring = new_ring;
+            ioEngine = IO_ENGINE_URING;
+        }
+        return 0;
+    }
+
+    IOEngine FileHandle::getIOEngine()
+    {
+        return ioEngine;
+    }
+
+    // Read a batch of physical pages, and their checksums in the same batch, then verify them like
+    // readPhysicalPage does
+    RC FileHandle::readPhysicalPages(const std::vector<PageNum> &physical_page_nums, const std::vector<char *> &buffers)
+    {
+        if (!canBatch(buffers))
+        {
+            for (size_t i = 0; i < physical_page_nums.size(); i++)
+            {
+                if (readPhysicalPage(physical_page_nums[i], buffers[i]) != 0)
+                {
+                    return -1;
+                }
+            }
+            return 0;
+        }
+
+        bool verify = checksums && verifyChecksums;
+        std::vector<unsigned> stored(physical_page_nums.size());
+        std::vector<IORequest> requests;
+        int checksum_fd = ioMode == IO_DIRECT ? metaFd : fd;
+        for (size_t i = 0; i < physical_page_nums.size(); i++)
+        {
+            requests.push_back({buffers[i], pageSize, (off_t)physical_page_nums[i] * pageSize, false, fd, 0});
+            if (verify && physical_page_nums[i] > 0)
+            {
+                requests.push_back({&stored[i], sizeof(unsigned), checksumOffset(physical_page_nums[i]), false,
+                                    checksum_fd, 0});
+            }
+        }
+        if (runBatch(ring.get(), requests) != 0)
+        {
+            perror("Error: Failed to read page data!");
+            return -1;
+        }
+
+        RC status = 0;
+        for (size_t i = 0; i < physical_page_nums.size(); i++)
+        {
+            readPageCounter++;
+            headerChanged();
+            if (verify && physical_page_nums[i] > 0 && crc32c(buffers[i], pageSize) != stored[i])
+            {
+                checksumFailures++;
+                perror("Error: Page checksum mismatch!");
+                status = -1;
+            }
+        }
+        return status;
+    }
+
+    // Write a batch of physical pages together with their checksums
+    RC FileHandle::writePhysicalPages(const std::vector<PageNum> &physical_page_nums, const std::vector<char *> &buffers)
+    {
+        if (!canBatch(buffers))
+        {
+            for (size_t i = 0; i < physical_page_nums.size(); i++)
+            {
+                if (writePhysicalPage(physical_page_nums[i], buffers[i]) != 0)
+                {
+                    return -1;
+                }
+            }
+            return 0;
+        }
+
+        std::vector<unsigned> sums(physical_page_nums.size());
+        std::vector<IORequest> requests;
+        int checksum_fd = ioMode == IO_DIRECT ? metaFd : fd;
+        for (size_t i = 0; i < physical_page_nums.size(); i++)
+        {
+            requests.push_back({buffers[i], pageSize, (off_t)physical_page_nums[i] * pageSize, true, fd, 0});
+            if (checksums && physical_page_nums[i] > 0)
+            {
+                sums[i] = crc32c(buffers[i], pageSize);
+                requests.push_back({&sums[i], sizeof(unsigned), checksumOffset(physical_page_nums[i]), true,
+                                    checksum_fd, 0});
+            }
+        }
+        if (runBatch(ring.get(), requests) != 0)
+        {
+            perror("Error: Failed to write page data!");
+            return -1;
+        }
+
+        for (size_t i = 0; i < physical_page_nums.size(); i++)
+        {
+            writePageCounter++;
+            headerChanged();
+        }
+        return 0;
+    }
+
+    // The pages are counted as read when they are submitted, like a prefetch that completes at once
+    RC FileHandle::startPhysicalReads(const std::vector<PageNum> &physical_page_nums, const std::vector<char *> &buffers)
+    {
+        if (ring == nullptr || !canBatch(buffers))
+        {
+            return -1;
+        }
+
+        std::vector<IORequest> requests;
+        for (size_t i = 0; i < physical_page_nums.size(); i++)
+        {
+            requests.push_back({buffers[i], pageSize, (off_t)physical_page_nums[i] * pageSize, false, fd, 0});
+        }
+        if (ring->submit(requests) != 0)
+        {
+            return -1;
+        }
+
+        for (size_t i = 0; i < physical_page_nums.size(); i++)
+        {
+            readPageCounter++;
+            headerChanged();
+        }
+        return 0;
+    }
+
+    // Pages that arrived are checked against their checksums here, on the thread that owns the ring
+    RC FileHandle::finishPhysicalReads(bool wait, std::vector<size_t> &read_pages, std::vector<size_t> &failed_pages)
+    {
+        std::vector<size_t> completed;
+        if (ring == nullptr || ring->reap(wait, completed) != 0)
+        {
+            return -1;
+        }
+
+        for (size_t index : completed)
+        {
+            const IORequest &request = ring->batch[index];
+            if (request.result == (ssize_t)request.length &&
+                verifyChecksum(request.offset / pageSize, request.buffer) == 0)
+            {
+                read_pages.push_back(index);
+            }
+            else
+            {
+                failed_pages.push_back(index);
+            }
+        }
+        return 0;
+    }
+
+    bool FileHandle::physicalReadsPending()
+    {
+        return ring != nullptr && ring->pending();
+    }
+
+    // A batch needs a file descriptor, and under IO_DIRECT pages that can go past the page cache as they are.
+    // Anything else takes the single-page path.
+    bool FileHandle::canBatch(const std::vector<char *> &buffers)
+    {
+        if (ioMode != IO_DIRECT)
+        {
+            return ioMode == IO_POSIX;
+        }
+        if (!directAligned(0, pageSize))
+        {
+            return false;
+        }
+        for (char *buffer : buffers)
+        {
+            if (!directAligned(buffer))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    RC FileHandle::prefetchPages(const std::vector<PageNum> &page_nums)
+    {
+        std::vector<PageNum> physical_page_nums;
+        for (PageNum page_num : page_nums)
+        {
+            if (page_num >= numberOfPages)
+            {
+                perror("Error: Attempting to prefetch a non-existent page!");
+                return -1;
+            }
+            physical_page_nums.push_back(physicalPageNum(page_num));
+        }
+        return BufferManager::instance().prefetchPages(*this, physical_page_nums);
+    }
+
+    void FileHandle::setReadAhead(unsigned max_pages)
+    {
+        readAheadLimit = max_pages;
+        readAheadWindow = std::min(readAheadWindow, max_pages);
+    }
+
+    // Writes a page straight to the file. The page number includes the hidden page.
+    RC FileHandle::writePhysicalPage(PageNum physical_page_num, const void *buffer, bool background)
+    {
+        // Verify if the write operation was successful
+        if (writeBytes((off_t)physical_page_num * pageSize, buffer, pageSize) != 0 ||
+            storeChecksum(physical_page_num, buffer) != 0)
+        {
+            perror("Error: Failed to write page data!");
+            return -1;
+        }
+
+        // Update the write page counter; the pool counts background writes for the handle
+        if (!background)
+        {
+            writePageCounter++;
+            headerChanged();
+        }
+
+        return 0; // Success
+    }
+
+    unsigned FileHandle::getPageSize()
+    {
+        return pageSize;
+    }
+
+    // The page count is kept in memory from openFile() on.
+    unsigned FileHandle::getNumberOfPages()
+    {
+        return numberOfPages;
+    }
+
+    RC FileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount)
+    {
+        writePageCounter += BufferManager::instance().takeBackgroundWrites(fileId);
+        readPageCount = readPageCounter;
+        writePageCount = writePageCounter;
+        appendPageCount = appendPageCounter;
+        return 0;
+    }
+
+    // Persist the in-memory header every headerFlushInterval page I/Os (0 = only at close or checkpoint).
+    void FileHandle::headerChanged()
+    {
+        if (headerFlushInterval == 0)
+        {
+            return;
+        }
+
+        ioSinceHeaderFlush++;
+        if (ioSinceHeaderFlush >= headerFlushInterval)
+        {
+            writeHiddenPage();
+        }
+    }
+
+    void FileHandle::setHeaderFlushInterval(unsigned numOfIOs)
+    {
+        headerFlushInterval = numOfIOs;
+    }
+
+    // Write the page count and counters to the hidden page.
+    RC FileHandle::checkpoint()
+    {
+        return writeHiddenPage();
+    }
+
+    // Function to load the page count, counter values, format tag, page size, checksum flag, write generation
+    // and unclean flag from the hidden page in one read. Files written before the page size was recorded hold 0
+    // there and use PAGE_SIZE.
+    RC FileHandle::readHiddenPage()
+    {
+        unsigned header[9];
+        if (readBytes(0, header, sizeof(header)) != 0)
+        {
+            perror("Error reading the hidden page!");
+            return -1;
+        }
+
+        numberOfPages = header[0];
+        readPageCounter = header[1];
+        writePageCounter = header[2];
+        appendPageCounter = header[3];
+        formatTag = header[4];
+        pageSize = header[5] == 0 ? PAGE_SIZE : header[5];
+        checksums = header[6] != 0;
+        writeGeneration = header[7];
+        unclean = header[8] != 0;
+        if (pageSize < MIN_PAGE_SIZE || pageSize > MAX_PAGE_SIZE || (pageSize & (pageSize - 1)) != 0)
+        {
+            perror("Error: The hidden page holds an unsupported page size!");
+            return -1;
+        }
+        return 0;
+    }
+
+    // Function to write the page count and counter values to the hidden page in one write.
+    // A handle that has not set the unclean flag keeps whatever another handle of the file left there.
+    RC FileHandle::writeHiddenPage()
+    {
+        unsigned header[9] = {numberOfPages, readPageCounter, writePageCounter, appendPageCounter, formatTag, pageSize,
+                              checksums, writeGeneration, unclean};
+        if ((!unclean && readBytes(UNCLEAN_FLAG_OFFSET, &header[8], sizeof(unsigned)) != 0) ||
+            writeBytes(0, header, sizeof(header)) != 0)
+        {
+            perror("Error writing the hidden page!");
+            return -1;
+        }
+        ioSinceHeaderFlush = 0;
+        return 0;
+    }
+
+    // Function to initialize the hidden page with counter values and metadata.
+    RC FileHandle::initializeHiddenPage()
+    {
+        void *hiddenPageData = calloc(pageSize, 1); // Allocate memory for hidden page
+        if (!hiddenPageData)
+        {
+            perror("Memory allocation error for hidden page!");
+            return -1;
+        }
+
+        // Total page count, read, write and append counters all start at zero; the page size and checksum flag are set
+        memcpy((unsigned *)hiddenPageData + 5, &pageSize, sizeof(unsigned));
+        memcpy((unsigned *)hiddenPageData + 6, &checksums, sizeof(unsigned));
+
+        // Write the hidden page to the file
+        if (writeBytes(0, hiddenPageData, pageSize) != 0)
+        {
+            perror("Error writing the hidden page!");
+            free(hiddenPageData);
+            return -1;
+        }
+
+        free(hiddenPageData); // Free allocated memory
+        return 0;             // Success
+    }
+
+    RC FileHandle::setOpenFile(FILE *pFile)
+    {
+        file_pointer = pFile;
+        ioMode = IO_STDIO;
+        ioSinceHeaderFlush = 0;
+        return readHiddenPage();
+    }
+
+    bool FileHandle::isOpen()
+    {
+        return file_pointer != nullptr || fd >= 0;
+    }
+
+    // Close whichever descriptor the handle was opened with.
+    void FileHandle::closeDescriptor()
+    {
+        if (file_pointer != nullptr)
+        {
+            fclose(file_pointer);
+            file_pointer = nullptr;
+        }
+        if (fd >= 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+        if (metaFd >= 0)
+        {
+            close(metaFd);
+            metaFd = -1;
+        }
+        ring.reset();
+        ioEngine = IO_ENGINE_PREAD;
+    }
+
+    // Read length bytes at the given file offset.
+    // pread does not move a shared file position, so concurrent readers do not race on a seek.
+    RC FileHandle::readBytes(off_t offset, void *buffer, size_t length)
+    {
+        if (ioMode == IO_DIRECT)
+        {
+            return directBytes(offset, buffer, length, false);
+        }
+        if (ioMode == IO_POSIX)
+        {
+            return pread(fd, buffer, length, offset) == (ssize_t)length ? 0 : -1;
+        }
+
+        fseek(file_pointer, offset, SEEK_SET);
+        return fread(buffer, sizeof(char), length, file_pointer) == length ? 0 : -1;
+    }
+
+    // Write length bytes at the given file offset. The stdio stream is flushed so the
+    // data reaches the kernel just like with pwrite.
+    RC FileHandle::writeBytes(off_t offset, const void *buffer, size_t length)
+    {
+        if (ioMode == IO_DIRECT)
+        {
+            return directBytes(offset, const_cast<void *>(buffer), length, true);
+        }
+        if (ioMode == IO_POSIX)
+        {
+            return pwrite(fd, buffer, length, offset) == (ssize_t)length ? 0 : -1;
+        }
+
+        fseek(file_pointer, offset, SEEK_SET);
+        if (fwrite(buffer, sizeof(char), length, file_pointer) != length)
+        {
+            return -1;
+        }
+        return fflush(file_pointer) == 0 ? 0 : -1;
+    }
+
+    // IO_DIRECT transfer. Whole aligned blocks go past the page cache; a buffer that is not aligned itself is
+    // copied through a scratch buffer that is. Anything smaller, like the hidden page header or a stored
+    // checksum, goes through the buffered descriptor, which the kernel keeps coherent with the direct one.
+    RC FileHandle::directBytes(off_t offset, void *buffer, size_t length, bool write)
+    {
+        if (!directAligned(offset, length))
+        {
+            ssize_t moved = write ? pwrite(metaFd, buffer, length, offset) : pread(metaFd, buffer, length, offset);
+            return moved == (ssize_t)length ? 0 : -1;
+        }
+        if (directAligned(buffer))
+        {
+            ssize_t moved = write ? pwrite(fd, buffer, length, offset) : pread(fd, buffer, length, offset);
+            return moved == (ssize_t)length ? 0 : -1;
+        }
+
+        ScratchBuffer bounce(length);
+        if (write)
+        {
+            memcpy(bounce.data(), buffer, length);
+            return pwrite(fd, bounce.data(), length, offset) == (ssize_t)length ? 0 : -1;
+        }
+        if (pread(fd, bounce.data(), length, offset) != (ssize_t)length)
+        {
+            return -1;
+        }
+        memcpy(buffer, bounce.data(), length);
+        return 0;
+    }
+
+    FILE *FileHandle::getFile()
+    {
+        return file_pointer;
+    }
     std::string FileHandle::getFileName()
     {
         return fileName;
@@ -415,4 +3004,285 @@ namespace PeterDB
         this->fileName.assign(file_name);
     }
 
+    PageScrubber::PageScrubber() : stopRequested(false), running(false)
+    {
+        stats.passes = 0;
+        stats.pagesChecked = 0;
+    }
+
+    PageScrubber::~PageScrubber()
+    {
+        stop();
+    }
+
+    RC PageScrubber::start(const std::string &file_name, unsigned pages_per_second, bool repeat)
+    {
+        if (pages_per_second == 0)
+        {
+            perror("Error: A scrubber needs a page rate!");
+            return -1;
+        }
+        if (isRunning())
+        {
+            perror("Error: The scrubber is already running!");
+            return -1;
+        }
+        wait();
+
+        std::lock_guard<std::mutex> guard(latch);
+        stopRequested = false;
+        running = true;
+        stats.passes = 0;
+        stats.pagesChecked = 0;
+        stats.corruptPages.clear();
+        worker = std::thread(&PageScrubber::run, this, file_name, pages_per_second, repeat);
+        return 0;
+    }
+
+    RC PageScrubber::stop()
+    {
+        {
+            std::lock_guard<std::mutex> guard(latch);
+            stopRequested = true;
+        }
+        wakeup.notify_all();
+        return wait();
+    }
+
+    RC PageScrubber::wait()
+    {
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+        return 0;
+    }
+
+    bool PageScrubber::isRunning()
+    {
+        std::lock_guard<std::mutex> guard(latch);
+        return running;
+    }
+
+    void PageScrubber::getStats(ScrubStats &scrub_stats)
+    {
+        std::lock_guard<std::mutex> guard(latch);
+        scrub_stats = stats;
+    }
+
+    // Sleep until the given time; returns false as soon as a stop is asked for
+    bool PageScrubber::pause(std::chrono::steady_clock::time_point until)
+    {
+        std::unique_lock<std::mutex> lock(latch);
+        wakeup.wait_until(lock, until, [this] { return stopRequested; });
+        return !stopRequested;
+    }
+
+    void PageScrubber::run(std::string file_name, unsigned pages_per_second, bool repeat)
+    {
+        // A private read-only handle: it is never registered with the pool and its hidden page is never written
+        FileHandle file_handle;
+        file_handle.ioMode = IO_POSIX;
+        file_handle.fd = open(file_name.c_str(), O_RDONLY);
+        if (file_handle.fd < 0 || file_handle.readHiddenPage() != 0 || !file_handle.checksums)
+        {
+            perror("Error: The scrubber cannot check this file!");
+            file_handle.closeDescriptor();
+            std::lock_guard<std::mutex> guard(latch);
+            running = false;
+            return;
+        }
+
+        ScratchBuffer page(file_handle.pageSize);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        unsigned long long checked = 0;
+        bool keepGoing = true;
+        while (keepGoing)
+        {
+            // Pages appended while the scrubber runs are picked up by its next pass
+            struct stat file_stat;
+            PageNum physical_pages = fstat(file_handle.fd, &file_stat) == 0 ? file_stat.st_size / file_handle.pageSize : 0;
+            for (PageNum physical_page_num = 1; physical_page_num < physical_pages && keepGoing; physical_page_num++)
+            {
+                if (file_handle.isChecksumPage(physical_page_num))
+                {
+                    continue;
+                }
+
+                bool intact;
+                RC rc = file_handle.checkPhysicalPage(physical_page_num, page.data(), intact);
+                if (rc == 0 && !intact)
+                {
+                    keepGoing = pause(std::chrono::steady_clock::now() + std::chrono::milliseconds(10));
+                    rc = file_handle.checkPhysicalPage(physical_page_num, page.data(), intact);
+                }
+
+                checked++;
+                {
+                    std::lock_guard<std::mutex> guard(latch);
+                    stats.pagesChecked++;
+                    if (rc != 0 || !intact)
+                        stats.corruptPages.push_back(physical_page_num);
+                }
+                keepGoing = keepGoing &&
+                            pause(start + std::chrono::microseconds(checked * 1000000 / pages_per_second));
+            }
+
+            std::lock_guard<std::mutex> guard(latch);
+            if (keepGoing)
+                stats.passes++;
+            keepGoing = keepGoing && repeat && !stopRequested;
+        }
+
+        file_handle.closeDescriptor();
+        std::lock_guard<std::mutex> guard(latch);
+        running = false;
+    }
+
+    PageFlusher::PageFlusher() : stopRequested(false), running(false)
+    {
+        stats.pagesWritten = 0;
+        stats.checkpoints = 0;
+    }
+
+    PageFlusher::~PageFlusher()
+    {
+        stop();
+    }
+
+    RC PageFlusher::start(const FlusherOptions &options)
+    {
+        if (options.pagesPerSecond == 0)
+        {
+            perror("Error: A flusher needs a page rate!");
+            return -1;
+        }
+        if (options.lowWaterPercent > options.highWaterPercent || options.highWaterPercent > 100)
+        {
+            perror("Error: The low-water mark must not be above the high-water mark!");
+            return -1;
+        }
+        if (isRunning())
+        {
+            perror("Error: The flusher is already running!");
+            return -1;
+        }
+        stop();
+
+        std::lock_guard<std::mutex> guard(latch);
+        stopRequested = false;
+        running = true;
+        stats.pagesWritten = 0;
+        stats.checkpoints = 0;
+        worker = std::thread(&PageFlusher::run, this, options);
+        return 0;
+    }
+
+    RC PageFlusher::stop()
+    {
+        {
+            std::lock_guard<std::mutex> guard(latch);
+            stopRequested = true;
+        }
+        wakeup.notify_all();
+        if (worker.joinable())
+        {
+            worker.join();
+        }
+        return 0;
+    }
+
+    bool PageFlusher::isRunning()
+    {
+        std::lock_guard<std::mutex> guard(latch);
+        return running;
+    }
+
+    void PageFlusher::getStats(FlusherStats &flusher_stats)
+    {
+        std::lock_guard<std::mutex> guard(latch);
+        flusher_stats = stats;
+    }
+
+    // Sleep until the given time; returns false as soon as a stop is asked for
+    bool PageFlusher::pause(std::chrono::steady_clock::time_point until)
+    {
+        std::unique_lock<std::mutex> lock(latch);
+        wakeup.wait_until(lock, until, [this] { return stopRequested; });
+        return !stopRequested;
+    }
+
+    void PageFlusher::run(FlusherOptions options)
+    {
+        BufferManager &pool = BufferManager::instance();
+        const unsigned batch_limit = FLUSH_BATCH_PAGES;
+        std::chrono::steady_clock::time_point lastCheckpoint = std::chrono::steady_clock::now();
+        bool draining = false;
+        bool checkpointing = false;
+        bool keepGoing = true;
+        while (keepGoing)
+        {
+            std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (options.checkpointMs > 0 && !checkpointing &&
+                now - lastCheckpoint >= std::chrono::milliseconds(options.checkpointMs))
+            {
+                checkpointing = pool.beginCheckpoint() == 0;
+                lastCheckpoint = now;
+            }
+
+            // Past the high-water mark write at full speed until the low-water mark, otherwise trickle
+            unsigned dirtyPercent = pool.getDirtyFrames() * 100 / pool.getNumFrames();
+            if (dirtyPercent >= options.highWaterPercent)
+            {
+                draining = true;
+            }
+            else if (dirtyPercent <= options.lowWaterPercent)
+            {
+                draining = false;
+            }
+            unsigned batch = draining ? FLUSH_BATCH_PAGES : std::max(1u, std::min(options.pagesPerSecond / 100, batch_limit));
+
+            unsigned written = 0;
+            if (pool.flushDirtyFrames(batch, written, draining) != 0)
+            {
+                written = 0;
+            }
+            if (checkpointing && pool.isCheckpointFlushed())
+            {
+                RC rc = pool.completeCheckpoint();
+                checkpointing = false;
+                std::lock_guard<std::mutex> guard(latch);
+                if (rc == 0)
+                    stats.checkpoints++;
+            }
+            {
+                std::lock_guard<std::mutex> guard(latch);
+                stats.pagesWritten += written;
+            }
+
+            // Written pages are paid for at the trickle rate; with nothing to write, look again in 10 ms
+            if (written == 0)
+            {
+                keepGoing = pause(now + std::chrono::milliseconds(10));
+            }
+            else if (!draining)
+            {
+                keepGoing = pause(now + std::chrono::microseconds(written * 1000000ull / options.pagesPerSecond));
+            }
+            else
+            {
+                std::lock_guard<std::mutex> guard(latch);
+                keepGoing = !stopRequested;
+            }
+        }
+
+        // Leave no checkpoint half done for the next flusher
+        if (checkpointing)
+        {
+            pool.abortCheckpoint();
+        }
+        std::lock_guard<std::mutex> guard(latch);
+        running = false;
+    }
+
 } // namespace PeterDB
\ No newline at end of file
@@ -1,394 +1,2901 @@
 #include "src/include/rbfm.h"
 #include <climits>
 #include <cstring>
+#include <algorithm>
+#include <ostream>
 #include "math.h"
 
 namespace PeterDB
 {
     PagedFileManager &_pf_manager = PagedFileManager::instance();
 
+    // Page layout: records grow from the start of the page, the slot directory grows backwards from the end.
+    // [record 1][record 2]...[free space]...[slot 2][slot 1][slot count][used space]
+    // Each slot holds the offset and the length of its record; slot numbers start at 1.
+    static const int PAGE_HEADER_SIZE = sizeof(int) * 2;
+    static const int SLOT_ENTRY_SIZE = sizeof(int) * 2;
+
+    static int getSlotCount(const char *pageData, unsigned pageSize)
+    {
+        int slotCount;
+        memcpy(&slotCount, pageData + pageSize - sizeof(int) * 2, sizeof(int));
+        return slotCount;
+    }
+
+    static int getUsedSpace(const char *pageData, unsigned pageSize)
+    {
+        int usedSpace;
+        memcpy(&usedSpace, pageData + pageSize - sizeof(int), sizeof(int));
+        return usedSpace;
+    }
+
+    static void setPageHeader(char *pageData, unsigned pageSize, int slotCount, int usedSpace)
+    {
+        memcpy(pageData + pageSize - sizeof(int) * 2, &slotCount, sizeof(int));
+        memcpy(pageData + pageSize - sizeof(int), &usedSpace, sizeof(int));
+    }
+
+    static void setSlot(char *pageData, unsigned pageSize, int slotNum, int recordOffset, int recordLength)
+    {
+        char *slot = pageData + pageSize - PAGE_HEADER_SIZE - SLOT_ENTRY_SIZE * slotNum;
+        memcpy(slot, &recordOffset, sizeof(int));
+        memcpy(slot + sizeof(int), &recordLength, sizeof(int));
+    }
+
+    static void getSlot(const char *pageData, unsigned pageSize, int slotNum, int &recordOffset, int &recordLength)
+    {
+        const char *slot = pageData + pageSize - PAGE_HEADER_SIZE - SLOT_ENTRY_SIZE * slotNum;
+        memcpy(&recordOffset, slot, sizeof(int));
+        memcpy(&recordLength, slot + sizeof(int), sizeof(int));
+    }
+
+    // Bytes left between the end of the records and the start of the slot directory
+    static unsigned getFreeBytes(const char *pageData, unsigned pageSize)
+    {
+        return pageSize - PAGE_HEADER_SIZE - SLOT_ENTRY_SIZE * getSlotCount(pageData, pageSize) - getUsedSpace(pageData, pageSize);
+    }
+
+    // Slot states:
+    //   record     offset >= 0, length >= 0
+    //   empty      offset == -1 (the record was deleted)
+    //   tombstone  length < 0; the record moved to page "offset", slot "-length"
+    // A record that was moved away from its home page is stored behind a forward header
+    // [-1][home page][home slot]; a stored record always starts with a non-negative field count,
+    // so the header can be told apart from the record. Forwarding is never chained: a moved record
+    // is always one hop away from its home slot.
+    static const int EMPTY_SLOT = -1;
+    static const int FORWARD_HEADER_SIZE = sizeof(int) * 3;
+
+    static bool isTombstone(int recordOffset, int recordLength)
+    {
+        return recordOffset >= 0 && recordLength < 0;
+    }
+
+    static void setTombstone(char *pageData, unsigned pageSize, int slotNum, const RID &target)
+    {
+        setSlot(pageData, pageSize, slotNum, target.pageNum, -(int)target.slotNum);
+    }
+
+    static bool isForwardedRecord(const char *pageData, int recordOffset)
+    {
+        int marker;
+        memcpy(&marker, pageData + recordOffset, sizeof(int));
+        return marker < 0;
+    }
+
+    static void writeForwardHeader(char *destination, const RID &home)
+    {
+        int marker = -1;
+        int homePage = home.pageNum;
+        int homeSlot = home.slotNum;
+        memcpy(destination, &marker, sizeof(int));
+        memcpy(destination + sizeof(int), &homePage, sizeof(int));
+        memcpy(destination + sizeof(int) * 2, &homeSlot, sizeof(int));
+    }
+
+    static void readForwardHeader(const char *source, RID &home)
+    {
+        int homePage, homeSlot;
+        memcpy(&homePage, source + sizeof(int), sizeof(int));
+        memcpy(&homeSlot, source + sizeof(int) * 2, sizeof(int));
+        home.pageNum = homePage;
+        home.slotNum = homeSlot;
+    }
+
+    // Free bytes the page would have after compaction: everything except the header, the slot
+    // directory and the live records. This is what the free-space map records.
+    static unsigned getReclaimableBytes(const char *pageData, unsigned pageSize)
+    {
+        int slotCount = getSlotCount(pageData, pageSize);
+        int liveBytes = 0;
+        for (int slotNum = 1; slotNum <= slotCount; slotNum++)
+        {
+            int recordOffset, recordLength;
+            getSlot(pageData, pageSize, slotNum, recordOffset, recordLength);
+            if (recordOffset >= 0 && recordLength > 0)
+                liveBytes += recordLength;
+        }
+        return pageSize - PAGE_HEADER_SIZE - SLOT_ENTRY_SIZE * slotCount - liveBytes;
+    }
+
+    // Slide the live records to the start of the page, closing the holes left by deletes and
+    // updates. Slot numbers do not change, only the offsets stored in the slots.
+    static void compactPage(char *pageData, unsigned pageSize)
+    {
+        int slotCount = getSlotCount(pageData, pageSize);
+        ScratchBuffer slotBuffer(slotCount * sizeof(std::pair<int, int>));
+        std::pair<int, int> *liveSlots = (std::pair<int, int> *)slotBuffer.data(); // (offset, slot number)
+        int liveCount = 0;
+        for (int slotNum = 1; slotNum <= slotCount; slotNum++)
+        {
+            int recordOffset, recordLength;
+            getSlot(pageData, pageSize, slotNum, recordOffset, recordLength);
+            if (recordOffset >= 0 && recordLength > 0)
+                liveSlots[liveCount++] = std::make_pair(recordOffset, slotNum);
+        }
+        std::sort(liveSlots, liveSlots + liveCount);
+
+        int usedSpace = 0;
+        for (int i = 0; i < liveCount; i++)
+        {
+            const std::pair<int, int> &liveSlot = liveSlots[i];
+            int recordOffset, recordLength;
+            getSlot(pageData, pageSize, liveSlot.second, recordOffset, recordLength);
+            if (recordOffset != usedSpace)
+            {
+                memmove(pageData + usedSpace, pageData + recordOffset, recordLength);
+                setSlot(pageData, pageSize, liveSlot.second, usedSpace, recordLength);
+            }
+            usedSpace += recordLength;
+        }
+        setPageHeader(pageData, pageSize, slotCount, usedSpace);
+    }
+
+    // Make sure the page has bytesNeeded contiguous free bytes, compacting it if that helps.
+    // The page is left untouched when even compaction would not free enough.
+    static bool makeRoom(char *pageData, unsigned pageSize, int bytesNeeded)
+    {
+        if ((int)getFreeBytes(pageData, pageSize) >= bytesNeeded)
+            return true;
+        if ((int)getReclaimableBytes(pageData, pageSize) < bytesNeeded)
+            return false;
+        compactPage(pageData, pageSize);
+        return true;
+    }
+
+    // First empty slot of the page, or 0 if every slot is in use
+    static int findEmptySlot(const char *pageData, unsigned pageSize)
+    {
+        int slotCount = getSlotCount(pageData, pageSize);
+        for (int slotNum = 1; slotNum <= slotCount; slotNum++)
+        {
+            int recordOffset, recordLength;
+            getSlot(pageData, pageSize, slotNum, recordOffset, recordLength);
+            if (recordOffset == EMPTY_SLOT)
+                return slotNum;
+        }
+        return 0;
+    }
+
+    // Empty a slot; empty slots at the end of the directory are dropped from it
+    static void releaseSlot(char *pageData, unsigned pageSize, int slotNum)
+    {
+        setSlot(pageData, pageSize, slotNum, EMPTY_SLOT, 0);
+
+        int slotCount = getSlotCount(pageData, pageSize);
+        int recordOffset, recordLength;
+        while (slotCount > 0)
+        {
+            getSlot(pageData, pageSize, slotCount, recordOffset, recordLength);
+            if (recordOffset != EMPTY_SLOT)
+                break;
+            slotCount--;
+        }
+        setPageHeader(pageData, pageSize, slotCount, getUsedSpace(pageData, pageSize));
+    }
+
+    // Write an image at the end of the records of the page and point an existing slot at it
+    static void appendToSlot(char *pageData, unsigned pageSize, int slotNum, const void *image, int imageSize)
+    {
+        int usedSpace = getUsedSpace(pageData, pageSize);
+        memcpy(pageData + usedSpace, image, imageSize);
+        setSlot(pageData, pageSize, slotNum, usedSpace, imageSize);
+        setPageHeader(pageData, pageSize, getSlotCount(pageData, pageSize), usedSpace + imageSize);
+    }
+
+    // Locate a field inside a record in the stored format without decoding the record
+    static void getStoredField(const char *recordPtr, int fieldIndex, int &fieldStart, int &fieldLength, bool &isNull)
+    {
+        int numFields;
+        memcpy(&numFields, recordPtr, sizeof(int));
+        int nullIndicatorSize = ceil((double)numFields / CHAR_BIT);
+        const char *nullIndicator = recordPtr + sizeof(int);
+        const char *directory = recordPtr + sizeof(int) + nullIndicatorSize;
+
+        isNull = nullIndicator[fieldIndex / 8] & (1 << (7 - fieldIndex % 8));
+        if (fieldIndex == 0)
+            fieldStart = sizeof(int) + nullIndicatorSize + numFields * sizeof(int);
+        else
+            memcpy(&fieldStart, directory + (fieldIndex - 1) * sizeof(int), sizeof(int));
+
+        int fieldEnd;
+        memcpy(&fieldEnd, directory + fieldIndex * sizeof(int), sizeof(int));
+        fieldStart &= ~OVERFLOW_FIELD_FLAG;
+        fieldLength = (fieldEnd & ~OVERFLOW_FIELD_FLAG) - fieldStart;
+    }
+
+    // True when a field of a stored record keeps its value on overflow pages
+    static bool isOverflowField(const char *recordPtr, int fieldIndex)
+    {
+        int numFields;
+        memcpy(&numFields, recordPtr, sizeof(int));
+        int fieldEnd;
+        memcpy(&fieldEnd, recordPtr + sizeof(int) + (int)ceil((double)numFields / CHAR_BIT) + fieldIndex * sizeof(int),
+               sizeof(int));
+        return fieldEnd & OVERFLOW_FIELD_FLAG;
+    }
+
+    // Pin the page holding the record of a RID, following at most one forward.
+    // On success the record starts at pageData + recordOffset and the caller must unpin pinnedPage.
+    static RC pinRecord(FileHandle &fileHandle, const RID &rid, PageNum &pinnedPage, char *&pageData,
+                        int &recordOffset, int &recordLength)
+    {
+        unsigned pageSize = fileHandle.getPageSize();
+        if (fileHandle.pinPage(rid.pageNum, pageData) != 0)
+        {
+            return -1;
+        }
+        pinnedPage = rid.pageNum;
+
+        if (rid.slotNum < 1 || rid.slotNum > getSlotCount(pageData, pageSize))
+        {
+            fileHandle.unpinPage(pinnedPage, false);
+            return -1;
+        }
+        getSlot(pageData, pageSize, rid.slotNum, recordOffset, recordLength);
+
+        if (isTombstone(recordOffset, recordLength))
+        {
+            RID target;
+            target.pageNum = recordOffset;
+            target.slotNum = -recordLength;
+            fileHandle.unpinPage(pinnedPage, false);
+            if (fileHandle.pinPage(target.pageNum, pageData) != 0)
+            {
+                return -1;
+            }
+            pinnedPage = target.pageNum;
+            getSlot(pageData, pageSize, target.slotNum, recordOffset, recordLength);
+            if (recordOffset < 0 || recordLength < 0 || !isForwardedRecord(pageData, recordOffset))
+            {
+                perror("Error: Broken record forward!");
+                fileHandle.unpinPage(pinnedPage, false);
+                return -1;
+            }
+            recordOffset += FORWARD_HEADER_SIZE;
+            recordLength -= FORWARD_HEADER_SIZE;
+            return 0;
+        }
+
+        // Empty slots and the moved-in copy of another RID's record are not addressable
+        if (recordOffset < 0 || isForwardedRecord(pageData, recordOffset))
+        {
+            fileHandle.unpinPage(pinnedPage, false);
+            return -1;
+        }
+        return 0;
+    }
+
+    // Overflow pages: a VarChar value that does not fit in its record's page is split over a chain of
+    // pages. The record keeps [first OVERFLOW_PREFIX_SIZE bytes][value length][first overflow page].
+    // Overflow page: [value bytes]...[next page, -1 at the end][OVERFLOW_PAGE][bytes on this page],
+    // i.e. a page whose slot count is OVERFLOW_PAGE, so scans, compaction and vacuum pass it by.
+    // Its space map entry is reserved, so inserts and scans skip it without reading it, until the chain
+    // is freed and it becomes an empty data page.
+    static const int OVERFLOW_PAGE = -1;
+    static const int OVERFLOW_FIELD_SIZE = OVERFLOW_PREFIX_SIZE + sizeof(int) * 2;
+
+    static int getOverflowPageCapacity(unsigned pageSize)
+    {
+        return pageSize - PAGE_HEADER_SIZE - sizeof(int);
+    }
+
+    // Largest record kept whole: it still fits in an empty page behind a forward header
+    static int getMaxInlineRecordSize(unsigned pageSize)
+    {
+        return pageSize - PAGE_HEADER_SIZE - SLOT_ENTRY_SIZE - FORWARD_HEADER_SIZE;
+    }
+
+    static bool isOverflowPage(const char *pageData, unsigned pageSize)
+    {
+        return getSlotCount(pageData, pageSize) == OVERFLOW_PAGE;
+    }
+
+    // Full length of a value kept on overflow pages, from its inline part
+    static int getOverflowLength(const char *fieldPtr)
+    {
+        int length;
+        memcpy(&length, fieldPtr + OVERFLOW_PREFIX_SIZE, sizeof(int));
+        return length;
+    }
+
+    static PageNum getOverflowHead(const char *fieldPtr)
+    {
+        PageNum pageNum;
+        memcpy(&pageNum, fieldPtr + OVERFLOW_PREFIX_SIZE + sizeof(int), sizeof(int));
+        return pageNum;
+    }
+
+    // Append a chain of overflow pages holding the value; the chain starts at firstPage
+    static RC writeOverflowValue(FileHandle &fileHandle, const char *value, int length, PageNum &firstPage)
+    {
+        unsigned pageSize = fileHandle.getPageSize();
+        ScratchBuffer pageBuffer(pageSize, true);
+        char *page = pageBuffer.data();
+        firstPage = fileHandle.getNumberOfPages();
+        for (int written = 0; written < length;)
+        {
+            int chunk = std::min(length - written, getOverflowPageCapacity(pageSize));
+            PageNum pageNum = fileHandle.getNumberOfPages();
+            int nextPage = written + chunk < length ? (int)pageNum + 1 : -1;
+            memcpy(page, value + written, chunk);
+            memcpy(page + getOverflowPageCapacity(pageSize), &nextPage, sizeof(int));
+            setPageHeader(page, pageSize, OVERFLOW_PAGE, chunk);
+            if (fileHandle.appendPage(page) != 0 || fileHandle.setPageReserved(pageNum) != 0)
+            {
+                return -1;
+            }
+            written += chunk;
+        }
+        return 0;
+    }
+
+    // Copy a value kept on overflow pages into "value", given the field's inline part
+    static RC readOverflowValue(FileHandle &fileHandle, const char *fieldPtr, char *value)
+    {
+        unsigned pageSize = fileHandle.getPageSize();
+        int length = getOverflowLength(fieldPtr);
+        PageNum pageNum = getOverflowHead(fieldPtr);
+        for (int copied = 0; copied < length;)
+        {
+            char *pageData;
+            if (fileHandle.pinPage(pageNum, pageData) != 0)
+            {
+                return -1;
+            }
+            int chunk = getUsedSpace(pageData, pageSize);
+            if (!isOverflowPage(pageData, pageSize) || chunk <= 0 || copied + chunk > length)
+            {
+                perror("Error: Broken overflow chain!");
+                fileHandle.unpinPage(pageNum, false);
+                return -1;
+            }
+            memcpy(value + copied, pageData, chunk);
+            copied += chunk;
+            int nextPage;
+            memcpy(&nextPage, pageData + getOverflowPageCapacity(pageSize), sizeof(int));
+            fileHandle.unpinPage(pageNum, false);
+            pageNum = nextPage;
+        }
+        return 0;
+    }
+
+    // Turn every page of a chain back into an empty data page
+    static RC freeOverflowChain(FileHandle &fileHandle, PageNum pageNum)
+    {
+        unsigned pageSize = fileHandle.getPageSize();
+        while ((int)pageNum >= 0)
+        {
+            char *pageData;
+            if (fileHandle.pinPage(pageNum, pageData) != 0)
+            {
+                return -1;
+            }
+            if (!isOverflowPage(pageData, pageSize))
+            {
+                fileHandle.unpinPage(pageNum, false);
+                return -1;
+            }
+            int nextPage;
+            memcpy(&nextPage, pageData + getOverflowPageCapacity(pageSize), sizeof(int));
+            setPageHeader(pageData, pageSize, 0, 0);
+            unsigned freeBytes = getFreeBytes(pageData, pageSize);
+            fileHandle.unpinPage(pageNum, true);
+            if (fileHandle.setFreeSpace(pageNum, freeBytes) != 0)
+            {
+                return -1;
+            }
+            pageNum = nextPage;
+        }
+        return 0;
+    }
+
+    static bool hasOverflowFields(const char *recordPtr)
+    {
+        int numFields;
+        memcpy(&numFields, recordPtr, sizeof(int));
+        for (int fieldIndex = 0; fieldIndex < numFields; fieldIndex++)
+        {
+            if (isOverflowField(recordPtr, fieldIndex))
+                return true;
+        }
+        return false;
+    }
+
+    // First page of the overflow chain of every field of a stored record that has one
+    static void collectOverflowHeads(const char *recordPtr, std::vector<PageNum> &heads)
+    {
+        int numFields;
+        memcpy(&numFields, recordPtr, sizeof(int));
+        for (int fieldIndex = 0; fieldIndex < numFields; fieldIndex++)
+        {
+            if (!isOverflowField(recordPtr, fieldIndex))
+            {
+                continue;
+            }
+            int fieldStart, fieldLength;
+            bool isNull;
+            getStoredField(recordPtr, fieldIndex, fieldStart, fieldLength, isNull);
+            heads.push_back(getOverflowHead(recordPtr + fieldStart));
+        }
+    }
+
+    // Free the overflow chains of a stored record
+    static RC freeOverflowFields(FileHandle &fileHandle, const char *recordPtr)
+    {
+        std::vector<PageNum> heads;
+        collectOverflowHeads(recordPtr, heads);
+        RC rc = 0;
+        for (PageNum head : heads)
+        {
+            if (freeOverflowChain(fileHandle, head) != 0)
+                rc = -1;
+        }
+        return rc;
+    }
+
+    // Move the longest VarChar values of a stored image to overflow pages, one at a time, until the
+    // image fits in a page. The image shrinks in place; returns its new size, or -1.
+    static int spillRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor, char *image,
+                           int imageSize)
+    {
+        unsigned pageSize = fileHandle.getPageSize();
+        int numFields = recordDescriptor.size();
+        char *directory = image + sizeof(int) + (int)ceil((double)numFields / CHAR_BIT);
+        while (imageSize > getMaxInlineRecordSize(pageSize))
+        {
+            int victim = -1, victimStart = 0, victimLength = OVERFLOW_FIELD_SIZE;
+            for (int fieldIndex = 0; fieldIndex < numFields; fieldIndex++)
+            {
+                int fieldStart, fieldLength;
+                bool isNull;
+                if (recordDescriptor[fieldIndex].type != TypeVarChar || isOverflowField(image, fieldIndex))
+                {
+                    continue;
+                }
+                getStoredField(image, fieldIndex, fieldStart, fieldLength, isNull);
+                if (!isNull && fieldLength > victimLength)
+                {
+                    victim = fieldIndex;
+                    victimStart = fieldStart;
+                    victimLength = fieldLength;
+                }
+            }
+
+            PageNum firstPage;
+            if (victim < 0 || writeOverflowValue(fileHandle, image + victimStart, victimLength, firstPage) != 0)
+            {
+                perror("Error: Record does not fit in a page!");
+                freeOverflowFields(fileHandle, image);
+                return -1;
+            }
+
+            // Keep the prefix, put the length and the chain behind it and slide the rest of the record down
+            int shrink = victimLength - OVERFLOW_FIELD_SIZE;
+            memcpy(image + victimStart + OVERFLOW_PREFIX_SIZE, &victimLength, sizeof(int));
+            memcpy(image + victimStart + OVERFLOW_PREFIX_SIZE + sizeof(int), &firstPage, sizeof(int));
+            memmove(image + victimStart + OVERFLOW_FIELD_SIZE, image + victimStart + victimLength,
+                    imageSize - victimStart - victimLength);
+            imageSize -= shrink;
+            for (int fieldIndex = victim; fieldIndex < numFields; fieldIndex++)
+            {
+                int fieldEnd;
+                memcpy(&fieldEnd, directory + fieldIndex * sizeof(int), sizeof(int));
+                fieldEnd -= shrink;
+                if (fieldIndex == victim)
+                    fieldEnd |= OVERFLOW_FIELD_FLAG;
+                memcpy(directory + fieldIndex * sizeof(int), &fieldEnd, sizeof(int));
+            }
+        }
+        return imageSize;
+    }
+
+    // PAX page layout: the records of a page are split by attribute, so the values of one attribute
+    // are contiguous. Rows are numbered from 1 like slots and keep their number for life.
+    // [row states][null indicators][minipage 1]...[minipage n]...[free space]...[minipage starts][used space][row count][column count]
+    //   row states       one byte per row: 1 live, 0 deleted
+    //   null indicators  the null indicator of every row, as in the stored record
+    //   Int, Real        4 bytes per row, zero when the field is null
+    //   VarChar          one end offset per row into the characters, followed by the characters
+    // Every change rebuilds the page from its rows.
+    static int getPaxColumnCount(const char *pageData, unsigned pageSize)
+    {
+        int numColumns;
+        memcpy(&numColumns, pageData + pageSize - sizeof(int), sizeof(int));
+        return numColumns;
+    }
+
+    static int getPaxRowCount(const char *pageData, unsigned pageSize)
+    {
+        int rowCount;
+        memcpy(&rowCount, pageData + pageSize - sizeof(int) * 2, sizeof(int));
+        return rowCount;
+    }
+
+    static int getPaxUsedSpace(const char *pageData, unsigned pageSize)
+    {
+        int usedSpace;
+        memcpy(&usedSpace, pageData + pageSize - sizeof(int) * 3, sizeof(int));
+        return usedSpace;
+    }
+
+    static int getPaxTrailerSize(int numColumns)
+    {
+        return (numColumns + 3) * sizeof(int);
+    }
+
+    // Free bytes of a page just built by buildPaxPage, which holds no characters of deleted rows,
+    // read from its trailer instead of walking its minipages
+    static unsigned getPaxFreeBytes(const char *pageData, unsigned pageSize)
+    {
+        int trailerSize = getPaxTrailerSize(getPaxColumnCount(pageData, pageSize));
+        return pageSize - trailerSize - getPaxUsedSpace(pageData, pageSize);
+    }
+
+    static int getPaxColumnStart(const char *pageData, unsigned pageSize, int columnIndex)
+    {
+        int columnStart;
+        memcpy(&columnStart, pageData + pageSize - getPaxTrailerSize(getPaxColumnCount(pageData, pageSize)) +
+                                 columnIndex * sizeof(int), sizeof(int));
+        return columnStart;
+    }
+
+    static bool isPaxRowLive(const char *pageData, int rowIndex)
+    {
+        return pageData[rowIndex] != 0;
+    }
+
+    static bool isPaxFile(FileHandle &fileHandle)
+    {
+        return fileHandle.formatTag == LAYOUT_PAX;
+    }
+
+    // Locate a field of a PAX row (counted from 0); attributes added after the page was built are null
+    static void getPaxField(const char *pageData, unsigned pageSize, AttrType type, int rowIndex, int columnIndex, const char *&fieldPtr,
+                            int &fieldLength, bool &isNull)
+    {
+        int rowCount = getPaxRowCount(pageData, pageSize);
+        int numColumns = getPaxColumnCount(pageData, pageSize);
+        fieldPtr = nullptr;
+        fieldLength = 0;
+        if (columnIndex >= numColumns)
+        {
+            isNull = true;
+            return;
+        }
+
+        int nullIndicatorSize = ceil((double)numColumns / CHAR_BIT);
+        const char *nullIndicator = pageData + rowCount + rowIndex * nullIndicatorSize;
+        isNull = nullIndicator[columnIndex / 8] & (1 << (7 - columnIndex % 8));
+
+        const char *minipage = pageData + getPaxColumnStart(pageData, pageSize, columnIndex);
+        if (type != TypeVarChar)
+        {
+            fieldPtr = minipage + rowIndex * sizeof(int);
+            fieldLength = sizeof(int);
+            return;
+        }
+
+        int begin = 0, end;
+        if (rowIndex > 0)
+            memcpy(&begin, minipage + (rowIndex - 1) * sizeof(int), sizeof(int));
+        memcpy(&end, minipage + rowIndex * sizeof(int), sizeof(int));
+        fieldPtr = minipage + rowCount * sizeof(int) + begin;
+        fieldLength = end - begin;
+    }
+
+    // Rebuild a PAX row in the stored row format, with one field per attribute of the descriptor
+    static int materializePaxRow(const char *pageData, unsigned pageSize, const std::vector<Attribute> &recordDescriptor, int rowIndex,
+                                 char *recordBuffer)
+    {
+        int numFields = recordDescriptor.size();
+        int nullIndicatorSize = ceil((double)numFields / CHAR_BIT);
+        char *nullIndicator = recordBuffer + sizeof(int);
+        char *directory = nullIndicator + nullIndicatorSize;
+        int dataOffset = sizeof(int) + nullIndicatorSize + numFields * sizeof(int);
+
+        memcpy(recordBuffer, &numFields, sizeof(int));
+        memset(nullIndicator, 0, nullIndicatorSize);
+        for (int fieldIndex = 0; fieldIndex < numFields; fieldIndex++)
+        {
+            const char *fieldPtr;
+            int fieldLength;
+            bool isNull;
+            getPaxField(pageData, pageSize, recordDescriptor[fieldIndex].type, rowIndex, fieldIndex, fieldPtr, fieldLength,
+                        isNull);
+            if (isNull)
+            {
+                nullIndicator[fieldIndex / 8] |= (1 << (7 - fieldIndex % 8));
+            }
+            else
+            {
+                memcpy(recordBuffer + dataOffset, fieldPtr, fieldLength);
+                dataOffset += fieldLength;
+            }
+            memcpy(directory + fieldIndex * sizeof(int), &dataOffset, sizeof(int));
+        }
+        return dataOffset;
+    }
+
+    // Write the given fields of a PAX row in the API format and return the size written
+    static unsigned projectPaxRow(const char *pageData, unsigned pageSize, const std::vector<Attribute> &recordDescriptor,
+                                  const std::vector<int> &attributeIndexes, int rowIndex, char *data)
+    {
+        int nullIndicatorSize = ceil((double)attributeIndexes.size() / CHAR_BIT);
+        memset(data, 0, nullIndicatorSize);
+        unsigned dataOffset = nullIndicatorSize;
+
+        for (size_t i = 0; i < attributeIndexes.size(); i++)
+        {
+            int fieldIndex = attributeIndexes[i];
+            const char *fieldPtr;
+            int fieldLength;
+            bool isNull;
+            getPaxField(pageData, pageSize, recordDescriptor[fieldIndex].type, rowIndex, fieldIndex, fieldPtr, fieldLength,
+                        isNull);
+            if (isNull)
+            {
+                data[i / 8] |= (1 << (7 - i % 8));
+                continue;
+            }
+
+            if (recordDescriptor[fieldIndex].type == TypeVarChar)
+            {
+                memcpy(data + dataOffset, &fieldLength, sizeof(int));
+                dataOffset += sizeof(int);
+            }
+            memcpy(data + dataOffset, fieldPtr, fieldLength);
+            dataOffset += fieldLength;
+        }
+        return dataOffset;
+    }
+
+    // Bytes a stored row takes on a PAX page, minipage entries and row state included
+    static int getPaxRowSize(const std::vector<Attribute> &recordDescriptor, const char *recordPtr)
+    {
+        int numFields = recordDescriptor.size();
+        int rowSize = 1 + (int)ceil((double)numFields / CHAR_BIT) + numFields * sizeof(int);
+        int storedFields;
+        memcpy(&storedFields, recordPtr, sizeof(int));
+        for (int fieldIndex = 0; fieldIndex < std::min(numFields, storedFields); fieldIndex++)
+        {
+            int fieldStart, fieldLength;
+            bool isNull;
+            getStoredField(recordPtr, fieldIndex, fieldStart, fieldLength, isNull);
+            if (!isNull && recordDescriptor[fieldIndex].type == TypeVarChar)
+                rowSize += fieldLength;
+        }
+        return rowSize;
+    }
+
+    // Free bytes of a PAX page once it is rebuilt without the characters of its deleted rows
+    static unsigned getPaxReclaimableBytes(const char *pageData, unsigned pageSize, const std::vector<Attribute> &recordDescriptor)
+    {
+        int rowCount = getPaxRowCount(pageData, pageSize);
+        int numColumns = getPaxColumnCount(pageData, pageSize);
+        int usedSpace = rowCount * (1 + (int)ceil((double)numColumns / CHAR_BIT) + numColumns * (int)sizeof(int));
+        for (int columnIndex = 0; columnIndex < numColumns && columnIndex < (int)recordDescriptor.size(); columnIndex++)
+        {
+            if (recordDescriptor[columnIndex].type != TypeVarChar)
+            {
+                continue;
+            }
+            for (int rowIndex = 0; rowIndex < rowCount; rowIndex++)
+            {
+                const char *fieldPtr;
+                int fieldLength;
+                bool isNull;
+                getPaxField(pageData, pageSize, TypeVarChar, rowIndex, columnIndex, fieldPtr, fieldLength, isNull);
+                if (isPaxRowLive(pageData, rowIndex) && !isNull)
+                    usedSpace += fieldLength;
+            }
+        }
+        return pageSize - getPaxTrailerSize(numColumns) - usedSpace;
+    }
+
+    // Build a PAX page from stored row images; nullptr stands for a deleted row and deleted rows at
+    // the end are dropped. Returns false, leaving the page untouched, when the rows do not fit.
+    static bool buildPaxPage(const std::vector<Attribute> &recordDescriptor, std::vector<const char *> rows,
+                             char *pageData, unsigned pageSize)
+    {
+        while (!rows.empty() && rows.back() == nullptr)
+            rows.pop_back();
+
+        int numColumns = recordDescriptor.size();
+        int rowCount = rows.size();
+        int nullIndicatorSize = ceil((double)numColumns / CHAR_BIT);
+        int usedSpace = rowCount * (1 + nullIndicatorSize + numColumns * (int)sizeof(int));
+        for (const char *row : rows)
+        {
+            if (row != nullptr)
+                usedSpace += getPaxRowSize(recordDescriptor, row) - (1 + nullIndicatorSize + numColumns * sizeof(int));
+        }
+        if (usedSpace + getPaxTrailerSize(numColumns) > (int)pageSize)
+        {
+            return false;
+        }
+
+        ScratchBuffer imageBuffer(pageSize, true);
+        char *image = imageBuffer.data();
+        char *nullIndicators = image + rowCount;
+        int columnStart = rowCount * (1 + nullIndicatorSize);
+        int trailerStart = pageSize - getPaxTrailerSize(numColumns);
+        for (int columnIndex = 0; columnIndex < numColumns; columnIndex++)
+        {
+            memcpy(image + trailerStart + columnIndex * sizeof(int), &columnStart, sizeof(int));
+            bool isVarChar = recordDescriptor[columnIndex].type == TypeVarChar;
+            char *minipage = image + columnStart;
+            char *characters = minipage + rowCount * sizeof(int);
+            int characterEnd = 0;
+
+            for (int rowIndex = 0; rowIndex < rowCount; rowIndex++)
+            {
+                const char *row = rows[rowIndex];
+                int storedFields = 0;
+                if (row != nullptr)
+                    memcpy(&storedFields, row, sizeof(int));
+
+                int fieldStart = 0, fieldLength = 0;
+                bool isNull = true;
+                if (columnIndex < storedFields)
+                    getStoredField(row, columnIndex, fieldStart, fieldLength, isNull);
+                if (isNull)
+                    nullIndicators[rowIndex * nullIndicatorSize + columnIndex / 8] |= (1 << (7 - columnIndex % 8));
+
+                if (isVarChar)
+                {
+                    if (!isNull)
+                    {
+                        memcpy(characters + characterEnd, row + fieldStart, fieldLength);
+                        characterEnd += fieldLength;
+                    }
+                    memcpy(minipage + rowIndex * sizeof(int), &characterEnd, sizeof(int));
+                }
+                else if (!isNull)
+                {
+                    memcpy(minipage + rowIndex * sizeof(int), row + fieldStart, sizeof(int));
+                }
+            }
+            columnStart += rowCount * sizeof(int) + characterEnd;
+        }
+
+        for (int rowIndex = 0; rowIndex < rowCount; rowIndex++)
+            image[rowIndex] = rows[rowIndex] != nullptr;
+        memcpy(image + pageSize - sizeof(int) * 3, &usedSpace, sizeof(int));
+        memcpy(image + pageSize - sizeof(int) * 2, &rowCount, sizeof(int));
+        memcpy(image + pageSize - sizeof(int), &numColumns, sizeof(int));
+        memcpy(pageData, image, pageSize);
+        return true;
+    }
+
+    // Rebuild every row of a PAX page in the stored row format; rows[i] is nullptr for a deleted row.
+    // The images live in "images", which must outlive rows.
+    static void collectPaxRows(const char *pageData, unsigned pageSize, const std::vector<Attribute> &recordDescriptor,
+                               std::vector<char> &images, std::vector<const char *> &rows)
+    {
+        int rowCount = getPaxRowCount(pageData, pageSize);
+        int maxRecordSize = sizeof(int) + ceil((double)recordDescriptor.size() / CHAR_BIT) +
+                            recordDescriptor.size() * sizeof(int) + pageSize;
+        std::vector<int> offsets(rowCount, -1);
+        int imagesSize = 0;
+        for (int rowIndex = 0; rowIndex < rowCount; rowIndex++)
+        {
+            if (!isPaxRowLive(pageData, rowIndex))
+            {
+                continue;
+            }
+            if ((int)images.size() < imagesSize + maxRecordSize)
+                images.resize(imagesSize + maxRecordSize);
+            offsets[rowIndex] = imagesSize;
+            imagesSize += materializePaxRow(pageData, pageSize, recordDescriptor, rowIndex, images.data() + imagesSize);
+        }
+
+        rows.assign(rowCount, nullptr);
+        for (int rowIndex = 0; rowIndex < rowCount; rowIndex++)
+        {
+            if (offsets[rowIndex] >= 0)
+                rows[rowIndex] = images.data() + offsets[rowIndex];
+        }
+    }
+
+    // Pin the page of a live PAX row; rowIndex is the row counted from 0
+    static RC pinPaxRow(FileHandle &fileHandle, const RID &rid, char *&pageData, int &rowIndex)
+    {
+        unsigned pageSize = fileHandle.getPageSize();
+        if (fileHandle.pinPage(rid.pageNum, pageData) != 0)
+        {
+            return -1;
+        }
+        rowIndex = rid.slotNum - 1;
+        if (rid.slotNum < 1 || rowIndex >= getPaxRowCount(pageData, pageSize) || !isPaxRowLive(pageData, rowIndex))
+        {
+            fileHandle.unpinPage(rid.pageNum, false);
+            return -1;
+        }
+        return 0;
+    }
+
+    // Put a stored row image into a PAX page with room for it, reusing a deleted row, or on a new page
+    static RC storePaxRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                             const char *image, RID &recordId)
+    {
+        unsigned pageSize = fileHandle.getPageSize();
+        int rowSize = getPaxRowSize(recordDescriptor, image);
+        if (rowSize + getPaxTrailerSize(recordDescriptor.size()) > (int)pageSize)
+        {
+            perror("Error: Record does not fit in a page!");
+            return -1;
+        }
+
+        PageNum targetPage;
+        char *pageData;
+        if (fileHandle.findPageWithFreeSpace(rowSize, targetPage) == 0 &&
+            fileHandle.pinPage(targetPage, pageData) == 0)
+        {
+            std::vector<char> images;
+            std::vector<const char *> rows;
+            collectPaxRows(pageData, pageSize, recordDescriptor, images, rows);
+            size_t rowIndex = std::find(rows.begin(), rows.end(), (const char *)nullptr) - rows.begin();
+            if (rowIndex == rows.size())
+                rows.push_back(image);
+            else
+                rows[rowIndex] = image;
+
+            // A page built before attributes were added grows when it is rebuilt and may not fit any more
+            if (buildPaxPage(recordDescriptor, rows, pageData, pageSize))
+            {
+                unsigned freeBytes = getPaxFreeBytes(pageData, pageSize);
+                fileHandle.unpinPage(targetPage, true);
+                fileHandle.setFreeSpace(targetPage, freeBytes);
+                recordId.pageNum = targetPage;
+                recordId.slotNum = rowIndex + 1;
+                return 0;
+            }
+            fileHandle.unpinPage(targetPage, false);
+        }
+
+        ScratchBuffer pageBuffer(pageSize, true);
+        char *newPage = pageBuffer.data();
+        buildPaxPage(recordDescriptor, std::vector<const char *>(1, image), newPage, pageSize);
+        targetPage = fileHandle.getNumberOfPages();
+        RC rc = fileHandle.appendPage(newPage);
+        if (rc == 0)
+            rc = fileHandle.setFreeSpace(targetPage, getPaxFreeBytes(newPage, pageSize));
+        if (rc != 0)
+        {
+            return -1;
+        }
+        recordId.pageNum = targetPage;
+        recordId.slotNum = 1;
+        return 0;
+    }
+
     RecordBasedFileManager &RecordBasedFileManager::instance()
     {
-        static RecordBasedFileManager _rbf_manager = RecordBasedFileManager();
-        return _rbf_manager;
+        static RecordBasedFileManager _rbf_manager = RecordBasedFileManager();
+        return _rbf_manager;
+    }
+
+    RecordBasedFileManager::RecordBasedFileManager() : nextCodec(0)
+    {
+    }
+
+    RecordBasedFileManager::~RecordBasedFileManager() = default;
+
+    RecordBasedFileManager::RecordBasedFileManager(const RecordBasedFileManager &) = default;
+
+    RecordBasedFileManager &RecordBasedFileManager::operator=(const RecordBasedFileManager &) = default;
+
+    // The zone map of a closed file is kept next to it
+    static std::string getZoneMapFileName(const std::string &fileName)
+    {
+        return fileName + ".zonemap";
+    }
+
+    RC RecordBasedFileManager::createFile(const std::string &fileName, PageLayout layout, unsigned pageSize)
+    {
+        if (_pf_manager.createFile(fileName, pageSize) != 0)
+        {
+            return -1;
+        }
+        if (layout == LAYOUT_NSM)
+        {
+            return 0;
+        }
+
+        // The layout is recorded in the hidden page, where a new file has 0 (LAYOUT_NSM)
+        FileHandle fileHandle;
+        if (_pf_manager.openFile(fileName, fileHandle) != 0)
+        {
+            return -1;
+        }
+        fileHandle.formatTag = layout;
+        return _pf_manager.closeFile(fileHandle);
+    }
+
+    RC RecordBasedFileManager::destroyFile(const std::string &fileName)
+    {
+        remove(getZoneMapFileName(fileName).c_str());
+        return _pf_manager.destroyFile(fileName);
+    }
+
+    RC RecordBasedFileManager::openFile(const std::string &fileName, FileHandle &fileHandle, IOMode ioMode)
+    {
+        if (_pf_manager.openFile(fileName, fileHandle, ioMode) != 0)
+        {
+            return -1;
+        }
+
+        // Every handle of a file shares one zone map, loaded by the first of them
+        ZoneMap &zoneMap = zoneMaps[fileHandle.fileId];
+        if (zoneMap.openCount++ == 0)
+        {
+            zoneMap.load(fileName, fileHandle.getNumberOfPages(), fileHandle.writeGeneration);
+        }
+        return 0;
+    }
+
+    RC RecordBasedFileManager::closeFile(FileHandle &fileHandle)
+    {
+        auto found = zoneMaps.find(fileHandle.fileId);
+        if (found != zoneMaps.end() && --found->second.openCount == 0)
+        {
+            if (found->second.isValid())
+            {
+                found->second.save(fileHandle.getFileName(), fileHandle.getNumberOfPages(),
+                                   fileHandle.writeGeneration);
+            }
+            zoneMaps.erase(found);
+        }
+        return _pf_manager.closeFile(fileHandle);
+    }
+
+    // Zone map of a file opened through openFile(), nullptr for a file opened some other way
+    ZoneMap *RecordBasedFileManager::getZoneMap(FileHandle &fileHandle)
+    {
+        auto found = zoneMaps.find(fileHandle.fileId);
+        return found == zoneMaps.end() ? nullptr : &found->second;
+    }
+
+    // Largest stored size of a record of this descriptor
+    static int getMaxRecordSize(const std::vector<Attribute> &recordDescriptor)
+    {
+        int numFields = recordDescriptor.size();
+        int nullIndicatorSize = ceil((double)numFields / CHAR_BIT);
+
+        // Record header: field count, null indicator and one field-end offset per field
+        int maxRecordSize = sizeof(int) + nullIndicatorSize + numFields * sizeof(int);
+        for (int i = 0; i < numFields; i++)
+        {
+            maxRecordSize += recordDescriptor[i].length;
+            if (recordDescriptor[i].type == TypeVarChar)
+            {
+                maxRecordSize += sizeof(int); // Additional space for string length
+            }
+        }
+        return maxRecordSize;
+    }
+
+    RecordCodec::RecordCodec() : nullIndicatorSize(0), headerSize(sizeof(int)), maxRecordSize(sizeof(int)),
+                                 fixedOnly(true), fixedDataSize(0)
+    {
+    }
+
+    // Stored format: [field count][null indicator][field-end offset per field][field values]
+    RecordCodec::RecordCodec(const std::vector<Attribute> &recordDescriptor)
+    {
+        unsigned numFields = recordDescriptor.size();
+        nullIndicatorSize = ceil((double)numFields / CHAR_BIT);
+        headerSize = sizeof(int) + nullIndicatorSize + numFields * sizeof(int);
+        maxRecordSize = PeterDB::getMaxRecordSize(recordDescriptor);
+        fixedOnly = true;
+        fixedDataSize = 0;
+
+        int fieldEnd = headerSize;
+        for (unsigned i = 0; i < numFields; i++)
+        {
+            FieldLayout field;
+            field.type = recordDescriptor[i].type;
+            field.length = recordDescriptor[i].length;
+            field.nullByte = i / 8;
+            field.nullMask = 1 << (7 - i % 8);
+            fields.push_back(field);
+
+            if (field.type == TypeVarChar)
+            {
+                fixedOnly = false;
+                continue;
+            }
+            fieldEnd += sizeof(int); // Int and Real values both take 4 bytes
+            fixedEnds.push_back(fieldEnd);
+        }
+        if (fixedOnly)
+            fixedDataSize = fieldEnd - headerSize;
+        else
+            fixedEnds.clear();
+    }
+
+    bool RecordCodec::matches(const std::vector<Attribute> &recordDescriptor) const
+    {
+        if (recordDescriptor.size() != fields.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < fields.size(); i++)
+        {
+            if (recordDescriptor[i].type != fields[i].type || recordDescriptor[i].length != fields[i].length)
+                return false;
+        }
+        return true;
+    }
+
+    bool RecordCodec::hasNulls(const char *nullIndicator) const
+    {
+        for (unsigned i = 0; i < nullIndicatorSize; i++)
+        {
+            if (nullIndicator[i] != 0)
+                return true;
+        }
+        return false;
+    }
+
+    unsigned RecordCodec::encode(const void *data, char *image) const
+    {
+        const char *input = (const char *)data;
+        int numFields = fields.size();
+        memcpy(image, &numFields, sizeof(int));
+        memcpy(image + sizeof(int), input, nullIndicatorSize);
+        char *directory = image + sizeof(int) + nullIndicatorSize;
+
+        // A fixed-size record without nulls: the directory is known and the values are copied as a block
+        if (fixedOnly && !hasNulls(input))
+        {
+            memcpy(directory, fixedEnds.data(), fixedEnds.size() * sizeof(int));
+            memcpy(image + headerSize, input + nullIndicatorSize, fixedDataSize);
+            return headerSize + fixedDataSize;
+        }
+
+        unsigned inputOffset = nullIndicatorSize;
+        int fieldEnd = headerSize;
+        for (size_t i = 0; i < fields.size(); i++)
+        {
+            const FieldLayout &field = fields[i];
+            if (!(input[field.nullByte] & field.nullMask))
+            {
+                int valueLength = sizeof(int);
+                if (field.type == TypeVarChar)
+                {
+                    memcpy(&valueLength, input + inputOffset, sizeof(int));
+                    inputOffset += sizeof(int);
+                }
+                memcpy(image + fieldEnd, input + inputOffset, valueLength);
+                inputOffset += valueLength;
+                fieldEnd += valueLength;
+            }
+            // A null field ends where the previous one did
+            memcpy(directory + i * sizeof(int), &fieldEnd, sizeof(int));
+        }
+        return fieldEnd;
+    }
+
+    int RecordCodec::decode(const char *image, void *data, FileHandle *fileHandle) const
+    {
+        char *output = (char *)data;
+        const char *nullIndicator = image + sizeof(int);
+        memcpy(output, nullIndicator, nullIndicatorSize);
+
+        // Without nulls the values of a fixed-size record are stored exactly as the API lays them out
+        if (fixedOnly && !hasNulls(nullIndicator))
+        {
+            memcpy(output + nullIndicatorSize, image + headerSize, fixedDataSize);
+            return nullIndicatorSize + fixedDataSize;
+        }
+
+        const char *directory = nullIndicator + nullIndicatorSize;
+        unsigned outputOffset = nullIndicatorSize;
+        int fieldStart = headerSize;
+        for (size_t i = 0; i < fields.size(); i++)
+        {
+            const FieldLayout &field = fields[i];
+            int fieldEnd;
+            memcpy(&fieldEnd, directory + i * sizeof(int), sizeof(int));
+            bool overflow = fieldEnd & OVERFLOW_FIELD_FLAG;
+            fieldEnd &= ~OVERFLOW_FIELD_FLAG;
+            if (!(nullIndicator[field.nullByte] & field.nullMask))
+            {
+                int valueLength = overflow ? getOverflowLength(image + fieldStart) : fieldEnd - fieldStart;
+                if (field.type == TypeVarChar)
+                {
+                    memcpy(output + outputOffset, &valueLength, sizeof(int));
+                    outputOffset += sizeof(int);
+                }
+                if (!overflow)
+                    memcpy(output + outputOffset, image + fieldStart, valueLength);
+                else if (fileHandle == nullptr || readOverflowValue(*fileHandle, image + fieldStart,
+                                                                    output + outputOffset) != 0)
+                    return -1;
+                outputOffset += valueLength;
+            }
+            fieldStart = fieldEnd;
+        }
+        return outputOffset;
+    }
+
+    void RecordCodec::print(const std::vector<Attribute> &recordDescriptor, const void *data, std::ostream &out) const
+    {
+        const char *input = (const char *)data;
+        unsigned inputOffset = nullIndicatorSize;
+        for (size_t i = 0; i < fields.size(); i++)
+        {
+            const FieldLayout &field = fields[i];
+            out << (i == 0 ? "" : ", ") << recordDescriptor[i].name << ": ";
+            if (input[field.nullByte] & field.nullMask)
+            {
+                out << "NULL";
+                continue;
+            }
+
+            switch (field.type)
+            {
+            case TypeInt:
+            {
+                int intValue;
+                memcpy(&intValue, input + inputOffset, sizeof(int));
+                out << intValue;
+                inputOffset += sizeof(int);
+                break;
+            }
+            case TypeReal:
+            {
+                float floatValue;
+                memcpy(&floatValue, input + inputOffset, sizeof(float));
+                out << floatValue;
+                inputOffset += sizeof(float);
+                break;
+            }
+            case TypeVarChar:
+            {
+                int strLength;
+                memcpy(&strLength, input + inputOffset, sizeof(int));
+                out.write(input + inputOffset + sizeof(int), strLength);
+                inputOffset += sizeof(int) + strLength;
+                break;
+            }
+            }
+        }
+        out << std::endl;
+    }
+
+    // Codec of a descriptor, built on first use. Callers pass the same few descriptors over and over,
+    // so a handful of entries is enough; the most recently built one is checked first.
+    static const size_t CODEC_CACHE_SIZE = 8;
+
+    // A caller holds on to the codec it gets, so a replaced entry lives on until the caller is done with it.
+    std::shared_ptr<const RecordCodec> RecordBasedFileManager::getCodec(const std::vector<Attribute> &recordDescriptor)
+    {
+        size_t newest = (nextCodec + codecs.size() - 1) % std::max(codecs.size(), (size_t)1);
+        for (size_t i = 0; i < codecs.size(); i++)
+        {
+            const std::shared_ptr<const RecordCodec> &codec = codecs[(newest + codecs.size() - i) % codecs.size()];
+            if (codec->matches(recordDescriptor))
+                return codec;
+        }
+
+        std::shared_ptr<const RecordCodec> codec = std::make_shared<RecordCodec>(recordDescriptor);
+        if (codecs.size() < CODEC_CACHE_SIZE)
+        {
+            codecs.push_back(codec);
+            nextCodec = codecs.size() % CODEC_CACHE_SIZE;
+            return codec;
+        }
+        codecs[nextCodec] = codec;
+        nextCodec = (nextCodec + 1) % CODEC_CACHE_SIZE;
+        return codec;
+    }
+
+    // Put a stored image on a page with room for it and a new slot, or on a new page
+    static RC storeRecord(FileHandle &fileHandle, const void *image, int imageSize, RID &recordId)
+    {
+        unsigned pageSize = fileHandle.getPageSize();
+        // Find a page with room for the record and one more slot through the free-space map,
+        // instead of walking the file page by page
+        int slotCount;
+        PageNum targetPage;
+        char *pageData;
+        bool found = fileHandle.findPageWithFreeSpace(imageSize + SLOT_ENTRY_SIZE, targetPage) == 0 &&
+                     fileHandle.pinPage(targetPage, pageData) == 0;
+
+        // The map rounds free space down, so the page should have room once it is compacted. If the
+        // entry is stale anyway, it is corrected from the page and the record goes to a new page.
+        // A slot emptied by a delete is reused before the directory grows.
+        int slotNum = found ? findEmptySlot(pageData, pageSize) : 0;
+        if (found && !makeRoom(pageData, pageSize, imageSize + (slotNum == 0 ? SLOT_ENTRY_SIZE : 0)))
+        {
+            unsigned freeBytes = getReclaimableBytes(pageData, pageSize);
+            fileHandle.unpinPage(targetPage, false);
+            fileHandle.setFreeSpace(targetPage, freeBytes);
+            found = false;
+        }
+
+        if (found)
+        {
+            slotCount = getSlotCount(pageData, pageSize);
+            if (slotNum == 0)
+            {
+                slotNum = ++slotCount;
+                setPageHeader(pageData, pageSize, slotCount, getUsedSpace(pageData, pageSize));
+            }
+            appendToSlot(pageData, pageSize, slotNum, image, imageSize);
+            slotCount = slotNum;
+
+            unsigned freeBytes = getReclaimableBytes(pageData, pageSize);
+            fileHandle.unpinPage(targetPage, true);
+            fileHandle.setFreeSpace(targetPage, freeBytes);
+        }
+        else
+        {
+            // No page has enough room; start a new page with this record in it
+            ScratchBuffer pageBuffer(pageSize, true);
+            char *newPage = pageBuffer.data();
+            slotCount = 1;
+            memcpy(newPage, image, imageSize);
+            setSlot(newPage, pageSize, slotCount, 0, imageSize);
+            setPageHeader(newPage, pageSize, slotCount, imageSize);
+
+            targetPage = fileHandle.getNumberOfPages();
+            RC rc = fileHandle.appendPage(newPage);
+            if (rc == 0)
+                rc = fileHandle.setFreeSpace(targetPage, getFreeBytes(newPage, pageSize));
+            if (rc != 0)
+            {
+                return -1;
+            }
+        }
+
+        // Set the record ID
+        recordId.slotNum = slotCount;
+        recordId.pageNum = targetPage;
+        return 0;
+    }
+
+    RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                            const void *inputData, RID &recordId)
+    {
+        // Convert the record to the stored format in a scratch buffer
+        std::shared_ptr<const RecordCodec> codec = getCodec(recordDescriptor);
+        ScratchBuffer imageBuffer(codec->getMaxRecordSize());
+        char *recordBuffer = imageBuffer.data();
+        int recordSize = codec->encode(inputData, recordBuffer);
+        if (recordSize > getMaxInlineRecordSize(fileHandle.getPageSize()) && !isPaxFile(fileHandle))
+        {
+            recordSize = spillRecord(fileHandle, recordDescriptor, recordBuffer, recordSize);
+            if (recordSize < 0)
+            {
+                return -1;
+            }
+        }
+
+        RC rc = isPaxFile(fileHandle)
+                    ? storePaxRecord(fileHandle, recordDescriptor, recordBuffer, recordId)
+                    : storeRecord(fileHandle, recordBuffer, recordSize, recordId);
+        ZoneMap *zoneMap = getZoneMap(fileHandle);
+        if (rc == 0 && zoneMap != nullptr)
+        {
+            zoneMap->note(recordId.pageNum, recordDescriptor, recordBuffer);
+        }
+        return rc;
+    }
+
+    // Append a page image built in memory to the file and start over with an empty image
+    static RC flushPageImage(FileHandle &fileHandle, char *pageImage)
+    {
+        unsigned pageSize = fileHandle.getPageSize();
+        if (getSlotCount(pageImage, pageSize) == 0)
+        {
+            return 0;
+        }
+
+        PageNum pageNum = fileHandle.getNumberOfPages();
+        if (fileHandle.appendPage(pageImage) != 0 ||
+            fileHandle.setFreeSpace(pageNum, getFreeBytes(pageImage, pageSize)) != 0)
+        {
+            return -1;
+        }
+        memset(pageImage, 0, pageSize);
+        return 0;
+    }
+
+    // Add a stored image to a page image built in memory; the previous image is appended to the
+    // file first if the record does not fit. recordId is where the record will end up.
+    static RC packRecord(FileHandle &fileHandle, char *pageImage, const void *image, int imageSize, RID &recordId)
+    {
+        unsigned pageSize = fileHandle.getPageSize();
+        if (imageSize < 0 || (unsigned)imageSize + SLOT_ENTRY_SIZE > pageSize - PAGE_HEADER_SIZE)
+        {
+            perror("Error: Record does not fit in a page!");
+            return -1;
+        }
+
+        // Ship the current image once the next record does not fit
+        if ((int)getFreeBytes(pageImage, pageSize) < imageSize + SLOT_ENTRY_SIZE && flushPageImage(fileHandle, pageImage) != 0)
+        {
+            return -1;
+        }
+
+        int slotCount = getSlotCount(pageImage, pageSize) + 1;
+        int usedSpace = getUsedSpace(pageImage, pageSize);
+        memcpy(pageImage + usedSpace, image, imageSize);
+        setSlot(pageImage, pageSize, slotCount, usedSpace, imageSize);
+        setPageHeader(pageImage, pageSize, slotCount, usedSpace + imageSize);
+
+        recordId.pageNum = fileHandle.getNumberOfPages();
+        recordId.slotNum = slotCount;
+        return 0;
+    }
+
+    // Bulk load: records are packed into page images in memory and every full image is appended
+    // as a whole, so each new page is written exactly once. Existing pages are left untouched.
+    RC RecordBasedFileManager::insertRecords(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                             const std::vector<const void *> &records, std::vector<RID> &recordIds)
+    {
+        unsigned pageSize = fileHandle.getPageSize();
+        recordIds.clear();
+        recordIds.reserve(records.size());
+
+        // A PAX page is rebuilt for every row anyway, so PAX rows are inserted one by one
+        if (isPaxFile(fileHandle))
+        {
+            for (const void *record : records)
+            {
+                RID recordId;
+                if (insertRecord(fileHandle, recordDescriptor, record, recordId) != 0)
+                {
+                    return -1;
+                }
+                recordIds.push_back(recordId);
+            }
+            return 0;
+        }
+
+        std::shared_ptr<const RecordCodec> codec = getCodec(recordDescriptor);
+        ScratchBuffer imageBuffer(codec->getMaxRecordSize());
+        ScratchBuffer pageBuffer(pageSize, true);
+        char *recordBuffer = imageBuffer.data();
+        char *pageImage = pageBuffer.data();
+        ZoneMap *zoneMap = getZoneMap(fileHandle);
+        RC status = 0;
+
+        for (const void *record : records)
+        {
+            int recordSize = codec->encode(record, recordBuffer);
+            if (recordSize > getMaxInlineRecordSize(pageSize))
+            {
+                // The overflow pages are appended behind the image built so far, so ship it first
+                if (flushPageImage(fileHandle, pageImage) != 0 ||
+                    (recordSize = spillRecord(fileHandle, recordDescriptor, recordBuffer, recordSize)) < 0)
+                {
+                    status = -1;
+                    break;
+                }
+            }
+            RID recordId;
+            status = packRecord(fileHandle, pageImage, recordBuffer, recordSize, recordId);
+            if (status != 0)
+            {
+                break;
+            }
+            if (zoneMap != nullptr)
+                zoneMap->note(recordId.pageNum, recordDescriptor, recordBuffer);
+            recordIds.push_back(recordId);
+        }
+
+        // The last, partly filled image
+        if (status == 0)
+        {
+            status = flushPageImage(fileHandle, pageImage);
+        }
+        return status;
+    }
+
+    // Read the given fields of a PAX row straight from their minipages, in the API format
+    static RC readPaxAttributes(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor, const RID &rid,
+                                const std::vector<int> &attributeIndexes, void *data)
+    {
+        unsigned pageSize = fileHandle.getPageSize();
+        char *pageData;
+        int rowIndex;
+        if (pinPaxRow(fileHandle, rid, pageData, rowIndex) != 0)
+        {
+            return -1;
+        }
+        projectPaxRow(pageData, pageSize, recordDescriptor, attributeIndexes, rowIndex, (char *)data);
+        return fileHandle.unpinPage(rid.pageNum, false);
+    }
+
+    RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                          const RID &recordID, void *outputData)
+    {
+        if (isPaxFile(fileHandle))
+        {
+            std::vector<int> attributeIndexes;
+            for (size_t i = 0; i < recordDescriptor.size(); i++)
+                attributeIndexes.push_back(i);
+            return readPaxAttributes(fileHandle, recordDescriptor, recordID, attributeIndexes, outputData);
+        }
+
+        // Pin the page containing the record in the buffer pool, following a forward if there is one
+        PageNum pinnedPage;
+        char *pageData;
+        int recordStartOffset, recordLength;
+        if (pinRecord(fileHandle, recordID, pinnedPage, pageData, recordStartOffset, recordLength) != 0)
+        {
+            return -1;
+        }
+
+        // Convert the stored record back into the API format
+        std::shared_ptr<const RecordCodec> codec = getCodec(recordDescriptor);
+        bool decoded = codec->decode(pageData + recordStartOffset, outputData, &fileHandle) >= 0;
+
+        // Release the page; it was only read
+        RC rc = fileHandle.unpinPage(pinnedPage, false);
+        return decoded ? rc : -1;
+    }
+
+    RC RecordBasedFileManager::readRecordView(FileHandle &fileHandle, const RID &rid, RecordView &view)
+    {
+        view.release();
+        if (isPaxFile(fileHandle))
+        {
+            perror("Error: Record views are not available for PAX files!");
+            return -1;
+        }
+
+        PageNum pinnedPage;
+        char *pageData;
+        int recordOffset, recordLength;
+        if (pinRecord(fileHandle, rid, pinnedPage, pageData, recordOffset, recordLength) != 0)
+        {
+            return -1;
+        }
+
+        view.attach(pageData + recordOffset);
+        view.fileHandle = &fileHandle;
+        view.pageNum = pinnedPage;
+        return 0;
     }
 
-    RecordBasedFileManager::RecordBasedFileManager() = default;
+    RecordView::RecordView()
+        : record(nullptr), numFields(0), nullIndicator(nullptr), directory(nullptr), fileHandle(nullptr), pageNum(0)
+    {
+    }
 
-    RecordBasedFileManager::~RecordBasedFileManager() = default;
+    RecordView::~RecordView()
+    {
+        release();
+    }
 
-    RecordBasedFileManager::RecordBasedFileManager(const RecordBasedFileManager &) = default;
+    void RecordView::attach(const char *recordPtr)
+    {
+        int storedFields;
+        memcpy(&storedFields, recordPtr, sizeof(int));
+        record = recordPtr;
+        numFields = storedFields;
+        nullIndicator = recordPtr + sizeof(int);
+        directory = nullIndicator + (int)ceil((double)storedFields / CHAR_BIT);
+    }
 
-    RecordBasedFileManager &RecordBasedFileManager::operator=(const RecordBasedFileManager &) = default;
+    RC RecordView::release()
+    {
+        RC rc = 0;
+        if (fileHandle != nullptr)
+        {
+            rc = fileHandle->unpinPage(pageNum, false);
+            fileHandle = nullptr;
+        }
+        record = nullptr;
+        return rc;
+    }
+
+    RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                            const RID &rid)
+    {
+        unsigned pageSize = fileHandle.getPageSize();
+        char *pageData;
+        if (isPaxFile(fileHandle))
+        {
+            // The row keeps its number; its characters go away when the page is next rebuilt
+            int rowIndex;
+            if (pinPaxRow(fileHandle, rid, pageData, rowIndex) != 0)
+            {
+                return -1;
+            }
+            pageData[rowIndex] = 0;
+            unsigned freeBytes = getPaxReclaimableBytes(pageData, pageSize, recordDescriptor);
+            RC rc = fileHandle.unpinPage(rid.pageNum, true);
+            if (rc == 0)
+                rc = fileHandle.setFreeSpace(rid.pageNum, freeBytes);
+            return rc;
+        }
+
+        if (fileHandle.pinPage(rid.pageNum, pageData) != 0)
+        {
+            return -1;
+        }
+
+        int recordOffset, recordLength;
+        if (rid.slotNum < 1 || rid.slotNum > getSlotCount(pageData, pageSize))
+        {
+            fileHandle.unpinPage(rid.pageNum, false);
+            return -1;
+        }
+        getSlot(pageData, pageSize, rid.slotNum, recordOffset, recordLength);
+        if (recordOffset == EMPTY_SLOT || (!isTombstone(recordOffset, recordLength) &&
+                                           isForwardedRecord(pageData, recordOffset)))
+        {
+            fileHandle.unpinPage(rid.pageNum, false);
+            return -1;
+        }
+
+        // A moved record is deleted on the page it moved to as well
+        if (isTombstone(recordOffset, recordLength))
+        {
+            PageNum targetPage = recordOffset;
+            char *targetData;
+            if (fileHandle.pinPage(targetPage, targetData) != 0)
+            {
+                fileHandle.unpinPage(rid.pageNum, false);
+                return -1;
+            }
+            int targetOffset, targetLength;
+            getSlot(targetData, pageSize, -recordLength, targetOffset, targetLength);
+            freeOverflowFields(fileHandle, targetData + targetOffset + FORWARD_HEADER_SIZE);
+            releaseSlot(targetData, pageSize, -recordLength);
+            unsigned targetFree = getReclaimableBytes(targetData, pageSize);
+            fileHandle.unpinPage(targetPage, true);
+            fileHandle.setFreeSpace(targetPage, targetFree);
+        }
+
+        else
+        {
+            freeOverflowFields(fileHandle, pageData + recordOffset);
+        }
+
+        // The freed bytes are reclaimed lazily, by the next insert or update that needs them
+        releaseSlot(pageData, pageSize, rid.slotNum);
+        unsigned freeBytes = getReclaimableBytes(pageData, pageSize);
+        RC rc = fileHandle.unpinPage(rid.pageNum, true);
+        if (rc == 0)
+            rc = fileHandle.setFreeSpace(rid.pageNum, freeBytes);
+        return rc;
+    }
 
-    RC RecordBasedFileManager::createFile(const std::string &fileName)
+    RC RecordBasedFileManager::printRecord(const std::vector<Attribute> &fieldDescriptor, const void *recordData, std::ostream &out)
     {
-        return _pf_manager.createFile(fileName);
+        getCodec(fieldDescriptor)->print(fieldDescriptor, recordData, out);
+        return 0;
     }
 
-    RC RecordBasedFileManager::destroyFile(const std::string &fileName)
+    // A PAX row is updated by rebuilding its page. PAX rows never move, so the update fails when
+    // the page cannot hold the new row.
+    static RC updatePaxRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                              const RecordCodec &codec, const void *data, const RID &rid, ZoneMap *zoneMap)
+    {
+        unsigned pageSize = fileHandle.getPageSize();
+        char *pageData;
+        int rowIndex;
+        if (pinPaxRow(fileHandle, rid, pageData, rowIndex) != 0)
+        {
+            return -1;
+        }
+
+        ScratchBuffer imageBuffer(codec.getMaxRecordSize());
+        char *image = imageBuffer.data();
+        codec.encode(data, image);
+        std::vector<char> images;
+        std::vector<const char *> rows;
+        collectPaxRows(pageData, pageSize, recordDescriptor, images, rows);
+        rows[rowIndex] = image;
+
+        RC rc = 0;
+        bool rebuilt = buildPaxPage(recordDescriptor, rows, pageData, pageSize);
+        if (!rebuilt)
+        {
+            perror("Error: Updated record does not fit in its PAX page!");
+            rc = -1;
+        }
+        else if (zoneMap != nullptr)
+        {
+            zoneMap->note(rid.pageNum, recordDescriptor, image);
+        }
+
+        unsigned freeBytes = rebuilt ? getPaxFreeBytes(pageData, pageSize) : 0;
+        fileHandle.unpinPage(rid.pageNum, rebuilt);
+        if (rebuilt)
+            fileHandle.setFreeSpace(rid.pageNum, freeBytes);
+        return rc;
+    }
+
+    // Update a record without changing its RID:
+    //  1. rewrite it where it is if the new image fits there,
+    //  2. otherwise bring a moved record back to its home page if that page has room,
+    //  3. otherwise move it to another page and leave (or redirect) a tombstone in its home slot.
+    // The home slot always points straight at the record, so a read never takes more than one hop.
+    RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                            const void *data, const RID &rid)
+    {
+        unsigned pageSize = fileHandle.getPageSize();
+        if (isPaxFile(fileHandle))
+        {
+            return updatePaxRecord(fileHandle, recordDescriptor, *getCodec(recordDescriptor), data, rid,
+                                   getZoneMap(fileHandle));
+        }
+
+        char *homeData;
+        if (fileHandle.pinPage(rid.pageNum, homeData) != 0)
+        {
+            return -1;
+        }
+
+        int homeOffset, homeLength;
+        if (rid.slotNum < 1 || rid.slotNum > getSlotCount(homeData, pageSize))
+        {
+            fileHandle.unpinPage(rid.pageNum, false);
+            return -1;
+        }
+        getSlot(homeData, pageSize, rid.slotNum, homeOffset, homeLength);
+        if (homeOffset == EMPTY_SLOT || (!isTombstone(homeOffset, homeLength) &&
+                                         isForwardedRecord(homeData, homeOffset)))
+        {
+            fileHandle.unpinPage(rid.pageNum, false);
+            return -1;
+        }
+
+        // Overflow chains of the old image; they are freed once the new image is in place
+        std::vector<PageNum> oldChains;
+        PageNum oldPage;
+        char *oldData;
+        int oldOffset, oldLength;
+        if (pinRecord(fileHandle, rid, oldPage, oldData, oldOffset, oldLength) == 0)
+        {
+            collectOverflowHeads(oldData + oldOffset, oldChains);
+            fileHandle.unpinPage(oldPage, false);
+        }
+
+        // New image, with room in front for a forward header in case it has to move
+        std::shared_ptr<const RecordCodec> codec = getCodec(recordDescriptor);
+        ScratchBuffer scratch(FORWARD_HEADER_SIZE + codec->getMaxRecordSize());
+        char *imageBuffer = scratch.data();
+        char *recordImage = imageBuffer + FORWARD_HEADER_SIZE;
+        int recordSize = codec->encode(data, recordImage);
+        if (recordSize > getMaxInlineRecordSize(pageSize) &&
+            (recordSize = spillRecord(fileHandle, recordDescriptor, recordImage, recordSize)) < 0)
+        {
+            fileHandle.unpinPage(rid.pageNum, false);
+            return -1;
+        }
+        writeForwardHeader(imageBuffer, rid);
+        int forwardedSize = FORWARD_HEADER_SIZE + recordSize;
+
+        RC rc = 0;
+        bool homeDirty = false;
+        PageNum landedPage = rid.pageNum; // Page the new image ends up on
+        if (!isTombstone(homeOffset, homeLength))
+        {
+            if (recordSize <= homeLength)
+            {
+                memcpy(homeData + homeOffset, recordImage, recordSize);
+                setSlot(homeData, pageSize, rid.slotNum, homeOffset, recordSize);
+                homeDirty = true;
+            }
+            else
+            {
+                // The old image is dead once the record is rewritten, so it does not count as used
+                setSlot(homeData, pageSize, rid.slotNum, EMPTY_SLOT, 0);
+                if (makeRoom(homeData, pageSize, recordSize))
+                {
+                    appendToSlot(homeData, pageSize, rid.slotNum, recordImage, recordSize);
+                    homeDirty = true;
+                }
+                else
+                {
+                    setSlot(homeData, pageSize, rid.slotNum, homeOffset, homeLength);
+                }
+            }
+
+            if (!homeDirty)
+            {
+                RID target;
+                rc = storeRecord(fileHandle, imageBuffer, forwardedSize, target);
+                if (rc == 0)
+                {
+                    setTombstone(homeData, pageSize, rid.slotNum, target);
+                    homeDirty = true;
+                    landedPage = target.pageNum;
+                }
+            }
+        }
+        else
+        {
+            RID target;
+            target.pageNum = homeOffset;
+            target.slotNum = -homeLength;
+            char *targetData;
+            rc = fileHandle.pinPage(target.pageNum, targetData);
+            if (rc == 0)
+            {
+                int targetOffset, targetLength;
+                getSlot(targetData, pageSize, target.slotNum, targetOffset, targetLength);
+
+                landedPage = target.pageNum;
+                bool rewritten = forwardedSize <= targetLength;
+                if (rewritten)
+                {
+                    memcpy(targetData + targetOffset, imageBuffer, forwardedSize);
+                    setSlot(targetData, pageSize, target.slotNum, targetOffset, forwardedSize);
+                }
+                else
+                {
+                    setSlot(targetData, pageSize, target.slotNum, EMPTY_SLOT, 0);
+                    rewritten = makeRoom(targetData, pageSize, forwardedSize);
+                    if (rewritten)
+                        appendToSlot(targetData, pageSize, target.slotNum, imageBuffer, forwardedSize);
+                    else
+                        setSlot(targetData, pageSize, target.slotNum, targetOffset, targetLength);
+                }
+
+                if (!rewritten && makeRoom(homeData, pageSize, recordSize))
+                {
+                    appendToSlot(homeData, pageSize, rid.slotNum, recordImage, recordSize);
+                    setSlot(targetData, pageSize, target.slotNum, EMPTY_SLOT, 0);
+                    homeDirty = true;
+                    landedPage = rid.pageNum;
+                }
+                else if (!rewritten)
+                {
+                    RID newTarget;
+                    rc = storeRecord(fileHandle, imageBuffer, forwardedSize, newTarget);
+                    if (rc == 0)
+                    {
+                        setTombstone(homeData, pageSize, rid.slotNum, newTarget);
+                        setSlot(targetData, pageSize, target.slotNum, EMPTY_SLOT, 0);
+                        homeDirty = true;
+                        landedPage = newTarget.pageNum;
+                    }
+                }
+
+                unsigned targetFree = getReclaimableBytes(targetData, pageSize);
+                fileHandle.unpinPage(target.pageNum, true);
+                fileHandle.setFreeSpace(target.pageNum, targetFree);
+            }
+        }
+
+        ZoneMap *zoneMap = getZoneMap(fileHandle);
+        if (rc == 0 && zoneMap != nullptr)
+        {
+            zoneMap->note(landedPage, recordDescriptor, recordImage);
+        }
+        if (rc == 0)
+        {
+            for (PageNum head : oldChains)
+                freeOverflowChain(fileHandle, head);
+        }
+        else
+        {
+            freeOverflowFields(fileHandle, recordImage);
+        }
+
+        unsigned homeFree = getReclaimableBytes(homeData, pageSize);
+        fileHandle.unpinPage(rid.pageNum, homeDirty);
+        if (homeDirty)
+            fileHandle.setFreeSpace(rid.pageNum, homeFree);
+        return rc;
+    }
+
+    // Bring every moved record whose home page has room back home, compact each page and rebuild
+    // its free-space map entry. Nothing moves between pages otherwise, so RIDs stay valid.
+    RC RecordBasedFileManager::vacuum(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                      VacuumStats &stats)
+    {
+        unsigned pageSize = fileHandle.getPageSize();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        PageNum numPages = fileHandle.getNumberOfPages();
+        stats.pagesBefore = numPages;
+        stats.pagesAfter = numPages;
+        stats.pagesReclaimed = 0;
+        stats.recordsMoved = 0;
+        ZoneMap *zoneMap = getZoneMap(fileHandle);
+
+        for (PageNum pageNum = 0; pageNum < numPages; pageNum++)
+        {
+            char *pageData;
+            if (fileHandle.pinPage(pageNum, pageData) != 0)
+            {
+                return -1;
+            }
+
+            if (isPaxFile(fileHandle))
+            {
+                // PAX rows never move; rebuilding the page drops the characters of deleted rows
+                std::vector<char> images;
+                std::vector<const char *> rows;
+                collectPaxRows(pageData, pageSize, recordDescriptor, images, rows);
+                bool rebuilt = buildPaxPage(recordDescriptor, rows, pageData, pageSize);
+                unsigned freeBytes = rebuilt ? getPaxFreeBytes(pageData, pageSize)
+                                             : getPaxReclaimableBytes(pageData, pageSize, recordDescriptor);
+                fileHandle.unpinPage(pageNum, rebuilt);
+                if (fileHandle.setFreeSpace(pageNum, freeBytes) != 0)
+                {
+                    return -1;
+                }
+                continue;
+            }
+
+            if (isOverflowPage(pageData, pageSize))
+            {
+                fileHandle.unpinPage(pageNum, false);
+                continue; // Part of a value's overflow chain; its record keeps pointing at it
+            }
+
+            bool dirty = false;
+            int slotCount = getSlotCount(pageData, pageSize);
+            for (int slotNum = 1; slotNum <= slotCount; slotNum++)
+            {
+                int recordOffset, recordLength;
+                getSlot(pageData, pageSize, slotNum, recordOffset, recordLength);
+                if (!isTombstone(recordOffset, recordLength))
+                {
+                    continue;
+                }
+
+                RID target;
+                target.pageNum = recordOffset;
+                target.slotNum = -recordLength;
+                char *targetData;
+                if (fileHandle.pinPage(target.pageNum, targetData) != 0)
+                {
+                    fileHandle.unpinPage(pageNum, dirty);
+                    return -1;
+                }
+
+                int targetOffset, targetLength;
+                getSlot(targetData, pageSize, target.slotNum, targetOffset, targetLength);
+                int recordSize = targetLength - FORWARD_HEADER_SIZE;
+                bool movedHome = makeRoom(pageData, pageSize, recordSize);
+                if (movedHome)
+                {
+                    // makeRoom may have compacted this page, but not the target page unless it is the same one
+                    getSlot(targetData, pageSize, target.slotNum, targetOffset, targetLength);
+                    appendToSlot(pageData, pageSize, slotNum, targetData + targetOffset + FORWARD_HEADER_SIZE, recordSize);
+                    releaseSlot(targetData, pageSize, target.slotNum);
+                    if (zoneMap != nullptr)
+                        zoneMap->note(pageNum, recordDescriptor, pageData + getUsedSpace(pageData, pageSize) - recordSize);
+                    stats.recordsMoved++;
+                    dirty = true;
+                }
+
+                unsigned targetFree = getReclaimableBytes(targetData, pageSize);
+                fileHandle.unpinPage(target.pageNum, movedHome);
+                if (movedHome && target.pageNum != pageNum)
+                    fileHandle.setFreeSpace(target.pageNum, targetFree);
+                slotCount = getSlotCount(pageData, pageSize);
+            }
+
+            if (getFreeBytes(pageData, pageSize) != getReclaimableBytes(pageData, pageSize))
+            {
+                compactPage(pageData, pageSize);
+                dirty = true;
+            }
+            unsigned freeBytes = getReclaimableBytes(pageData, pageSize);
+            fileHandle.unpinPage(pageNum, dirty);
+            if (fileHandle.setFreeSpace(pageNum, freeBytes) != 0)
+            {
+                return -1;
+            }
+        }
+
+        // Pages whose records are all gone stay in the file; the free-space map hands them out again
+        for (PageNum pageNum = 0; pageNum < numPages; pageNum++)
+        {
+            char *pageData;
+            if (fileHandle.pinPage(pageNum, pageData) != 0)
+            {
+                return -1;
+            }
+            if ((isPaxFile(fileHandle) ? getPaxRowCount(pageData, pageSize) : getSlotCount(pageData, pageSize)) == 0)
+                stats.pagesReclaimed++;
+            fileHandle.unpinPage(pageNum, false);
+        }
+
+        stats.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return 0;
+    }
+
+    // Copy the live records of the file, in page order, into page images of a new file; moved
+    // records are copied without their forward header. The new file then takes the old one's name.
+    RC RecordBasedFileManager::vacuumFile(const std::string &fileName, const std::vector<Attribute> &recordDescriptor,
+                                          std::vector<std::pair<RID, RID>> &ridMap, VacuumStats &stats)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        ridMap.clear();
+        stats.recordsMoved = 0;
+
+        FileHandle source;
+        if (openFile(fileName, source) != 0)
+        {
+            return -1;
+        }
+
+        std::string tempName = fileName + ".vacuum";
+        FileHandle target;
+        unsigned pageSize = source.getPageSize();
+        if (createFile(tempName, (PageLayout)source.formatTag, pageSize) != 0 || openFile(tempName, target) != 0)
+        {
+            closeFile(source);
+            return -1;
+        }
+
+        ScratchBuffer pageBuffer(pageSize, true);
+        char *pageImage = pageBuffer.data();
+        ZoneMap *zoneMap = getZoneMap(target);
+        PageNum numPages = source.getNumberOfPages();
+        RC status = 0;
+        for (PageNum pageNum = 0; pageNum < numPages && status == 0; pageNum++)
+        {
+            char *pageData;
+            if (source.pinPage(pageNum, pageData) != 0)
+            {
+                status = -1;
+                break;
+            }
+
+            // PAX rows are rebuilt in the row format and stored again, filling the new pages in order
+            int rowCount = isPaxFile(source) ? getPaxRowCount(pageData, pageSize) : 0;
+            for (int rowIndex = 0; rowIndex < rowCount; rowIndex++)
+            {
+                if (!isPaxRowLive(pageData, rowIndex))
+                {
+                    continue;
+                }
+                RID home, newRid;
+                home.pageNum = pageNum;
+                home.slotNum = rowIndex + 1;
+                std::vector<char> image(getMaxRecordSize(recordDescriptor));
+                materializePaxRow(pageData, pageSize, recordDescriptor, rowIndex, image.data());
+                status = storePaxRecord(target, recordDescriptor, image.data(), newRid);
+                if (status != 0)
+                {
+                    break;
+                }
+                if (zoneMap != nullptr)
+                    zoneMap->note(newRid.pageNum, recordDescriptor, image.data());
+                ridMap.push_back(std::make_pair(home, newRid));
+                stats.recordsMoved++;
+            }
+
+            int slotCount = isPaxFile(source) ? 0 : getSlotCount(pageData, pageSize);
+            for (int slotNum = 1; slotNum <= slotCount && status == 0; slotNum++)
+            {
+                int recordOffset, recordLength;
+                getSlot(pageData, pageSize, slotNum, recordOffset, recordLength);
+                if (recordOffset < 0 || recordLength < 0)
+                {
+                    continue; // Empty slot, or a tombstone whose record is copied from the page it moved to
+                }
+
+                RID home;
+                home.pageNum = pageNum;
+                home.slotNum = slotNum;
+                const char *image = pageData + recordOffset;
+                if (isForwardedRecord(pageData, recordOffset))
+                {
+                    readForwardHeader(image, home);
+                    image += FORWARD_HEADER_SIZE;
+                    recordLength -= FORWARD_HEADER_SIZE;
+                }
+
+                // Values on overflow pages get new chains in the new file, written ahead of the page
+                // image the record goes to
+                bool copyChains = hasOverflowFields(image);
+                ScratchBuffer copyBuffer(copyChains ? getMaxRecordSize(recordDescriptor) * 2 : 0);
+                if (copyChains)
+                {
+                    std::shared_ptr<const RecordCodec> codec = getCodec(recordDescriptor);
+                    char *record = copyBuffer.data() + codec->getMaxRecordSize();
+                    if (codec->decode(image, record, &source) < 0 || flushPageImage(target, pageImage) != 0 ||
+                        (recordLength = spillRecord(target, recordDescriptor, copyBuffer.data(),
+                                                    codec->encode(record, copyBuffer.data()))) < 0)
+                    {
+                        status = -1;
+                        break;
+                    }
+                    image = copyBuffer.data();
+                }
+
+                RID newRid;
+                status = packRecord(target, pageImage, image, recordLength, newRid);
+                if (status != 0)
+                {
+                    break;
+                }
+                if (zoneMap != nullptr)
+                    zoneMap->note(newRid.pageNum, recordDescriptor, image);
+                ridMap.push_back(std::make_pair(home, newRid));
+                stats.recordsMoved++;
+            }
+            source.unpinPage(pageNum, false);
+        }
+
+        if (status == 0)
+        {
+            status = flushPageImage(target, pageImage);
+        }
+
+        stats.pagesBefore = numPages;
+        stats.pagesAfter = target.getNumberOfPages();
+        stats.pagesReclaimed = stats.pagesBefore - std::min(stats.pagesBefore, stats.pagesAfter);
+
+        if (closeFile(source) != 0)
+            status = -1;
+        if (closeFile(target) != 0)
+            status = -1;
+
+        // The old file is only replaced once the new one is complete on disk; the zone map built
+        // while packing replaces the old one as well
+        if (status == 0 && rename(tempName.c_str(), fileName.c_str()) != 0)
+        {
+            perror("Error: Failed to replace the vacuumed file!");
+            status = -1;
+        }
+        if (status == 0)
+        {
+            remove(getZoneMapFileName(fileName).c_str());
+            rename(getZoneMapFileName(tempName).c_str(), getZoneMapFileName(fileName).c_str());
+        }
+        if (status != 0)
+        {
+            destroyFile(tempName);
+            ridMap.clear();
+            return -1;
+        }
+
+        stats.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return 0;
+    }
+
+    // Compare a stored field with a value in the API format
+    static bool compareField(AttrType type, const char *fieldPtr, int fieldLength, CompOp compOp, const char *value)
+    {
+        int result = 0;
+        switch (type)
+        {
+        case TypeInt:
+        {
+            int fieldValue, conditionValue;
+            memcpy(&fieldValue, fieldPtr, sizeof(int));
+            memcpy(&conditionValue, value, sizeof(int));
+            result = (fieldValue > conditionValue) - (fieldValue < conditionValue);
+            break;
+        }
+        case TypeReal:
+        {
+            float fieldValue, conditionValue;
+            memcpy(&fieldValue, fieldPtr, sizeof(float));
+            memcpy(&conditionValue, value, sizeof(float));
+            result = (fieldValue > conditionValue) - (fieldValue < conditionValue);
+            break;
+        }
+        case TypeVarChar:
+        {
+            int conditionLength;
+            memcpy(&conditionLength, value, sizeof(int));
+            result = memcmp(fieldPtr, value + sizeof(int), std::min(fieldLength, conditionLength));
+            if (result == 0)
+                result = (fieldLength > conditionLength) - (fieldLength < conditionLength);
+            break;
+        }
+        default:
+            return false;
+        }
+
+        switch (compOp)
+        {
+        case EQ_OP:
+            return result == 0;
+        case LT_OP:
+            return result < 0;
+        case LE_OP:
+            return result <= 0;
+        case GT_OP:
+            return result > 0;
+        case GE_OP:
+            return result >= 0;
+        case NE_OP:
+            return result != 0;
+        default:
+            return true;
+        }
+    }
+
+    // Map attribute names to their index in the record descriptor
+    static RC resolveAttributes(const std::vector<Attribute> &recordDescriptor,
+                                const std::vector<std::string> &attributeNames, std::vector<int> &attributeIndexes)
+    {
+        attributeIndexes.clear();
+        for (const std::string &attributeName : attributeNames)
+        {
+            size_t i = 0;
+            while (i < recordDescriptor.size() && recordDescriptor[i].name != attributeName)
+                i++;
+            if (i == recordDescriptor.size())
+            {
+                perror("Error: Unknown attribute!");
+                return -1;
+            }
+            attributeIndexes.push_back(i);
+        }
+        return 0;
+    }
+
+    // Zone-map key of a field: Int and Real values as they are, VarChar values by their zero-padded prefix
+    static void makeZoneKey(AttrType type, const char *fieldPtr, int fieldLength, char *key)
     {
-        return _pf_manager.destroyFile(fileName);
+        memset(key, 0, ZONE_MAP_PREFIX_SIZE);
+        memcpy(key, fieldPtr, type == TypeVarChar ? std::min(fieldLength, ZONE_MAP_PREFIX_SIZE) : sizeof(int));
     }
 
-    RC RecordBasedFileManager::openFile(const std::string &fileName, FileHandle &fileHandle)
+    static int compareZoneKeys(AttrType type, const char *left, const char *right)
     {
-        return _pf_manager.openFile(fileName, fileHandle);
+        if (type == TypeVarChar)
+        {
+            return memcmp(left, right, ZONE_MAP_PREFIX_SIZE);
+        }
+        int result;
+        if (type == TypeInt)
+        {
+            int leftValue, rightValue;
+            memcpy(&leftValue, left, sizeof(int));
+            memcpy(&rightValue, right, sizeof(int));
+            result = (leftValue > rightValue) - (leftValue < rightValue);
+        }
+        else
+        {
+            float leftValue, rightValue;
+            memcpy(&leftValue, left, sizeof(float));
+            memcpy(&rightValue, right, sizeof(float));
+            result = (leftValue > rightValue) - (leftValue < rightValue);
+        }
+        return result;
     }
 
-    RC RecordBasedFileManager::closeFile(FileHandle &fileHandle)
+    ZoneMap::ZoneMap() : openCount(0), valid(false)
     {
-        return _pf_manager.closeFile(fileHandle);
     }
 
-    RC RecordBasedFileManager::insertRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
-                                            const void *inputData, RID &recordId)
+    void ZoneMap::note(PageNum pageNum, const std::vector<Attribute> &recordDescriptor, const char *recordPtr)
     {
-        // Number of fields in the record descriptor
-        int numFields = recordDescriptor.size();
-        printf("%d", numFields);
+        if (!valid)
+        {
+            return;
+        }
 
-        // Size of null indicator and initial offsets for data processing
-        int nullIndicatorSize = ceil((double)numFields / CHAR_BIT);
-        int inputOffset = nullIndicatorSize; // Offset for field data in the input
+        unsigned extent = pageNum / ZONE_MAP_EXTENT_PAGES;
+        if (extent >= extents.size())
+            extents.resize(extent + 1);
+        std::vector<ZoneEntry> &columns = extents[extent];
+        if (columns.size() < recordDescriptor.size())
+            columns.resize(recordDescriptor.size(), ZoneEntry());
 
-        // Offsets for record memory
-        int directoryOffset = nullIndicatorSize + sizeof(int);
-        int dataStartOffset = directoryOffset + numFields * sizeof(int);
+        // Records written before an attribute was added have fewer fields; the rest are null
+        int numFields;
+        memcpy(&numFields, recordPtr, sizeof(int));
+        int lastField = std::min(numFields, (int)recordDescriptor.size());
 
-        // Calculate the maximum size of the record data
-        int maxRecordSize = 0;
-        for (int i = 0; i < numFields; i++)
+        char key[ZONE_MAP_PREFIX_SIZE];
+        for (int fieldIndex = 0; fieldIndex < lastField; fieldIndex++)
         {
-            maxRecordSize += recordDescriptor[i].length;
-            if (recordDescriptor[i].type == TypeVarChar)
+            int fieldStart, fieldLength;
+            bool isNull;
+            getStoredField(recordPtr, fieldIndex, fieldStart, fieldLength, isNull);
+            if (isNull)
             {
-                maxRecordSize += sizeof(int); // Additional space for string length
+                continue;
             }
+
+            AttrType type = recordDescriptor[fieldIndex].type;
+            ZoneEntry &entry = columns[fieldIndex];
+            makeZoneKey(type, recordPtr + fieldStart, fieldLength, key);
+            if (!entry.hasValue)
+            {
+                memcpy(entry.min, key, ZONE_MAP_PREFIX_SIZE);
+                memcpy(entry.max, key, ZONE_MAP_PREFIX_SIZE);
+                entry.hasValue = 1;
+            }
+            else if (compareZoneKeys(type, key, entry.min) < 0)
+                memcpy(entry.min, key, ZONE_MAP_PREFIX_SIZE);
+            else if (compareZoneKeys(type, key, entry.max) > 0)
+                memcpy(entry.max, key, ZONE_MAP_PREFIX_SIZE);
         }
+    }
 
-        // Allocate memory for the record
-        unsigned char *recordBuffer = (unsigned char *)malloc(maxRecordSize + dataStartOffset);
+    bool ZoneMap::mayMatch(PageNum pageNum, unsigned columnIndex, AttrType type, CompOp compOp,
+                           const void *value) const
+    {
+        unsigned extent = pageNum / ZONE_MAP_EXTENT_PAGES;
+        if (!valid || compOp == NO_OP || extent >= extents.size() || columnIndex >= extents[extent].size())
+        {
+            return true;
+        }
 
-        const char *inputBytes = (char *)inputData;    // Pointer to input data
-        const char *nullIndicator = (char *)inputData; // Null indicator at the start of the input
+        // A null field never satisfies a condition
+        const ZoneEntry &entry = extents[extent][columnIndex];
+        if (!entry.hasValue)
+        {
+            return false;
+        }
 
-        // Copy number of fields and null indicator to the record
-        memcpy(recordBuffer, &numFields, sizeof(int));
-        memcpy(recordBuffer + sizeof(int), inputBytes, nullIndicatorSize);
+        char key[ZONE_MAP_PREFIX_SIZE];
+        const char *valuePtr = (const char *)value;
+        if (type == TypeVarChar)
+        {
+            int valueLength;
+            memcpy(&valueLength, valuePtr, sizeof(int));
+            makeZoneKey(type, valuePtr + sizeof(int), valueLength, key);
+        }
+        else
+        {
+            makeZoneKey(type, valuePtr, sizeof(int), key);
+        }
 
-        // Process each field
-        for (int i = 0; i < numFields; i++)
+        // Equal VarChar prefixes say nothing about the order of the full values
+        int minResult = compareZoneKeys(type, entry.min, key);
+        int maxResult = compareZoneKeys(type, entry.max, key);
+        bool exact = type != TypeVarChar;
+        switch (compOp)
+        {
+        case EQ_OP:
+            return minResult <= 0 && maxResult >= 0;
+        case LT_OP:
+            return minResult < 0 || (!exact && minResult == 0);
+        case LE_OP:
+            return minResult <= 0;
+        case GT_OP:
+            return maxResult > 0 || (!exact && maxResult == 0);
+        case GE_OP:
+            return maxResult >= 0;
+        case NE_OP:
+            return !exact || minResult != 0 || maxResult != 0;
+        default:
+            return true;
+        }
+    }
+
+    RC ZoneMap::rebuild(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor)
+    {
+        unsigned pageSize = fileHandle.getPageSize();
+        extents.clear();
+        valid = true;
+
+        PageNum numPages = fileHandle.getNumberOfPages();
+        for (PageNum pageNum = 0; pageNum < numPages; pageNum++)
         {
-            if (!(nullIndicator[i / 8] & (1 << (7 - i % 8))))
+            char *pageData;
+            if (fileHandle.pinPage(pageNum, pageData) != 0)
+            {
+                valid = false;
+                return -1;
+            }
+
+            if (isPaxFile(fileHandle))
             {
-                switch (recordDescriptor[i].type)
+                std::vector<char> images;
+                std::vector<const char *> rows;
+                collectPaxRows(pageData, pageSize, recordDescriptor, images, rows);
+                for (const char *row : rows)
                 {
-                case TypeInt:
-                    memcpy(recordBuffer + dataStartOffset, &inputBytes[inputOffset], sizeof(int));
-                    inputOffset += sizeof(int);
-                    dataStartOffset += sizeof(int);
-                    memcpy(recordBuffer + directoryOffset, &dataStartOffset, sizeof(int));
-                    directoryOffset += sizeof(int);
-                    break;
-                case TypeReal:
-                    memcpy(recordBuffer + dataStartOffset, &inputBytes[inputOffset], sizeof(float));
-                    inputOffset += sizeof(float);
-                    dataStartOffset += sizeof(float);
-                    memcpy(recordBuffer + directoryOffset, &dataStartOffset, sizeof(int));
-                    directoryOffset += sizeof(int);
-                    break;
-                case TypeVarChar:
-                    int strLength;
-                    memcpy(&strLength, &inputBytes[inputOffset], sizeof(int));
-                    memcpy(recordBuffer + dataStartOffset, &inputBytes[inputOffset + sizeof(int)], strLength);
-                    dataStartOffset += strLength;
-                    inputOffset += sizeof(int) + strLength;
-                    memcpy(recordBuffer + directoryOffset, &dataStartOffset, sizeof(int));
-                    directoryOffset += sizeof(int);
-                    break;
-                default:
-                    break;
+                    if (row != nullptr)
+                        note(pageNum, recordDescriptor, row);
                 }
+                fileHandle.unpinPage(pageNum, false);
+                continue;
             }
-            else
+
+            int slotCount = getSlotCount(pageData, pageSize);
+            for (int slotNum = 1; slotNum <= slotCount; slotNum++)
             {
-                // Null field; record current offset in the directory
-                memcpy(recordBuffer + directoryOffset, &dataStartOffset, sizeof(int));
-                directoryOffset += sizeof(int);
+                int recordOffset, recordLength;
+                getSlot(pageData, pageSize, slotNum, recordOffset, recordLength);
+                if (recordOffset < 0 || recordLength < 0)
+                {
+                    continue;
+                }
+                const char *recordPtr = pageData + recordOffset;
+                if (isForwardedRecord(pageData, recordOffset))
+                    recordPtr += FORWARD_HEADER_SIZE;
+                note(pageNum, recordDescriptor, recordPtr);
             }
+            fileHandle.unpinPage(pageNum, false);
         }
+        return 0;
+    }
 
-        // Handling pages in the file
-        int currentPage = fileHandle.getNumberOfPages() - 1;
-        int slotCount;
-        int usedSpace;
-        char *pageBuffer = (char *)malloc(PAGE_SIZE * sizeof(char));
-        bool isFullCycle = false;
-
-        if (currentPage < 0)
+    // File format: [page count][write generation][extent count], then per extent [column count][ZoneEntry per
+    // column]. The file is removed once loaded, so it only exists while its data file is closed cleanly. Pages
+    // rewritten through a plain FileHandle in the meantime bump the write generation and make it stale.
+    RC ZoneMap::load(const std::string &fileName, unsigned numberOfPages, unsigned writeGeneration)
+    {
+        extents.clear();
+        std::string zoneMapFileName = getZoneMapFileName(fileName);
+        FILE *file = fopen(zoneMapFileName.c_str(), "rb");
+        if (file == nullptr)
         {
-            // No pages; create the first page and add the record
-            memcpy(pageBuffer, recordBuffer, dataStartOffset);
-            slotCount = 1;
-            int directoryStart = PAGE_SIZE - sizeof(int) * 2 - sizeof(int) * 2;
-            int recordStart = 0;
-            memcpy(pageBuffer + directoryStart, &recordStart, sizeof(int));
-            memcpy(pageBuffer + directoryStart + sizeof(int), &dataStartOffset, sizeof(int));
-            usedSpace = dataStartOffset;
-            memcpy(pageBuffer + PAGE_SIZE - sizeof(int) * 2, &slotCount, sizeof(int));
-            memcpy(pageBuffer + PAGE_SIZE - sizeof(int), &usedSpace, sizeof(int));
-            fileHandle.appendPage(pageBuffer);
-            currentPage++;
+            // Nothing to summarise in an empty file; otherwise the map is rebuilt when it is needed
+            valid = numberOfPages == 0;
+            return valid ? 0 : -1;
         }
-        else
+
+        unsigned header[3];
+        valid = fread(header, sizeof(unsigned), 3, file) == 3 && header[0] == numberOfPages &&
+                header[1] == writeGeneration;
+        if (valid)
         {
-            while (currentPage < fileHandle.getNumberOfPages())
+            extents.resize(header[2]);
+            for (std::vector<ZoneEntry> &columns : extents)
             {
-                fileHandle.readPage(currentPage, pageBuffer);
-                memcpy(&usedSpace, &pageBuffer[PAGE_SIZE - sizeof(int)], sizeof(int));
-                memcpy(&slotCount, &pageBuffer[PAGE_SIZE - sizeof(int) * 2], sizeof(int));
-
-                int directoryStart = PAGE_SIZE - sizeof(int) * 2 - slotCount * sizeof(int) * 2;
-                if (directoryStart - usedSpace >= dataStartOffset + sizeof(int) * 2)
+                unsigned numColumns;
+                if (fread(&numColumns, sizeof(unsigned), 1, file) != 1)
                 {
-                    // Add the record to the current page
-                    memcpy(pageBuffer + usedSpace, recordBuffer, dataStartOffset);
-                    slotCount++;
-                    memcpy(pageBuffer + directoryStart - sizeof(int) * 2, &usedSpace, sizeof(int));
-                    memcpy(pageBuffer + directoryStart - sizeof(int), &dataStartOffset, sizeof(int));
-                    usedSpace += dataStartOffset;
-                    memcpy(pageBuffer + PAGE_SIZE - sizeof(int) * 2, &slotCount, sizeof(int));
-                    memcpy(pageBuffer + PAGE_SIZE - sizeof(int), &usedSpace, sizeof(int));
-                    fileHandle.writePage(currentPage, pageBuffer);
+                    valid = false;
                     break;
                 }
-                else
+                columns.resize(numColumns);
+                if (numColumns > 0 && fread(columns.data(), sizeof(ZoneEntry), numColumns, file) != numColumns)
                 {
-                    if (currentPage == (fileHandle.getNumberOfPages() - 1) && !isFullCycle)
-                    {
-                        currentPage = 0;
-                        isFullCycle = true;
-                    }
-                    else if (currentPage == (fileHandle.getNumberOfPages() - 1) && isFullCycle)
-                    {
-                        // No space in all pages; create a new page
-                        memcpy(pageBuffer, recordBuffer, dataStartOffset);
-                        slotCount = 1;
-                        int directoryStart = PAGE_SIZE - sizeof(int) * 2 - sizeof(int) * 2;
-                        int recordStart = 0;
-                        memcpy(pageBuffer + directoryStart, &recordStart, sizeof(int));
-                        memcpy(pageBuffer + directoryStart + sizeof(int), &dataStartOffset, sizeof(int));
-                        usedSpace = dataStartOffset;
-                        memcpy(pageBuffer + PAGE_SIZE - sizeof(int) * 2, &slotCount, sizeof(int));
-                        memcpy(pageBuffer + PAGE_SIZE - sizeof(int), &usedSpace, sizeof(int));
-                        fileHandle.appendPage(pageBuffer);
-                        currentPage++;
-                        break;
-                    }
-                    else
-                    {
-                        currentPage++;
-                    }
+                    valid = false;
+                    break;
                 }
             }
         }
+        fclose(file);
+        remove(zoneMapFileName.c_str());
 
-        // Set the record ID
-        recordId.slotNum = slotCount;
-        recordId.pageNum = currentPage;
-
-        // Free allocated memory
-        free(recordBuffer);
-        free(pageBuffer);
-
+        if (!valid)
+        {
+            extents.clear();
+            return -1;
+        }
         return 0;
     }
 
-    RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
-                                          const RID &recordID, void *outputData)
+    RC ZoneMap::save(const std::string &fileName, unsigned numberOfPages, unsigned writeGeneration)
     {
-        // Allocate memory to hold the page data
-        char *pageData = (char *)malloc(PAGE_SIZE * sizeof(char));
+        std::string zoneMapFileName = getZoneMapFileName(fileName);
+        FILE *file = fopen(zoneMapFileName.c_str(), "wb");
+        if (file == nullptr)
+        {
+            perror("Error: Failed to write the zone map!");
+            return -1;
+        }
 
-        // Read the page containing the record into memory
-        fileHandle.readPage(recordID.pageNum, pageData);
+        unsigned header[3] = {numberOfPages, writeGeneration, (unsigned)extents.size()};
+        bool written = fwrite(header, sizeof(unsigned), 3, file) == 3;
+        for (const std::vector<ZoneEntry> &columns : extents)
+        {
+            unsigned numColumns = columns.size();
+            written = written && fwrite(&numColumns, sizeof(unsigned), 1, file) == 1;
+            written = written && (numColumns == 0 ||
+                                  fwrite(columns.data(), sizeof(ZoneEntry), numColumns, file) == numColumns);
+        }
+        if (fclose(file) != 0 || !written)
+        {
+            remove(zoneMapFileName.c_str());
+            return -1;
+        }
+        return 0;
+    }
 
-        // Determine the number of fields in the record
-        int totalFields = recordDescriptor.size();
+    // Write the given fields of a stored record in the API format and return the size written, or -1.
+    // Each field is reached through the offset directory, so the cost does not depend on its position;
+    // overflow pages are only read for the projected values that live there.
+    static int projectStoredRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                   const std::vector<int> &attributeIndexes, const char *recordPtr, char *data)
+    {
+        int nullIndicatorSize = ceil((double)attributeIndexes.size() / CHAR_BIT);
+        memset(data, 0, nullIndicatorSize);
+        unsigned dataOffset = nullIndicatorSize;
 
-        // Retrieve the record's starting offset from the slot directory
-        int recordStartOffset = 0;
-        memcpy(&recordStartOffset,
-               pageData + PAGE_SIZE - sizeof(int) * 2 - (2 * sizeof(int) * recordID.slotNum),
-               sizeof(int));
+        for (size_t i = 0; i < attributeIndexes.size(); i++)
+        {
+            int fieldIndex = attributeIndexes[i];
+            int fieldStart, fieldLength;
+            bool isNull;
+            getStoredField(recordPtr, fieldIndex, fieldStart, fieldLength, isNull);
+            if (isNull)
+            {
+                data[i / 8] |= (1 << (7 - i % 8));
+                continue;
+            }
 
-        // Point to the actual record within the page
-        char *recordPtr = pageData + recordStartOffset;
+            bool overflow = isOverflowField(recordPtr, fieldIndex);
+            if (overflow)
+                fieldLength = getOverflowLength(recordPtr + fieldStart);
+            if (recordDescriptor[fieldIndex].type == TypeVarChar)
+            {
+                memcpy(data + dataOffset, &fieldLength, sizeof(int));
+                dataOffset += sizeof(int);
+            }
+            if (!overflow)
+                memcpy(data + dataOffset, recordPtr + fieldStart, fieldLength);
+            else if (readOverflowValue(fileHandle, recordPtr + fieldStart, data + dataOffset) != 0)
+                return -1;
+            dataOffset += fieldLength;
+        }
+        return dataOffset;
+    }
 
-        // Determine the size of the null fields indicator
-        int nullIndicatorSize = ceil((double)totalFields / CHAR_BIT);
+    RC RecordBasedFileManager::readAttributes(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                              const RID &rid, const std::vector<std::string> &attributeNames,
+                                              void *data)
+    {
+        std::vector<int> attributeIndexes;
+        if (resolveAttributes(recordDescriptor, attributeNames, attributeIndexes) != 0)
+        {
+            return -1;
+        }
+        if (isPaxFile(fileHandle))
+        {
+            return readPaxAttributes(fileHandle, recordDescriptor, rid, attributeIndexes, data);
+        }
 
-        // Copy the null fields indicator to the output data
-        memcpy(outputData, recordPtr + sizeof(int), nullIndicatorSize);
+        PageNum pinnedPage;
+        char *pageData;
+        int recordOffset, recordLength;
+        if (pinRecord(fileHandle, rid, pinnedPage, pageData, recordOffset, recordLength) != 0)
+        {
+            return -1;
+        }
 
-        // Initialize pointers and offsets for processing the record
-        char *nullIndicator = recordPtr + sizeof(int);
-        int outputDataOffset = nullIndicatorSize; // Start of the actual data in output
-        int recordDataOffset = sizeof(int) + nullIndicatorSize + sizeof(int) * totalFields;
-        int directoryOffset = sizeof(int) + nullIndicatorSize;
+        int dataSize = projectStoredRecord(fileHandle, recordDescriptor, attributeIndexes, pageData + recordOffset,
+                                           (char *)data);
+        RC rc = fileHandle.unpinPage(pinnedPage, false);
+        return dataSize < 0 ? -1 : rc;
+    }
 
-        char *outputDataPtr = (char *)outputData;
+    RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                             const RID &rid, const std::string &attributeName, void *data)
+    {
+        // A single attribute in the projection format is [1-byte null indicator][value]
+        return readAttributes(fileHandle, recordDescriptor, rid, std::vector<std::string>(1, attributeName), data);
+    }
 
-        // Initialize variables for directory and variable-length fields
-        int previousFieldEnd = 0;
-        int currentFieldEnd = 0;
-        int varcharLength = 0;
+    RC RecordBasedFileManager::scan(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                    const std::string &conditionAttribute, const CompOp compOp, const void *value,
+                                    const std::vector<std::string> &attributeNames,
+                                    RBFM_ScanIterator &rbfm_ScanIterator)
+    {
+        rbfm_ScanIterator.close();
 
-        // Process each field in the record
-        for (int fieldIndex = 0; fieldIndex < totalFields; fieldIndex++)
+        // Resolve the condition attribute
+        int conditionIndex = -1;
+        if (compOp != NO_OP)
         {
-            // Check if the field is null
-            if (!(nullIndicator[fieldIndex / 8] & (1 << (7 - fieldIndex % 8))))
+            for (size_t i = 0; i < recordDescriptor.size(); i++)
             {
-                switch (recordDescriptor[fieldIndex].type)
+                if (recordDescriptor[i].name == conditionAttribute)
                 {
-                case TypeInt:
-                    // Copy integer data
-                    memcpy(&outputDataPtr[outputDataOffset], recordPtr + recordDataOffset, sizeof(int));
-                    outputDataOffset += sizeof(int);
-                    recordDataOffset += sizeof(int);
-                    break;
-
-                case TypeReal:
-                    // Copy real (float) data
-                    memcpy(&outputDataPtr[outputDataOffset], recordPtr + recordDataOffset, sizeof(float));
-                    outputDataOffset += sizeof(float);
-                    recordDataOffset += sizeof(float);
+                    conditionIndex = i;
                     break;
+                }
+            }
+            if (conditionIndex < 0 || value == nullptr)
+            {
+                perror("Error: Invalid scan condition!");
+                return -1;
+            }
+        }
 
-                case TypeVarChar:
-                    // Determine the length of the variable-length string
-                    if (fieldIndex == 0)
-                        previousFieldEnd = recordDataOffset;
-                    else
-                        memcpy(&previousFieldEnd, recordPtr + directoryOffset + (fieldIndex - 1) * sizeof(int), sizeof(int));
-
-                    memcpy(&currentFieldEnd, recordPtr + directoryOffset + fieldIndex * sizeof(int), sizeof(int));
-                    varcharLength = currentFieldEnd - previousFieldEnd;
-
-                    // Copy the length and the actual string data
-                    memcpy(&outputDataPtr[outputDataOffset], &varcharLength, sizeof(int));
-                    memcpy(&outputDataPtr[outputDataOffset + sizeof(int)], recordPtr + recordDataOffset, varcharLength);
+        // Resolve the projected attributes
+        std::vector<int> projectedIndexes;
+        if (resolveAttributes(recordDescriptor, attributeNames, projectedIndexes) != 0)
+        {
+            return -1;
+        }
 
-                    outputDataOffset += sizeof(int) + varcharLength;
-                    recordDataOffset += varcharLength;
-                    break;
+        // Worst-case size of one projected record, used to size batches
+        unsigned maxProjectedSize = ceil((double)projectedIndexes.size() / CHAR_BIT);
+        for (int index : projectedIndexes)
+        {
+            maxProjectedSize += recordDescriptor[index].length;
+            if (recordDescriptor[index].type == TypeVarChar)
+                maxProjectedSize += sizeof(int);
+        }
 
-                default:
-                    // Handle unexpected types (if necessary)
-                    break;
-                }
+        // Keep a private copy of the comparison value
+        rbfm_ScanIterator.value.clear();
+        if (conditionIndex >= 0)
+        {
+            int valueSize = sizeof(int);
+            if (recordDescriptor[conditionIndex].type == TypeVarChar)
+            {
+                int valueLength;
+                memcpy(&valueLength, value, sizeof(int));
+                valueSize += valueLength;
             }
+            rbfm_ScanIterator.value.assign((const char *)value, (const char *)value + valueSize);
         }
 
-        // Free the allocated memory for the page data
-        free(pageData);
+        rbfm_ScanIterator.fileHandle = &fileHandle;
+        rbfm_ScanIterator.pageSize = fileHandle.getPageSize();
+        rbfm_ScanIterator.recordDescriptor = recordDescriptor;
+        rbfm_ScanIterator.conditionIndex = conditionIndex;
+        rbfm_ScanIterator.compOp = compOp;
+        rbfm_ScanIterator.projectedIndexes = projectedIndexes;
+        rbfm_ScanIterator.maxProjectedSize = maxProjectedSize;
+        rbfm_ScanIterator.currentPage = 0;
+        rbfm_ScanIterator.currentSlot = 0;
+        rbfm_ScanIterator.pageData = nullptr;
+        rbfm_ScanIterator.reservedStart = 0;
+        rbfm_ScanIterator.reservedPages.clear();
+        rbfm_ScanIterator.paxLayout = isPaxFile(fileHandle);
+        rbfm_ScanIterator.codec = *getCodec(recordDescriptor);
+        rbfm_ScanIterator.fullProjection = projectedIndexes.size() == recordDescriptor.size();
+        for (size_t i = 0; i < projectedIndexes.size() && rbfm_ScanIterator.fullProjection; i++)
+            rbfm_ScanIterator.fullProjection = projectedIndexes[i] == (int)i;
+        if (rbfm_ScanIterator.paxLayout)
+            rbfm_ScanIterator.rowBuffer.resize(rbfm_ScanIterator.codec.getMaxRecordSize());
 
-        // Return success code
+        // A conditional scan skips extents through the zone map, which is rebuilt first if it was lost
+        ZoneMap *zoneMap = getZoneMap(fileHandle);
+        if (conditionIndex >= 0 && zoneMap != nullptr && !zoneMap->isValid())
+        {
+            zoneMap->rebuild(fileHandle, recordDescriptor);
+        }
+        rbfm_ScanIterator.zoneMap = conditionIndex >= 0 && zoneMap != nullptr && zoneMap->isValid() ? zoneMap : nullptr;
         return 0;
     }
 
-    RC RecordBasedFileManager::deleteRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
-                                            const RID &rid)
+    RBFM_ScanIterator::RBFM_ScanIterator()
+        : fileHandle(nullptr), pageSize(PAGE_SIZE), conditionIndex(-1), compOp(NO_OP), maxProjectedSize(0), currentPage(0), currentSlot(0),
+          pageData(nullptr), zoneMap(nullptr), paxLayout(false), fullProjection(false)
     {
-        return -1;
     }
 
-    RC RecordBasedFileManager::printRecord(const std::vector<Attribute> &fieldDescriptor, const void *recordData, std::ostream &out)
+    RBFM_ScanIterator::~RBFM_ScanIterator()
     {
-        int totalFields = fieldDescriptor.size();
-        int currentOffset = ceil((double)totalFields / CHAR_BIT);
-        const char *dataPointer = (char *)recordData;
+        close();
+    }
 
-        // Iterate through all fields to print their content
-        for (int fieldIndex = 0; fieldIndex < totalFields; fieldIndex++)
+    // Pin currentPage, moving past extents the zone map rules out; RBFM_EOF once no page is left
+    RC RBFM_ScanIterator::pinCurrentPage()
+    {
+        while (true)
         {
-            // Check if the field is null by evaluating the corresponding bit in the null bitmap
-            if (!(dataPointer[fieldIndex / 8] & (1 << (7 - fieldIndex % 8))))
+            if (currentPage >= fileHandle->getNumberOfPages())
             {
-                // Field is not null, process the field based on its type
-                switch (fieldDescriptor[fieldIndex].type)
-                {
-                case TypeVarChar:
+                return RBFM_EOF;
+            }
+            if (zoneMap != nullptr && currentPage % ZONE_MAP_EXTENT_PAGES == 0 &&
+                !zoneMap->mayMatch(currentPage, conditionIndex, recordDescriptor[conditionIndex].type, compOp,
+                                   value.data()))
+            {
+                currentPage += ZONE_MAP_EXTENT_PAGES; // No record of this extent can match
+                continue;
+            }
+            if (currentPage < reservedStart || currentPage - reservedStart >= reservedPages.size())
+            {
+                if (fileHandle->getReservedPages(currentPage, reservedStart, reservedPages) != 0)
                 {
-                    // Handle variable-length string type
-                    int strLength;
-                    memcpy(&strLength, &dataPointer[currentOffset], sizeof(int));
+                    return -1;
+                }
+            }
+            if (reservedPages[currentPage - reservedStart])
+            {
+                currentPage++; // Overflow page, only read through the records that point to it
+                continue;
+            }
+            if (fileHandle->pinPage(currentPage, pageData) != 0)
+            {
+                pageData = nullptr;
+                return -1;
+            }
+            currentSlot = 0;
+            return 0;
+        }
+    }
+
+    // Evaluate the condition on a PAX row of the pinned page, reading only the condition's minipage
+    bool RBFM_ScanIterator::rowMatches(int rowIndex)
+    {
+        if (!isPaxRowLive(pageData, rowIndex))
+        {
+            return false;
+        }
+        if (conditionIndex < 0)
+        {
+            return true;
+        }
 
-                    // Allocate memory for the string and copy the content
-                    char *stringContent = new char[strLength + 1];
-                    memcpy(stringContent, &dataPointer[currentOffset + sizeof(int)], strLength);
-                    stringContent[strLength] = '\0';
+        AttrType type = recordDescriptor[conditionIndex].type;
+        const char *fieldPtr;
+        int fieldLength;
+        bool isNull;
+        getPaxField(pageData, pageSize, type, rowIndex, conditionIndex, fieldPtr, fieldLength, isNull);
+        return !isNull && compareField(type, fieldPtr, fieldLength, compOp, value.data());
+    }
 
-                    printf("%s: %s\n", fieldDescriptor[fieldIndex].name.c_str(), stringContent);
+    // Advance to the next record that satisfies the condition; recordPtr points into the pinned page.
+    // For a PAX file recordPtr is nullptr and the record is row currentSlot of the pinned page.
+    RC RBFM_ScanIterator::nextMatch(RID &rid, const char *&recordPtr)
+    {
+        if (fileHandle == nullptr)
+        {
+            return RBFM_EOF;
+        }
 
-                    currentOffset += strLength + sizeof(int);
-                    delete[] stringContent;
-                    break;
-                }
-                case TypeInt:
+        while (true)
+        {
+            if (pageData == nullptr)
+            {
+                RC rc = pinCurrentPage();
+                if (rc != 0)
                 {
-                    // Handle integer type
-                    int intValue;
-                    memcpy(&intValue, &dataPointer[currentOffset], sizeof(int));
+                    return rc;
+                }
+            }
 
-                    printf("%s: %d\n", fieldDescriptor[fieldIndex].name.c_str(), intValue);
-                    currentOffset += sizeof(int);
-                    break;
+            if (paxLayout)
+            {
+                int rowCount = getPaxRowCount(pageData, pageSize);
+                while (currentSlot < rowCount)
+                {
+                    currentSlot++;
+                    if (rowMatches(currentSlot - 1))
+                    {
+                        rid.pageNum = currentPage;
+                        rid.slotNum = currentSlot;
+                        recordPtr = nullptr;
+                        return 0;
+                    }
                 }
-                case TypeReal:
+            }
+
+            int slotCount = paxLayout ? 0 : getSlotCount(pageData, pageSize);
+            while (currentSlot < slotCount)
+            {
+                currentSlot++;
+                int recordOffset, recordLength;
+                getSlot(pageData, pageSize, currentSlot, recordOffset, recordLength);
+                if (recordOffset < 0 || recordLength < 0)
                 {
-                    // Handle floating-point type
-                    float floatValue;
-                    memcpy(&floatValue, &dataPointer[currentOffset], sizeof(float));
+                    continue; // Empty slot, or a tombstone whose record is visited on the page it moved to
+                }
 
-                    printf("%s: %f\n", fieldDescriptor[fieldIndex].name.c_str(), floatValue);
-                    currentOffset += sizeof(float);
-                    break;
+                // A moved record is reported under its home RID
+                RID recordId;
+                recordId.pageNum = currentPage;
+                recordId.slotNum = currentSlot;
+                const char *candidate = pageData + recordOffset;
+                if (isForwardedRecord(pageData, recordOffset))
+                {
+                    readForwardHeader(candidate, recordId);
+                    candidate += FORWARD_HEADER_SIZE;
                 }
-                default:
-                    break; // Handle unknown types if necessary
+
+                if (conditionIndex >= 0)
+                {
+                    int fieldStart, fieldLength;
+                    bool isNull;
+                    getStoredField(candidate, conditionIndex, fieldStart, fieldLength, isNull);
+                    if (isNull)
+                    {
+                        continue;
+                    }
+                    AttrType type = recordDescriptor[conditionIndex].type;
+                    if (isOverflowField(candidate, conditionIndex))
+                    {
+                        // Only a condition on the value itself makes the scan follow its overflow chain
+                        int valueLength = getOverflowLength(candidate + fieldStart);
+                        ScratchBuffer valueBuffer(valueLength);
+                        if (readOverflowValue(*fileHandle, candidate + fieldStart, valueBuffer.data()) != 0 ||
+                            !compareField(type, valueBuffer.data(), valueLength, compOp, value.data()))
+                        {
+                            continue;
+                        }
+                    }
+                    else if (!compareField(type, candidate + fieldStart, fieldLength, compOp, value.data()))
+                    {
+                        continue;
+                    }
                 }
+
+                rid = recordId;
+                recordPtr = candidate;
+                return 0;
             }
+
+            // Page exhausted, move on to the next one
+            fileHandle->unpinPage(currentPage, false);
+            pageData = nullptr;
+            currentPage++;
+        }
+    }
+
+    RC RBFM_ScanIterator::getNextRecord(RID &rid, void *data)
+    {
+        const char *recordPtr;
+        RC rc = nextMatch(rid, recordPtr);
+        if (rc != 0)
+        {
+            return rc;
+        }
+        if (paxLayout)
+        {
+            projectPaxRow(pageData, pageSize, recordDescriptor, projectedIndexes, currentSlot - 1, (char *)data);
+            return 0;
+        }
+        int dataSize = fullProjection
+                           ? codec.decode(recordPtr, data, fileHandle)
+                           : projectStoredRecord(*fileHandle, recordDescriptor, projectedIndexes, recordPtr, (char *)data);
+        return dataSize < 0 ? -1 : 0;
+    }
+
+    RC RBFM_ScanIterator::getNextRecordView(RID &rid, RecordView &view)
+    {
+        view.release();
+
+        const char *recordPtr;
+        RC rc = nextMatch(rid, recordPtr);
+        if (rc != 0)
+        {
+            return rc;
+        }
+        if (paxLayout)
+        {
+            // A PAX row is rebuilt in the iterator's own buffer
+            materializePaxRow(pageData, pageSize, recordDescriptor, currentSlot - 1, rowBuffer.data());
+            recordPtr = rowBuffer.data();
+        }
+        view.attach(recordPtr); // The iterator keeps the page pinned
+        return 0;
+    }
+
+    RC RBFM_ScanIterator::getNextBatch(std::vector<RID> &rids, void *data, unsigned maxRows, unsigned bufferSize,
+                                       std::vector<unsigned> &offsets)
+    {
+        rids.clear();
+        offsets.clear();
+        offsets.push_back(0);
+        if (maxRows == 0 || bufferSize < maxProjectedSize)
+        {
+            perror("Error: Batch buffer cannot hold a record!");
+            return -1;
+        }
+
+        char *output = (char *)data;
+        unsigned dataOffset = 0;
+        RID rid;
+        const char *recordPtr;
+        while (rids.size() < maxRows && bufferSize - dataOffset >= maxProjectedSize)
+        {
+            RC rc = nextMatch(rid, recordPtr);
+            if (rc == RBFM_EOF)
+            {
+                break;
+            }
+            if (rc != 0)
+            {
+                return rc;
+            }
+            int dataSize;
+            if (paxLayout)
+                dataSize = projectPaxRow(pageData, pageSize, recordDescriptor, projectedIndexes, currentSlot - 1,
+                                         output + dataOffset);
+            else if (fullProjection)
+                dataSize = codec.decode(recordPtr, output + dataOffset, fileHandle);
             else
+                dataSize = projectStoredRecord(*fileHandle, recordDescriptor, projectedIndexes, recordPtr,
+                                               output + dataOffset);
+            if (dataSize < 0)
             {
-                // Field is null, print "NULL"
-                printf("%s: NULL\n", fieldDescriptor[fieldIndex].name.c_str());
+                return -1;
             }
+            dataOffset += dataSize;
+            rids.push_back(rid);
+            offsets.push_back(dataOffset);
         }
 
-        return 0; // Return value to indicate success (could be improved for error handling)
+        return rids.empty() ? RBFM_EOF : 0;
     }
 
-    RC RecordBasedFileManager::updateRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
-                                            const void *data, const RID &rid)
+    RC RBFM_ScanIterator::getNextColumnChunk(std::vector<RID> &rids, std::vector<char> &values)
     {
-        return -1;
-    }
+        rids.clear();
+        values.clear();
+        if (fileHandle == nullptr)
+        {
+            return RBFM_EOF;
+        }
+        if (!paxLayout || projectedIndexes.size() != 1)
+        {
+            perror("Error: Column chunks need a PAX file and one projected attribute!");
+            return -1;
+        }
 
-    RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
-                                             const RID &rid, const std::string &attributeName, void *data)
-    {
-        return -1;
+        int columnIndex = projectedIndexes[0];
+        AttrType type = recordDescriptor[columnIndex].type;
+        while (rids.empty())
+        {
+            if (pageData == nullptr)
+            {
+                RC rc = pinCurrentPage();
+                if (rc != 0)
+                {
+                    return rc;
+                }
+            }
+
+            // Only the state bytes, the null indicators and two minipages are touched
+            int rowCount = getPaxRowCount(pageData, pageSize);
+            for (int rowIndex = currentSlot; rowIndex < rowCount; rowIndex++)
+            {
+                const char *fieldPtr;
+                int fieldLength;
+                bool isNull;
+                if (!rowMatches(rowIndex))
+                {
+                    continue;
+                }
+                getPaxField(pageData, pageSize, type, rowIndex, columnIndex, fieldPtr, fieldLength, isNull);
+                if (isNull)
+                {
+                    continue;
+                }
+
+                if (type == TypeVarChar)
+                    values.insert(values.end(), (const char *)&fieldLength, (const char *)&fieldLength + sizeof(int));
+                values.insert(values.end(), fieldPtr, fieldPtr + fieldLength);
+                RID rid;
+                rid.pageNum = currentPage;
+                rid.slotNum = rowIndex + 1;
+                rids.push_back(rid);
+            }
+
+            fileHandle->unpinPage(currentPage, false);
+            pageData = nullptr;
+            currentPage++;
+        }
+        return 0;
     }
 
-    RC RecordBasedFileManager::scan(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
-                                    const std::string &conditionAttribute, const CompOp compOp, const void *value,
-                                    const std::vector<std::string> &attributeNames,
-                                    RBFM_ScanIterator &rbfm_ScanIterator)
+    RC RBFM_ScanIterator::close()
     {
-        return -1;
+        if (pageData != nullptr)
+        {
+            fileHandle->unpinPage(currentPage, false);
+            pageData = nullptr;
+        }
+        fileHandle = nullptr;
+        zoneMap = nullptr;
+        return 0;
     }
 
 } // namespace PeterDB
@@ -0,0 +1,193 @@
+#include <chrono>
+#include <iostream>
+#include <fcntl.h>
+#include <random>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "src/include/pfm.h"
+#include "test/utils/pfm_test_utils.h"
+
+// Benchmarks are disabled by default; run them with --gtest_also_run_disabled_tests
+namespace PeterDBTesting {
+
+    static double elapsedMs(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    TEST_F (PFM_Page_Test, DISABLED_bench_checksum_modes) {
+        // Cost of page checksums: CRC32C alone, appends (which store a checksum), and physical page reads
+        // with verification off, on, and on while a scrubber walks the same file
+
+        unsigned numPages = 20000;
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        generateData(inBuffer, PAGE_SIZE);
+
+        auto start = std::chrono::steady_clock::now();
+        unsigned checksum = 0;
+        for (unsigned i = 0; i < numPages; i++) {
+            checksum += PeterDB::crc32c(inBuffer, PAGE_SIZE);
+        }
+        double crcMs = elapsedMs(start);
+        std::cout << "[ BENCH    ] crc32c: " << numPages * (PAGE_SIZE / 1024.0) / crcMs << " MB/s ("
+                  << checksum << ")" << std::endl;
+
+        start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < numPages; i++) {
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success);
+        }
+        std::cout << "[ BENCH    ] append with checksums: " << numPages / elapsedMs(start) << " pages/ms"
+                  << std::endl;
+
+        // A small pool turns every read into a physical read
+        ASSERT_EQ(PeterDB::BufferManager::instance().setNumFrames(8), success);
+        auto readAll = [&](bool verify) {
+            reopenFile();
+            fileHandle.setChecksumVerification(verify);
+            auto readStart = std::chrono::steady_clock::now();
+            for (unsigned i = 0; i < numPages; i++) {
+                EXPECT_EQ(fileHandle.readPage(i, outBuffer), success);
+            }
+            return numPages / elapsedMs(readStart);
+        };
+        double offRate = readAll(false);
+        double onRate = readAll(true);
+
+        PeterDB::PageScrubber scrubber;
+        ASSERT_EQ(scrubber.start(fileName, 5000, true), success);
+        double scrubRate = readAll(true);
+        ASSERT_EQ(scrubber.stop(), success);
+        PeterDB::ScrubStats stats;
+        scrubber.getStats(stats);
+        ASSERT_EQ(stats.corruptPages.size(), 0) << "No page should be reported.";
+
+        std::cout << "[ BENCH    ] physical reads: verification off " << offRate << " pages/ms, on " << onRate
+                  << " pages/ms, on with a 5000 pages/s scrubber " << scrubRate << " pages/ms ("
+                  << stats.pagesChecked << " pages scrubbed)" << std::endl;
+
+        ASSERT_EQ(PeterDB::BufferManager::instance().setNumFrames(DEFAULT_BUFFER_FRAMES), success);
+
+    }
+
+    TEST_F (PFM_Page_Test, DISABLED_bench_io_engines) {
+        // pread/pwrite against io_uring: a sequential read of a file dropped from the page cache (read-ahead
+        // through the pool under io_uring, posix_fadvise otherwise), and writing back a pool full of dirty pages
+
+        unsigned numPages = 20000, dirtyPages = 4096;
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        generateData(inBuffer, PAGE_SIZE);
+        for (unsigned i = 0; i < numPages; i++) {
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success);
+        }
+        ASSERT_EQ(PeterDB::BufferManager::instance().setNumFrames(dirtyPages), success);
+
+        for (PeterDB::IOEngine engine : {PeterDB::IO_ENGINE_PREAD, PeterDB::IO_ENGINE_URING}) {
+            reopenFile();
+            ASSERT_EQ(fileHandle.sync(), success);
+            ASSERT_EQ(posix_fadvise(fileHandle.fd, 0, 0, POSIX_FADV_DONTNEED), 0);
+            ASSERT_EQ(fileHandle.setIOEngine(engine), success);
+            const char *name = fileHandle.getIOEngine() == PeterDB::IO_ENGINE_URING ? "io_uring" : "pread/pwrite";
+
+            auto start = std::chrono::steady_clock::now();
+            for (unsigned i = 0; i < numPages; i++) {
+                ASSERT_EQ(fileHandle.readPage(i, outBuffer), success);
+            }
+            double readMs = elapsedMs(start);
+
+            for (unsigned i = 0; i < dirtyPages; i++) {
+                ASSERT_EQ(fileHandle.writePage(i * 4, inBuffer), success);
+            }
+            start = std::chrono::steady_clock::now();
+            ASSERT_EQ(fileHandle.sync(), success);
+            double flushMs = elapsedMs(start);
+
+            std::cout << "[ BENCH    ] " << name << ": cold sequential read " << numPages / readMs
+                      << " pages/ms, write-back of " << dirtyPages << " scattered dirty pages " << flushMs << " ms"
+                      << std::endl;
+        }
+        ASSERT_EQ(PeterDB::BufferManager::instance().setNumFrames(DEFAULT_BUFFER_FRAMES), success);
+
+    }
+
+
+    // Pages of the file that are in the kernel page cache
+    static unsigned residentPages(const std::string &fileName) {
+        struct stat fileStat;
+        stat(fileName.c_str(), &fileStat);
+        size_t pages = (fileStat.st_size + getpagesize() - 1) / getpagesize();
+        int fd = open(fileName.c_str(), O_RDONLY);
+        void *mapping = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        std::vector<unsigned char> residency(pages);
+        unsigned resident = 0;
+        if (mapping != MAP_FAILED && mincore(mapping, fileStat.st_size, residency.data()) == 0) {
+            for (unsigned char page : residency) {
+                resident += page & 1;
+            }
+        }
+        munmap(mapping, fileStat.st_size);
+        close(fd);
+        return resident;
+    }
+
+    TEST_F (PFM_Page_Test, DISABLED_bench_direct_io) {
+        // Buffered I/O against O_DIRECT with each engine: a cold sequential read, random reads that miss a
+        // 16 MB pool, and the write-back of a pool full of dirty pages. The footprint is the pool plus the
+        // pages of the file the kernel still caches afterwards.
+
+        unsigned numPages = 40000, poolPages = 4096, randomReads = 20000;
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        generateData(inBuffer, PAGE_SIZE);
+        for (unsigned i = 0; i < numPages; i++) {
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success);
+        }
+        ASSERT_EQ(PeterDB::BufferManager::instance().setNumFrames(poolPages), success);
+
+        for (PeterDB::IOMode mode : {PeterDB::IO_POSIX, PeterDB::IO_DIRECT}) {
+            for (PeterDB::IOEngine engine : {PeterDB::IO_ENGINE_PREAD, PeterDB::IO_ENGINE_URING}) {
+                ASSERT_EQ(pfm.closeFile(fileHandle), success);
+                int fd = open(fileName.c_str(), O_RDONLY);
+                ASSERT_EQ(posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED), 0);
+                close(fd);
+                fileHandle = PeterDB::FileHandle();
+                ASSERT_EQ(pfm.openFile(fileName, fileHandle, mode), success);
+                ASSERT_EQ(fileHandle.setIOEngine(engine), success);
+                std::string name = std::string(mode == PeterDB::IO_DIRECT ? "O_DIRECT" : "buffered") + ", " +
+                                   (fileHandle.getIOEngine() == PeterDB::IO_ENGINE_URING ? "io_uring" : "pread");
+
+                auto start = std::chrono::steady_clock::now();
+                for (unsigned i = 0; i < numPages; i++) {
+                    ASSERT_EQ(fileHandle.readPage(i, outBuffer), success);
+                }
+                double scanMs = elapsedMs(start);
+
+                std::mt19937 random(42);
+                start = std::chrono::steady_clock::now();
+                for (unsigned i = 0; i < randomReads; i++) {
+                    ASSERT_EQ(fileHandle.readPage(random() % numPages, outBuffer), success);
+                }
+                double randomMs = elapsedMs(start);
+
+                for (unsigned i = 0; i < poolPages; i++) {
+                    ASSERT_EQ(fileHandle.writePage(random() % numPages, inBuffer), success);
+                }
+                start = std::chrono::steady_clock::now();
+                ASSERT_EQ(fileHandle.sync(), success);
+                double flushMs = elapsedMs(start);
+
+                unsigned cached = residentPages(fileName);
+                std::cout << "[ BENCH    ] " << name << ": cold scan " << numPages / scanMs << " pages/ms, random reads "
+                          << randomReads / randomMs << " pages/ms, write-back " << flushMs << " ms; footprint "
+                          << (poolPages + cached) * (PAGE_SIZE / 1024) / 1024 << " MB (pool "
+                          << poolPages * (PAGE_SIZE / 1024) / 1024 << " MB, page cache "
+                          << cached * (PAGE_SIZE / 1024) / 1024 << " MB)" << std::endl;
+            }
+        }
+        ASSERT_EQ(PeterDB::BufferManager::instance().setNumFrames(DEFAULT_BUFFER_FRAMES), success);
+
+    }
+
+} // namespace PeterDBTesting
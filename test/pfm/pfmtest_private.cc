@@ -0,0 +1,879 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+
+#include "src/include/pfm.h"
+#include "test/utils/pfm_test_utils.h"
+
+namespace PeterDBTesting {
+
+    TEST_F (PFM_Page_Test, buffer_pool_hit_does_no_physical_read) {
+        // Functions Tested:
+        // 1. Append Page
+        // 2. Reopen File
+        // 3. Read Page twice, the second read is served by the buffer pool
+
+        unsigned readPageCount = 0, writePageCount = 0, appendPageCount = 0;
+        unsigned updatedReadPageCount = 0, updatedWritePageCount = 0, updatedAppendPageCount = 0;
+
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        generateData(inBuffer, PAGE_SIZE);
+        ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+
+        reopenFile();
+
+        ASSERT_EQ(fileHandle.readPage(0, outBuffer), success) << "Reading a page should succeed.";
+        ASSERT_EQ(fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount), success)
+                                    << "Collecting counters should succeed.";
+
+        ASSERT_EQ(fileHandle.readPage(0, outBuffer), success) << "Reading a page should succeed.";
+        ASSERT_EQ(fileHandle.collectCounterValues(
+                updatedReadPageCount, updatedWritePageCount, updatedAppendPageCount), success)
+                                    << "Collecting counters should succeed.";
+
+        ASSERT_EQ(readPageCount, updatedReadPageCount) << "A buffered page should not be read from disk again.";
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0) << "Checking the integrity of the page should succeed.";
+
+    }
+
+    TEST_F (PFM_Page_Test, buffer_pool_writes_back_on_eviction) {
+        // Functions Tested:
+        // 1. Shrink the buffer pool
+        // 2. Write more pages than there are frames
+        // 3. Reopen File and check every page
+
+        ASSERT_EQ(PeterDB::BufferManager::instance().setNumFrames(4), success) << "Resizing the pool should succeed.";
+
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        unsigned numPages = 20;
+        for (unsigned i = 0; i < numPages; i++) {
+            generateData(inBuffer, PAGE_SIZE, i + 1);
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+        for (unsigned i = 0; i < numPages; i++) {
+            generateData(inBuffer, PAGE_SIZE, i + 7, i);
+            ASSERT_EQ(fileHandle.writePage(i, inBuffer), success) << "Writing a page should succeed.";
+        }
+
+        reopenFile();
+
+        for (unsigned i = 0; i < numPages; i++) {
+            generateData(inBuffer, PAGE_SIZE, i + 7, i);
+            ASSERT_EQ(fileHandle.readPage(i, outBuffer), success) << "Reading a page should succeed.";
+            ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0)
+                                        << "Checking the integrity of page " << i << " should succeed.";
+        }
+
+        ASSERT_EQ(PeterDB::BufferManager::instance().setNumFrames(DEFAULT_BUFFER_FRAMES), success)
+                                    << "Resizing the pool should succeed.";
+
+    }
+
+    TEST_F (PFM_Page_Test, pinned_page_is_shared_in_place) {
+        // Functions Tested:
+        // 1. Pin Page
+        // 2. Modify the frame in place and unpin it dirty
+        // 3. Read Page sees the change
+
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        generateData(inBuffer, PAGE_SIZE);
+        ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+
+        char *frame = nullptr;
+        ASSERT_EQ(fileHandle.pinPage(0, frame), success) << "Pinning a page should succeed.";
+        frame[0] = 'X';
+        ASSERT_EQ(fileHandle.unpinPage(0, true), success) << "Unpinning a page should succeed.";
+        ASSERT_NE(fileHandle.unpinPage(0, false), success) << "Unpinning an unpinned page should not succeed.";
+        ASSERT_NE(fileHandle.pinPage(1, frame), success) << "Pinning a nonexistent page should not succeed.";
+
+        reopenFile();
+        ASSERT_EQ(fileHandle.readPage(0, outBuffer), success) << "Reading a page should succeed.";
+        ASSERT_EQ(((char *) outBuffer)[0], 'X') << "The in-place change should have been written back.";
+
+    }
+
+    TEST_F (PFM_Page_Test, concurrent_misses_read_a_page_once) {
+        // Functions Tested:
+        // 1. Four threads read the same cold pages through handles of their own
+        // 2. A thread that misses a page another thread is reading waits for it instead of reading it again
+
+        unsigned numPages = 64, numThreads = 4;
+        inBuffer = malloc(PAGE_SIZE);
+        for (unsigned i = 0; i < numPages; i++) {
+            generateData(inBuffer, PAGE_SIZE, i + 1);
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+        reopenFile();
+
+        std::vector<PeterDB::FileHandle> handles(numThreads);
+        unsigned reads = 0;
+        for (PeterDB::FileHandle &handle : handles) {
+            ASSERT_EQ(pfm.openFile(fileName, handle), success) << "Opening the file should succeed.";
+            reads -= handle.readPageCounter;
+        }
+        std::vector<unsigned> mismatches(numThreads, 0);
+        std::vector<std::thread> readers;
+        for (unsigned t = 0; t < numThreads; t++) {
+            readers.emplace_back([&, t] {
+                std::vector<char> expected(PAGE_SIZE), page(PAGE_SIZE);
+                for (unsigned i = 0; i < numPages; i++) {
+                    generateData(expected.data(), PAGE_SIZE, i + 1);
+                    if (handles[t].readPage(i, page.data()) != success ||
+                        memcmp(expected.data(), page.data(), PAGE_SIZE) != 0) {
+                        mismatches[t]++;
+                    }
+                }
+            });
+        }
+        for (unsigned t = 0; t < numThreads; t++) {
+            readers[t].join();
+            ASSERT_EQ(mismatches[t], 0) << "Every page should read back intact.";
+            reads += handles[t].readPageCounter;
+            ASSERT_EQ(pfm.closeFile(handles[t]), success) << "Closing the file should succeed.";
+        }
+        ASSERT_EQ(reads, numPages) << "Each page should be read from disk once.";
+
+    }
+
+    TEST_F (PFM_Page_Test, checkpoint_persists_hidden_page) {
+        // Functions Tested:
+        // 1. Append Pages, the page count only lives in memory
+        // 2. Checkpoint
+        // 3. A second handle sees the persisted page count
+
+        inBuffer = malloc(PAGE_SIZE);
+        generateData(inBuffer, PAGE_SIZE);
+        for (unsigned i = 0; i < 3; i++) {
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+        ASSERT_EQ(fileHandle.checkpoint(), success) << "Checkpointing the hidden page should succeed.";
+
+        PeterDB::FileHandle otherHandle;
+        ASSERT_EQ(pfm.openFile(fileName, otherHandle), success) << "Opening the file should succeed.";
+        ASSERT_EQ(otherHandle.getNumberOfPages(), 3) << "The persisted page count should be 3.";
+
+        unsigned readPageCount = 0, writePageCount = 0, appendPageCount = 0;
+        ASSERT_EQ(otherHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount), success)
+                                    << "Collecting counters should succeed.";
+        ASSERT_EQ(appendPageCount, 3) << "The persisted append counter should be 3.";
+        ASSERT_EQ(pfm.closeFile(otherHandle), success) << "Closing the file should succeed.";
+
+    }
+
+    TEST_F (PFM_Page_Test, destroyed_open_handle_is_closed) {
+        // Functions Tested:
+        // 1. Write a page through a second handle and let it go out of scope without closing it
+        // 2. The pool no longer counts the handle and the page reached the file
+
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        generateData(inBuffer, PAGE_SIZE);
+        ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        ASSERT_EQ(fileHandle.checkpoint(), success) << "Checkpointing the hidden page should succeed.";
+
+        generateData(inBuffer, PAGE_SIZE, 7);
+        {
+            PeterDB::FileHandle otherHandle;
+            ASSERT_EQ(pfm.openFile(fileName, otherHandle), success) << "Opening the file should succeed.";
+            ASSERT_EQ(otherHandle.writePage(0, inBuffer), success) << "Writing a page should succeed.";
+        }
+        ASSERT_EQ(PeterDB::BufferManager::instance().getOpenHandles(fileHandle.fileId), 1)
+                                    << "Only the fixture's handle should be left.";
+
+        reopenFile();
+        ASSERT_EQ(fileHandle.readPage(0, outBuffer), success) << "Reading a page should succeed.";
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0) << "The page should have been written back.";
+
+    }
+
+    TEST_F (PFM_Page_Test, open_handle_cannot_be_opened_again) {
+        // Functions Tested:
+        // 1. Open File on a handle that is already open fails
+        // 2. The handle keeps working and the pool still counts it once
+
+        ASSERT_NE(pfm.openFile(fileName, fileHandle), success) << "Opening an open handle should fail.";
+        ASSERT_EQ(PeterDB::BufferManager::instance().getOpenHandles(fileHandle.fileId), 1)
+                                    << "The handle should be registered once.";
+
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        generateData(inBuffer, PAGE_SIZE);
+        ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        ASSERT_EQ(fileHandle.readPage(0, outBuffer), success) << "Reading a page should succeed.";
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0) << "The page should be intact.";
+
+    }
+
+    TEST_F (PFM_Page_Test, stdio_and_posix_modes_share_the_format) {
+        // Functions Tested:
+        // 1. Reopen File with stdio I/O and append pages
+        // 2. Reopen File with pread/pwrite I/O and read them back
+
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+        fileHandle = PeterDB::FileHandle();
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle, PeterDB::IO_STDIO), success) << "Opening the file should succeed.";
+
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        for (unsigned i = 0; i < 5; i++) {
+            generateData(inBuffer, PAGE_SIZE, i + 3);
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+        fileHandle = PeterDB::FileHandle();
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle, PeterDB::IO_POSIX), success) << "Opening the file should succeed.";
+
+        ASSERT_EQ(fileHandle.getNumberOfPages(), 5) << "The page count should be 5.";
+        for (unsigned i = 0; i < 5; i++) {
+            generateData(inBuffer, PAGE_SIZE, i + 3);
+            ASSERT_EQ(fileHandle.readPage(i, outBuffer), success) << "Reading a page should succeed.";
+            ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0) << "Checking the integrity of the page should succeed.";
+        }
+
+    }
+
+    TEST_F (PFM_Page_Test, durability_modes_control_write_back) {
+        // Functions Tested:
+        // 1. Per-write durability writes every page right away
+        // 2. Group commit writes the pages once the page limit is reached
+        // 3. Sync writes whatever is still buffered
+
+        unsigned readPageCount = 0, writePageCount = 0, appendPageCount = 0;
+        unsigned updatedReadPageCount = 0, updatedWritePageCount = 0, updatedAppendPageCount = 0;
+
+        inBuffer = malloc(PAGE_SIZE);
+        generateData(inBuffer, PAGE_SIZE);
+        for (unsigned i = 0; i < 4; i++) {
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+
+        ASSERT_EQ(fileHandle.setDurability(PeterDB::DURABILITY_PER_WRITE), success);
+        ASSERT_EQ(fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount), success);
+        ASSERT_EQ(fileHandle.writePage(0, inBuffer), success) << "Writing a page should succeed.";
+        ASSERT_EQ(fileHandle.collectCounterValues(
+                updatedReadPageCount, updatedWritePageCount, updatedAppendPageCount), success);
+        ASSERT_EQ(writePageCount + 1, updatedWritePageCount) << "The page should have been written through.";
+
+        ASSERT_NE(fileHandle.setDurability(PeterDB::DURABILITY_GROUP_COMMIT), success)
+                                    << "Group commit without a limit should not be accepted.";
+        ASSERT_EQ(fileHandle.setDurability(PeterDB::DURABILITY_GROUP_COMMIT, 3), success);
+        writePageCount = updatedWritePageCount;
+        ASSERT_EQ(fileHandle.writePage(1, inBuffer), success) << "Writing a page should succeed.";
+        ASSERT_EQ(fileHandle.writePage(2, inBuffer), success) << "Writing a page should succeed.";
+        ASSERT_EQ(fileHandle.collectCounterValues(
+                updatedReadPageCount, updatedWritePageCount, updatedAppendPageCount), success);
+        ASSERT_EQ(writePageCount, updatedWritePageCount) << "The pages should still be buffered.";
+        ASSERT_EQ(fileHandle.writePage(3, inBuffer), success) << "Writing a page should succeed.";
+        ASSERT_EQ(fileHandle.collectCounterValues(
+                updatedReadPageCount, updatedWritePageCount, updatedAppendPageCount), success);
+        ASSERT_EQ(writePageCount + 3, updatedWritePageCount) << "The group should have been committed.";
+
+        ASSERT_EQ(fileHandle.setDurability(PeterDB::DURABILITY_ON_CLOSE), success);
+        writePageCount = updatedWritePageCount;
+        ASSERT_EQ(fileHandle.writePage(0, inBuffer), success) << "Writing a page should succeed.";
+        ASSERT_EQ(fileHandle.sync(), success) << "Syncing the file should succeed.";
+        ASSERT_EQ(fileHandle.collectCounterValues(
+                updatedReadPageCount, updatedWritePageCount, updatedAppendPageCount), success);
+        ASSERT_EQ(writePageCount + 1, updatedWritePageCount) << "Sync should write the buffered page.";
+
+    }
+
+    TEST_F (PFM_Page_Test, page_size_is_kept_per_file) {
+        // Functions Tested:
+        // 1. Create a file with 16 KB pages next to the default one; bad sizes are rejected
+        // 2. Write both files through a small pool, so frames switch between page sizes
+        // 3. Reopen the file and check its page size, its pages and its size on disk
+
+        std::string largeFileName = "pfm_test_large_pages";
+        unsigned largeSize = 4 * PAGE_SIZE;
+        ASSERT_NE(pfm.createFile(largeFileName, 3000), success) << "A page size that is not a power of two should fail.";
+        ASSERT_NE(pfm.createFile(largeFileName, 2 * MAX_PAGE_SIZE), success) << "A too large page size should fail.";
+        ASSERT_EQ(pfm.createFile(largeFileName, largeSize), success) << "Creating the file should succeed.";
+
+        PeterDB::FileHandle largeHandle;
+        ASSERT_EQ(pfm.openFile(largeFileName, largeHandle), success) << "Opening the file should succeed.";
+        ASSERT_EQ(largeHandle.getPageSize(), largeSize) << "The file should use the page size it was created with.";
+        ASSERT_EQ(fileHandle.getPageSize(), (unsigned) PAGE_SIZE) << "Other files should keep the default page size.";
+
+        ASSERT_EQ(PeterDB::BufferManager::instance().setNumFrames(4), success) << "Resizing the pool should succeed.";
+        inBuffer = malloc(largeSize);
+        outBuffer = malloc(largeSize);
+        unsigned numPages = 10;
+        for (unsigned i = 0; i < numPages; i++) {
+            generateData(inBuffer, largeSize, i + 1);
+            ASSERT_EQ(largeHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+            generateData(inBuffer, PAGE_SIZE, i + 2);
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+        for (unsigned i = 0; i < numPages; i++) {
+            generateData(inBuffer, largeSize, i + 7, i);
+            ASSERT_EQ(largeHandle.writePage(i, inBuffer), success) << "Writing a page should succeed.";
+            generateData(inBuffer, PAGE_SIZE, i + 8, i);
+            ASSERT_EQ(fileHandle.writePage(i, inBuffer), success) << "Writing a page should succeed.";
+        }
+        ASSERT_EQ(pfm.closeFile(largeHandle), success) << "Closing the file should succeed.";
+        reopenFile();
+
+        largeHandle = PeterDB::FileHandle();
+        ASSERT_EQ(pfm.openFile(largeFileName, largeHandle), success) << "Opening the file should succeed.";
+        ASSERT_EQ(largeHandle.getPageSize(), largeSize) << "The page size should be read from the hidden page.";
+        for (unsigned i = 0; i < numPages; i++) {
+            generateData(inBuffer, largeSize, i + 7, i);
+            ASSERT_EQ(largeHandle.readPage(i, outBuffer), success) << "Reading a page should succeed.";
+            ASSERT_EQ(memcmp(inBuffer, outBuffer, largeSize), 0)
+                                        << "Checking the integrity of page " << i << " should succeed.";
+            generateData(inBuffer, PAGE_SIZE, i + 8, i);
+            ASSERT_EQ(fileHandle.readPage(i, outBuffer), success) << "Reading a page should succeed.";
+            ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0)
+                                        << "Checking the integrity of page " << i << " should succeed.";
+        }
+        ASSERT_EQ(pfm.closeFile(largeHandle), success) << "Closing the file should succeed.";
+
+        // Hidden page, space map page, checksum page and the data pages, all of the file's page size
+        ASSERT_EQ(getFileSize(largeFileName), (numPages + 3) * largeSize) << "File size does not match.";
+        ASSERT_EQ(pfm.destroyFile(largeFileName), success) << "Destroying the file should succeed.";
+        ASSERT_EQ(PeterDB::BufferManager::instance().setNumFrames(DEFAULT_BUFFER_FRAMES), success)
+                                    << "Resizing the pool should succeed.";
+
+    }
+
+    TEST_F (PFM_Page_Test, corrupted_page_fails_its_checksum) {
+        // Functions Tested:
+        // 1. CRC32C of a known string
+        // 2. Flip a byte of a data page on disk; reading the page fails until verification is off
+        // 3. A single scrubber pass reports the page
+
+        ASSERT_EQ(PeterDB::crc32c("123456789", 9), 0xE3069283) << "The CRC32C check value should match.";
+
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        for (unsigned i = 0; i < 3; i++) {
+            generateData(inBuffer, PAGE_SIZE, i + 1);
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+
+        // Data page 1 follows the hidden page, the space map page, the checksum page and data page 0
+        PeterDB::PageNum corruptPage = 4;
+        FILE *file = fopen(fileName.c_str(), "rb+");
+        ASSERT_NE(file, nullptr);
+        fseek(file, corruptPage * PAGE_SIZE + 100, SEEK_SET);
+        int byte = fgetc(file);
+        fseek(file, corruptPage * PAGE_SIZE + 100, SEEK_SET);
+        fputc(byte ^ 0x01, file);
+        fclose(file);
+
+        fileHandle = PeterDB::FileHandle();
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the file should succeed.";
+        ASSERT_EQ(fileHandle.readPage(0, outBuffer), success) << "An intact page should be read.";
+        ASSERT_NE(fileHandle.readPage(1, outBuffer), success) << "A corrupted page should not be read.";
+        ASSERT_EQ(fileHandle.checksumFailures, 1) << "The mismatch should be counted.";
+        fileHandle.setChecksumVerification(false);
+        ASSERT_EQ(fileHandle.readPage(1, outBuffer), success) << "Without verification the page should be read.";
+        generateData(inBuffer, PAGE_SIZE, 2);
+        ASSERT_NE(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0) << "The page should hold the corrupted byte.";
+
+        PeterDB::PageScrubber scrubber;
+        PeterDB::ScrubStats stats;
+        ASSERT_EQ(scrubber.start(fileName, 10000), success) << "Starting the scrubber should succeed.";
+        ASSERT_EQ(scrubber.wait(), success);
+        scrubber.getStats(stats);
+        ASSERT_EQ(stats.passes, 1) << "The scrubber should make a single pass.";
+        ASSERT_EQ(stats.pagesChecked, 4) << "The space map page and the three data pages should be checked.";
+        ASSERT_EQ(stats.corruptPages.size(), 1) << "Exactly one page should be reported.";
+        ASSERT_EQ(stats.corruptPages[0], corruptPage) << "The corrupted page should be reported.";
+
+    }
+
+    TEST_F (PFM_Page_Test, unclean_shutdown_repairs_lost_checksum_writes) {
+        // Functions Tested:
+        // 1. The first change of a session flags the file unclean on disk; a clean close clears the flag
+        // 2. A crash copy whose page write landed without its checksum write is repaired when it is opened
+        // 3. Once repaired and closed, the copy opens clean
+
+        std::string crashName = fileName + "_crash";
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        for (unsigned i = 0; i < 3; i++) {
+            generateData(inBuffer, PAGE_SIZE, i + 1);
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+        ASSERT_TRUE(fileHandle.unclean) << "Appending should flag the file unclean.";
+        reopenFile();
+        ASSERT_FALSE(fileHandle.unclean) << "A clean close should clear the flag.";
+        ASSERT_EQ(fileHandle.checksumRepairs, 0) << "A clean file should need no repair.";
+
+        generateData(inBuffer, PAGE_SIZE, 10);
+        ASSERT_EQ(fileHandle.writePage(1, inBuffer), success) << "Writing a page should succeed.";
+        ASSERT_EQ(fileHandle.sync(), success) << "Syncing should succeed.";
+
+        // Copy the file as a crash would leave it, then change data page 1 in the copy without its checksum,
+        // like a page write whose checksum write never reached the disk
+        FILE *in = fopen(fileName.c_str(), "rb");
+        FILE *out = fopen(crashName.c_str(), "wb");
+        ASSERT_NE(in, nullptr);
+        ASSERT_NE(out, nullptr);
+        char chunk[4096];
+        size_t size;
+        while ((size = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+            fwrite(chunk, 1, size, out);
+        }
+        fclose(in);
+        generateData(inBuffer, PAGE_SIZE, 20);
+        fseek(out, 4 * PAGE_SIZE, SEEK_SET);
+        fwrite(inBuffer, 1, PAGE_SIZE, out);
+        fclose(out);
+
+        PeterDB::FileHandle crashHandle;
+        ASSERT_EQ(pfm.openFile(crashName, crashHandle), success) << "Opening the crashed file should succeed.";
+        ASSERT_EQ(crashHandle.checksumRepairs, 1) << "The page without its checksum should be repaired.";
+        ASSERT_EQ(crashHandle.readPage(1, outBuffer), success) << "The repaired page should be read.";
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0) << "The page should keep the image that landed.";
+        ASSERT_EQ(crashHandle.checksumFailures, 0) << "No page should fail its checksum.";
+        ASSERT_EQ(pfm.closeFile(crashHandle), success);
+
+        crashHandle = PeterDB::FileHandle();
+        ASSERT_EQ(pfm.openFile(crashName, crashHandle), success) << "Opening the repaired file should succeed.";
+        ASSERT_FALSE(crashHandle.unclean) << "The repaired file should have been marked clean.";
+        ASSERT_EQ(crashHandle.checksumRepairs, 0) << "The repaired file should need no repair.";
+        ASSERT_EQ(pfm.closeFile(crashHandle), success);
+        ASSERT_EQ(pfm.destroyFile(crashName), success);
+
+    }
+
+    TEST_F (PFM_Page_Test, wal_recovers_committed_pages_after_a_crash) {
+        // Functions Tested:
+        // 1. Under DURABILITY_WAL a commit writes the log, not the pages
+        // 2. A copy of the file and its log taken before write-back stands in for a crash
+        // 3. Opening the copy replays the log, ignores a torn record, and removes the log
+        // 4. The recovered handle hands out LSNs after the last one in the log
+
+        unsigned readPageCount = 0, writePageCount = 0, appendPageCount = 0;
+        unsigned updatedReadPageCount = 0, updatedWritePageCount = 0, updatedAppendPageCount = 0;
+        std::string crashName = fileName + "_crash";
+
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        ASSERT_EQ(fileHandle.setDurability(PeterDB::DURABILITY_WAL), success);
+        for (unsigned i = 0; i < 3; i++) {
+            generateData(inBuffer, PAGE_SIZE, i + 1);
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+        ASSERT_EQ(fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount), success);
+        generateData(inBuffer, PAGE_SIZE, 10);
+        ASSERT_EQ(fileHandle.writePage(1, inBuffer), success) << "Writing a page should succeed.";
+        generateData(inBuffer, PAGE_SIZE, 20);
+        ASSERT_EQ(fileHandle.writePage(1, inBuffer), success) << "Writing a page again should succeed.";
+        ASSERT_EQ(fileHandle.commit(), success) << "Committing should succeed.";
+        ASSERT_EQ(fileHandle.collectCounterValues(
+                updatedReadPageCount, updatedWritePageCount, updatedAppendPageCount), success);
+        ASSERT_EQ(writePageCount, updatedWritePageCount) << "The page should stay in the pool.";
+
+        // The log must survive the copy with a torn record at its end
+        auto copy = [](const std::string &from, const std::string &to, bool tearTail) {
+            FILE *in = fopen(from.c_str(), "rb");
+            FILE *out = fopen(to.c_str(), "wb");
+            ASSERT_NE(in, nullptr);
+            ASSERT_NE(out, nullptr);
+            char chunk[4096];
+            size_t size;
+            while ((size = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+                fwrite(chunk, 1, size, out);
+            }
+            if (tearTail) {
+                fwrite(chunk, 1, 100, out);
+            }
+            fclose(in);
+            fclose(out);
+        };
+        copy(fileName, crashName, false);
+        copy(fileName + ".wal", crashName + ".wal", true);
+
+        // Only the log holds the second write; the pages on disk are the appended ones
+        PeterDB::FileHandle crashHandle;
+        ASSERT_EQ(pfm.openFile(crashName, crashHandle), success) << "Opening the crashed file should succeed.";
+        ASSERT_FALSE(fileExists(crashName + ".wal")) << "The log should be removed after the replay.";
+        ASSERT_EQ(crashHandle.nextLsn, fileHandle.nextLsn) << "LSNs should go on after the last one in the log.";
+        ASSERT_EQ(crashHandle.getNumberOfPages(), 3) << "The page count should be restored.";
+        ASSERT_EQ(crashHandle.readPage(1, outBuffer), success) << "Reading a recovered page should succeed.";
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0) << "The last committed image should be replayed.";
+        generateData(inBuffer, PAGE_SIZE, 3);
+        ASSERT_EQ(crashHandle.readPage(2, outBuffer), success) << "Reading a page should succeed.";
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0) << "An appended page should be intact.";
+        ASSERT_EQ(pfm.closeFile(crashHandle), success) << "Closing the crashed file should succeed.";
+        ASSERT_EQ(pfm.destroyFile(crashName), success) << "Destroying the crashed file should succeed.";
+
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+        ASSERT_FALSE(fileExists(fileName + ".wal")) << "A clean close should remove the log.";
+        fileHandle = PeterDB::FileHandle();
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the file should succeed.";
+
+    }
+
+    // Wait up to two seconds for the condition, checking every millisecond
+    template<typename Condition>
+    static bool eventually(Condition condition) {
+        for (unsigned i = 0; i < 2000 && !condition(); i++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return condition();
+    }
+
+    TEST_F (PFM_Page_Test, flusher_writes_dirty_pages_in_the_background) {
+        // Functions Tested:
+        // 1. Dirty pages stay in the pool until the flusher writes them
+        // 2. Past the high-water mark the flusher drains the pool even at a one page per second trickle
+        // 3. Background writes are added to the handle's write counter
+
+        unsigned readPageCount = 0, writePageCount = 0, appendPageCount = 0;
+        unsigned updatedReadPageCount = 0, updatedWritePageCount = 0, updatedAppendPageCount = 0;
+        PeterDB::BufferManager &pool = PeterDB::BufferManager::instance();
+
+        inBuffer = malloc(PAGE_SIZE);
+        generateData(inBuffer, PAGE_SIZE);
+        unsigned numPages = 40;
+        for (unsigned i = 0; i < numPages; i++) {
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+        ASSERT_EQ(fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount), success);
+        for (unsigned i = 0; i < numPages; i++) {
+            ASSERT_EQ(fileHandle.writePage(i, inBuffer), success) << "Writing a page should succeed.";
+        }
+        ASSERT_EQ(pool.getDirtyFrames(), numPages) << "The pages should be dirty in the pool.";
+
+        // 40 of 256 frames is above a 10% high-water mark
+        PeterDB::PageFlusher flusher;
+        PeterDB::FlusherOptions options = {1, 10, 0, 0};
+        ASSERT_EQ(flusher.start(options), success) << "Starting the flusher should succeed.";
+        ASSERT_TRUE(eventually([&] { return pool.getDirtyFrames() == 0; })) << "The pool should be drained.";
+        ASSERT_EQ(flusher.stop(), success);
+        PeterDB::FlusherStats stats;
+        flusher.getStats(stats);
+        ASSERT_EQ(stats.pagesWritten, numPages) << "Every dirty page should be written once.";
+
+        ASSERT_EQ(fileHandle.collectCounterValues(
+                updatedReadPageCount, updatedWritePageCount, updatedAppendPageCount), success);
+        ASSERT_EQ(writePageCount + numPages, updatedWritePageCount) << "The background writes should be counted.";
+
+    }
+
+    TEST_F (PFM_Page_Test, flusher_keeps_changes_made_during_its_writes) {
+        // Functions Tested:
+        // 1. Pages are rewritten over and over while a flusher with no high-water mark writes them back
+        // 2. A change made while its page is being written stays dirty and reaches the file at close
+
+        unsigned numPages = 16, rounds = 200;
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        generateData(inBuffer, PAGE_SIZE);
+        for (unsigned i = 0; i < numPages; i++) {
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+
+        PeterDB::PageFlusher flusher;
+        PeterDB::FlusherOptions options = {100000, 0, 0, 0};
+        ASSERT_EQ(flusher.start(options), success) << "Starting the flusher should succeed.";
+        for (unsigned round = 0; round < rounds; round++) {
+            for (unsigned i = 0; i < numPages; i++) {
+                generateData(inBuffer, PAGE_SIZE, round + i + 1);
+                ASSERT_EQ(fileHandle.writePage(i, inBuffer), success) << "Writing a page should succeed.";
+            }
+        }
+        ASSERT_EQ(flusher.stop(), success);
+        PeterDB::FlusherStats stats;
+        flusher.getStats(stats);
+        ASSERT_GT(stats.pagesWritten, 0) << "The flusher should have written pages meanwhile.";
+
+        reopenFile();
+        for (unsigned i = 0; i < numPages; i++) {
+            generateData(inBuffer, PAGE_SIZE, rounds + i);
+            ASSERT_EQ(fileHandle.readPage(i, outBuffer), success) << "Reading a page should succeed.";
+            ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0) << "The last change of page " << i << " should be kept.";
+        }
+        ASSERT_EQ(fileHandle.checksumFailures, 0) << "No page should fail its checksum.";
+
+    }
+
+    TEST_F (PFM_Page_Test, flush_sweep_wraps_around_the_dirty_pages) {
+        // Functions Tested:
+        // 1. A flush round that starts above the lowest dirty page carries on from the lowest one
+        // 2. Pages written and dirtied again behind the sweep are still written in the same round
+
+        unsigned numPages = 8, written = 0;
+        PeterDB::BufferManager &pool = PeterDB::BufferManager::instance();
+        inBuffer = malloc(PAGE_SIZE);
+        generateData(inBuffer, PAGE_SIZE);
+        for (unsigned i = 0; i < numPages; i++) {
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+        for (unsigned i = 0; i < numPages; i++) {
+            ASSERT_EQ(fileHandle.writePage(i, inBuffer), success) << "Writing a page should succeed.";
+        }
+        ASSERT_EQ(pool.flushDirtyFrames(numPages / 2, written, true), success);
+        ASSERT_EQ(written, numPages / 2) << "Half of the pages should be written.";
+
+        // Dirty every page again, so half of them lie behind the sweep
+        for (unsigned i = 0; i < numPages; i++) {
+            ASSERT_EQ(fileHandle.writePage(i, inBuffer), success) << "Writing a page should succeed.";
+        }
+        ASSERT_EQ(pool.flushDirtyFrames(numPages, written, true), success);
+        ASSERT_EQ(written, numPages) << "Every dirty page should be written in one round.";
+        ASSERT_EQ(pool.getDirtyFrames(), 0) << "The pool should be clean.";
+
+    }
+
+    TEST_F (PFM_Page_Test, fuzzy_checkpoint_lets_commit_drop_log_records) {
+        // Functions Tested:
+        // 1. A flusher checkpoint covers every change logged before it
+        // 2. A commit past the log limit keeps only the newer records and writes no page itself
+        // 3. The shortened log still recovers a crash copy
+
+        unsigned readPageCount = 0, writePageCount = 0, appendPageCount = 0;
+        unsigned updatedReadPageCount = 0, updatedWritePageCount = 0, updatedAppendPageCount = 0;
+        std::string crashName = fileName + "_crash";
+        size_t recordSize = 24 + PAGE_SIZE;
+
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        ASSERT_EQ(fileHandle.setDurability(PeterDB::DURABILITY_WAL), success);
+        for (unsigned i = 0; i < 3; i++) {
+            generateData(inBuffer, PAGE_SIZE, i + 1);
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+        generateData(inBuffer, PAGE_SIZE, 10);
+        ASSERT_EQ(fileHandle.writePage(1, inBuffer), success) << "Writing a page should succeed.";
+        ASSERT_EQ(fileHandle.commit(), success) << "Committing should succeed.";
+
+        PeterDB::PageFlusher flusher;
+        PeterDB::FlusherOptions options = {1000, 100, 0, 5};
+        PeterDB::FlusherStats stats;
+        ASSERT_EQ(flusher.start(options), success) << "Starting the flusher should succeed.";
+        ASSERT_TRUE(eventually([&] {
+            flusher.getStats(stats);
+            return stats.checkpoints > 0;
+        })) << "The flusher should take a checkpoint.";
+        ASSERT_EQ(flusher.stop(), success);
+
+        // Five records in the log: three appends and two writes, of which only the last is not covered
+        ASSERT_EQ(fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount), success);
+        fileHandle.setLogLimit(3 * recordSize);
+        generateData(inBuffer, PAGE_SIZE, 20);
+        ASSERT_EQ(fileHandle.writePage(2, inBuffer), success) << "Writing a page should succeed.";
+        ASSERT_EQ(fileHandle.commit(), success) << "Committing should succeed.";
+        struct stat logStat;
+        ASSERT_EQ(stat((fileName + ".wal").c_str(), &logStat), 0);
+        ASSERT_EQ(logStat.st_size, recordSize) << "Only the record after the checkpoint should be kept.";
+        ASSERT_EQ(fileHandle.collectCounterValues(
+                updatedReadPageCount, updatedWritePageCount, updatedAppendPageCount), success);
+        ASSERT_EQ(writePageCount, updatedWritePageCount) << "The commit should not write pages back.";
+
+        // Copy the file and the log as a crash would leave them, then recover the copy
+        for (const std::string &suffix : {std::string(), std::string(".wal")}) {
+            FILE *in = fopen((fileName + suffix).c_str(), "rb");
+            FILE *out = fopen((crashName + suffix).c_str(), "wb");
+            ASSERT_NE(in, nullptr);
+            ASSERT_NE(out, nullptr);
+            char chunk[4096];
+            size_t size;
+            while ((size = fread(chunk, 1, sizeof(chunk), in)) > 0) {
+                fwrite(chunk, 1, size, out);
+            }
+            fclose(in);
+            fclose(out);
+        }
+        PeterDB::FileHandle crashHandle;
+        ASSERT_EQ(pfm.openFile(crashName, crashHandle), success) << "Opening the crashed file should succeed.";
+        ASSERT_EQ(crashHandle.getNumberOfPages(), 3) << "The page count should survive the shorter log.";
+        ASSERT_EQ(crashHandle.readPage(2, outBuffer), success);
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0) << "The kept record should be replayed.";
+        generateData(inBuffer, PAGE_SIZE, 10);
+        ASSERT_EQ(crashHandle.readPage(1, outBuffer), success);
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0) << "The checkpointed page should be on disk.";
+        ASSERT_EQ(pfm.closeFile(crashHandle), success);
+        ASSERT_EQ(pfm.destroyFile(crashName), success);
+
+    }
+
+    TEST_F (PFM_Page_Test, sequential_reads_trigger_read_ahead) {
+        // Functions Tested:
+        // 1. Reading the pages of a cold file in order asks for the pages ahead, in growing windows
+        // 2. Scattered reads ask for nothing
+        // 3. setReadAhead(0) turns read-ahead off
+
+        unsigned numPages = 64;
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        generateData(inBuffer, PAGE_SIZE);
+        for (unsigned i = 0; i < numPages; i++) {
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+
+        // Closing the only handle takes the file's pages out of the pool
+        reopenFile();
+        for (unsigned i = 0; i < numPages; i++) {
+            ASSERT_EQ(fileHandle.readPage(i, outBuffer), success) << "Reading a page should succeed.";
+        }
+        ASSERT_GE(fileHandle.pagesReadAhead, numPages - 3) << "The pages after the first three should be asked for.";
+        ASSERT_LE(fileHandle.pagesReadAhead, numPages + READ_AHEAD_PAGES) << "The window should not run far ahead.";
+
+        reopenFile();
+        for (unsigned i = 0; i < numPages; i++) {
+            ASSERT_EQ(fileHandle.readPage(i * 37 % numPages, outBuffer), success) << "Reading a page should succeed.";
+        }
+        ASSERT_EQ(fileHandle.pagesReadAhead, 0) << "Scattered reads should not read ahead.";
+
+        reopenFile();
+        fileHandle.setReadAhead(0);
+        for (unsigned i = 0; i < numPages; i++) {
+            ASSERT_EQ(fileHandle.readPage(i, outBuffer), success) << "Reading a page should succeed.";
+        }
+        ASSERT_EQ(fileHandle.pagesReadAhead, 0) << "Read-ahead should be off.";
+
+    }
+
+    TEST_F (PFM_Page_Test, io_engines_batch_and_prefetch_pages) {
+        // Functions Tested, with pread/pwrite and with io_uring when the kernel has it:
+        // 1. A batch write and a batch read of physical pages round-trip, checksums included
+        // 2. Prefetched pages are pinned without another physical read
+        // 3. Sequential reads fill the pool ahead of the reads under io_uring, without waiting for the pages
+
+        unsigned numPages = 64;
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        generateData(inBuffer, PAGE_SIZE);
+        for (unsigned i = 0; i < numPages; i++) {
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+
+        for (PeterDB::IOEngine engine : {PeterDB::IO_ENGINE_PREAD, PeterDB::IO_ENGINE_URING}) {
+            reopenFile();
+            ASSERT_EQ(fileHandle.setIOEngine(engine), success) << "Choosing an engine should succeed.";
+            bool uring = fileHandle.getIOEngine() == PeterDB::IO_ENGINE_URING;
+            if (engine == PeterDB::IO_ENGINE_URING && !uring) {
+                std::cout << "io_uring is not available, pread/pwrite is used instead" << std::endl;
+            }
+
+            // Data pages 0-3 are physical pages 3-6, after the hidden, space map and checksum pages
+            std::vector<char> pages(4 * PAGE_SIZE), copies(4 * PAGE_SIZE);
+            std::vector<PeterDB::PageNum> physicalPages = {3, 4, 5, 6};
+            std::vector<char *> buffers, copyBuffers;
+            for (unsigned i = 0; i < 4; i++) {
+                generateData(pages.data() + i * PAGE_SIZE, PAGE_SIZE, i + 1 + engine * 10);
+                buffers.push_back(pages.data() + i * PAGE_SIZE);
+                copyBuffers.push_back(copies.data() + i * PAGE_SIZE);
+            }
+            ASSERT_EQ(fileHandle.writePhysicalPages(physicalPages, buffers), success);
+            ASSERT_EQ(fileHandle.readPhysicalPages(physicalPages, copyBuffers), success)
+                                        << "The pages should match their checksums.";
+            ASSERT_EQ(memcmp(pages.data(), copies.data(), pages.size()), 0) << "The batch should round-trip.";
+
+            unsigned readPageCount = 0, writePageCount = 0, appendPageCount = 0;
+            unsigned updatedReadPageCount = 0, updatedWritePageCount = 0, updatedAppendPageCount = 0;
+            ASSERT_EQ(fileHandle.prefetchPages({10, 11, 12}), success) << "Prefetching should succeed.";
+            ASSERT_EQ(fileHandle.physicalReadsPending(), uring)
+                                        << "Under io_uring the prefetch should return before its pages are collected.";
+            ASSERT_EQ(fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount), success);
+            for (PeterDB::PageNum page : {10, 11, 12}) {
+                ASSERT_EQ(fileHandle.readPage(page, outBuffer), success) << "Reading a page should succeed.";
+                ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0) << "The prefetched page should be intact.";
+            }
+            ASSERT_EQ(fileHandle.collectCounterValues(
+                    updatedReadPageCount, updatedWritePageCount, updatedAppendPageCount), success);
+            ASSERT_EQ(readPageCount, updatedReadPageCount) << "Prefetched pages should be pool hits.";
+
+            // Under io_uring read-ahead lands in the pool, so most sequential reads are hits
+            reopenFile();
+            ASSERT_EQ(fileHandle.setIOEngine(engine), success);
+            ASSERT_EQ(fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount), success);
+            for (unsigned i = 4; i < numPages; i++) {
+                ASSERT_EQ(fileHandle.readPage(i, outBuffer), success) << "Reading a page should succeed.";
+                ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0) << "The page should be intact.";
+            }
+            ASSERT_EQ(fileHandle.collectCounterValues(
+                    updatedReadPageCount, updatedWritePageCount, updatedAppendPageCount), success);
+            ASSERT_EQ(updatedReadPageCount - readPageCount, numPages - 4)
+                                        << "Every page should be read from disk exactly once.";
+        }
+
+    }
+
+
+    // Pages of the file that are in the kernel page cache
+    static unsigned residentPages(const std::string &fileName) {
+        struct stat fileStat;
+        stat(fileName.c_str(), &fileStat);
+        size_t pages = (fileStat.st_size + getpagesize() - 1) / getpagesize();
+        int fd = open(fileName.c_str(), O_RDONLY);
+        void *mapping = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        std::vector<unsigned char> residency(pages);
+        unsigned resident = 0;
+        if (mapping != MAP_FAILED && mincore(mapping, fileStat.st_size, residency.data()) == 0) {
+            for (unsigned char page : residency) {
+                resident += page & 1;
+            }
+        }
+        munmap(mapping, fileStat.st_size);
+        close(fd);
+        return resident;
+    }
+
+    TEST_F (PFM_Page_Test, direct_io_round_trips_past_the_page_cache) {
+        // Functions Tested, in IO_DIRECT mode with pread/pwrite and with io_uring when the kernel has it:
+        // 1. Append, write and read pages from buffers that are not aligned
+        // 2. Evictions and read misses of a small pool go past the page cache
+        // 3. The file reads back the same in IO_POSIX mode
+
+        unsigned numPages = 64;
+        std::vector<char> unaligned(PAGE_SIZE + 1);
+        char *pageData = unaligned.data() + 1;
+        outBuffer = malloc(PAGE_SIZE + 1);
+        char *outData = (char *)outBuffer + 1;
+
+        // Start from a file that has left the page cache
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+        int fd = open(fileName.c_str(), O_RDONLY);
+        ASSERT_EQ(posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED), 0);
+        close(fd);
+        fileHandle = PeterDB::FileHandle();
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle, PeterDB::IO_DIRECT), success)
+                                    << "Opening the file with O_DIRECT should not fail.";
+        for (unsigned i = 0; i < numPages; i++) {
+            generateData(pageData, PAGE_SIZE, i + 1);
+            ASSERT_EQ(fileHandle.appendPage(pageData), success) << "Appending a page should succeed.";
+        }
+
+        ASSERT_EQ(PeterDB::BufferManager::instance().setNumFrames(8), success);
+        for (PeterDB::IOEngine engine : {PeterDB::IO_ENGINE_PREAD, PeterDB::IO_ENGINE_URING}) {
+            ASSERT_EQ(fileHandle.setIOEngine(engine), success) << "Choosing an engine should succeed.";
+            for (unsigned i = 0; i < numPages; i += 2) {
+                generateData(pageData, PAGE_SIZE, i + 1 + engine * 100);
+                ASSERT_EQ(fileHandle.writePage(i, pageData), success) << "Writing a page should succeed.";
+            }
+            for (unsigned i = 0; i < numPages; i++) {
+                generateData(pageData, PAGE_SIZE, i + 1 + (i % 2 == 0 ? engine * 100 : 0));
+                ASSERT_EQ(fileHandle.readPage(i, outData), success) << "Reading a page should succeed.";
+                ASSERT_EQ(memcmp(pageData, outData, PAGE_SIZE), 0) << "The page should round-trip: " << i;
+            }
+        }
+        ASSERT_EQ(fileHandle.sync(), success);
+        ASSERT_LT(residentPages(fileName), numPages / 4)
+                                    << "Data pages should not be kept in the page cache.";
+        ASSERT_EQ(PeterDB::BufferManager::instance().setNumFrames(DEFAULT_BUFFER_FRAMES), success);
+
+        reopenFile();
+        ASSERT_EQ(fileHandle.ioMode, PeterDB::IO_POSIX);
+        for (unsigned i = 0; i < numPages; i++) {
+            generateData(pageData, PAGE_SIZE, i + 1 + (i % 2 == 0 ? 100 : 0));
+            ASSERT_EQ(fileHandle.readPage(i, outData), success) << "Reading a page should succeed.";
+            ASSERT_EQ(memcmp(pageData, outData, PAGE_SIZE), 0) << "The page should read back in IO_POSIX mode.";
+        }
+        ASSERT_EQ(fileHandle.checksumFailures, 0) << "No page should fail its checksum.";
+
+    }
+
+} // namespace PeterDBTesting
@@ -0,0 +1,271 @@
+#include <chrono>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "src/include/rbfm.h"
+#include "test/utils/rbfm_test_utils.h"
+
+// Benchmarks are disabled by default; run them with --gtest_also_run_disabled_tests
+namespace PeterDBTesting {
+
+    static double elapsedMs(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Fill the file with numRecords employee records, using the bulk insert path
+    static void loadEmployees(PeterDB::RecordBasedFileManager &rbfm, PeterDB::FileHandle &fileHandle,
+                              const std::vector<PeterDB::Attribute> &recordDescriptor,
+                              unsigned char *nullsIndicator, unsigned numRecords) {
+        const unsigned chunk = 10000;
+        std::vector<char> buffers(chunk * 100);
+        std::vector<const void *> records;
+        std::vector<PeterDB::RID> rids;
+        for (unsigned i = 0; i < numRecords;) {
+            records.clear();
+            for (unsigned j = 0; j < chunk && i < numRecords; j++, i++) {
+                size_t recordSize;
+                std::string name = "Anteater" + std::to_string(i);
+                RBFM_Test::prepareRecord(4, nullsIndicator, (int) name.length(), name, (int) i % 100, 177.8, (int) i,
+                              buffers.data() + j * 100, recordSize);
+                records.push_back(buffers.data() + j * 100);
+            }
+            ASSERT_EQ(rbfm.insertRecords(fileHandle, recordDescriptor, records, rids), success);
+        }
+    }
+
+    TEST_F(RBFM_Test, DISABLED_bench_scan_batch_vs_row) {
+        // Scan a multi-million row file with getNextRecord() and with getNextBatch()
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+
+        unsigned numRecords = 2000000;
+        loadEmployees(rbfm, fileHandle, recordDescriptor, nullsIndicator, numRecords);
+
+        int maxAge = 50;
+        std::vector<std::string> attributeNames = {"EmpName", "Salary"};
+        PeterDB::RBFM_ScanIterator rbfmScanIterator;
+        PeterDB::RID rid;
+        outBuffer = malloc(100);
+
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "Age", PeterDB::LT_OP, &maxAge, attributeNames,
+                            rbfmScanIterator), success);
+        auto start = std::chrono::steady_clock::now();
+        unsigned rowCount = 0;
+        while (rbfmScanIterator.getNextRecord(rid, outBuffer) != RBFM_EOF) {
+            rowCount++;
+        }
+        double rowMs = elapsedMs(start);
+        ASSERT_EQ(rbfmScanIterator.close(), success);
+
+        unsigned bufferSize = 256 * 1024;
+        std::vector<char> batch(bufferSize);
+        std::vector<PeterDB::RID> rids;
+        std::vector<unsigned> offsets;
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "Age", PeterDB::LT_OP, &maxAge, attributeNames,
+                            rbfmScanIterator), success);
+        start = std::chrono::steady_clock::now();
+        unsigned batchCount = 0;
+        while (rbfmScanIterator.getNextBatch(rids, batch.data(), 4096, bufferSize, offsets) != RBFM_EOF) {
+            batchCount += rids.size();
+        }
+        double batchMs = elapsedMs(start);
+        ASSERT_EQ(rbfmScanIterator.close(), success);
+
+        ASSERT_EQ(rowCount, batchCount) << "Both scans should return the same records.";
+        std::cout << "[ BENCH    ] " << numRecords << " records, " << rowCount << " matches: getNextRecord "
+                  << rowMs << " ms, getNextBatch " << batchMs << " ms" << std::endl;
+
+    }
+
+    TEST_F(RBFM_Test, DISABLED_bench_scan_by_page_size) {
+        // Load the same records into files of every page size and time a full scan of each, cold and warm
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success);
+
+        unsigned numRecords = 1000000;
+        std::vector<std::string> attributeNames = {"EmpName", "Salary"};
+        unsigned bufferSize = 256 * 1024;
+        std::vector<char> batch(bufferSize);
+        std::vector<PeterDB::RID> rids;
+        std::vector<unsigned> offsets;
+        for (unsigned pageSize = MIN_PAGE_SIZE; pageSize <= MAX_PAGE_SIZE; pageSize *= 2) {
+            ASSERT_EQ(rbfm.destroyFile(fileName), success);
+            ASSERT_EQ(rbfm.createFile(fileName, PeterDB::LAYOUT_NSM, pageSize), success);
+            ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success);
+            loadEmployees(rbfm, fileHandle, recordDescriptor, nullsIndicator, numRecords);
+            unsigned numPages = fileHandle.getNumberOfPages();
+            ASSERT_EQ(rbfm.closeFile(fileHandle), success);
+
+            double scanMs[2];
+            for (double &ms : scanMs) {
+                ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success);
+                PeterDB::RBFM_ScanIterator rbfmScanIterator;
+                ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "", PeterDB::NO_OP, nullptr, attributeNames,
+                                    rbfmScanIterator), success);
+                auto start = std::chrono::steady_clock::now();
+                unsigned rowCount = 0;
+                while (rbfmScanIterator.getNextBatch(rids, batch.data(), 4096, bufferSize, offsets) != RBFM_EOF) {
+                    rowCount += rids.size();
+                }
+                ms = elapsedMs(start);
+                ASSERT_EQ(rbfmScanIterator.close(), success);
+                ASSERT_EQ(rowCount, numRecords) << "The scan should return every record.";
+                ASSERT_EQ(rbfm.closeFile(fileHandle), success);
+            }
+
+            std::cout << "[ BENCH    ] page size " << pageSize << ": " << numPages << " pages, scan "
+                      << numRecords / scanMs[0] << " records/ms cold, " << numRecords / scanMs[1]
+                      << " records/ms warm" << std::endl;
+        }
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success);
+
+    }
+
+    TEST_F(RBFM_Test, DISABLED_bench_wal_commits) {
+        // Durable single-record inserts: every page forced in place, versus one log write per commit
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+        char record[100];
+        PeterDB::RID rid;
+
+        unsigned numRecords = 5000;
+        struct Mode {
+            const char *name;
+            PeterDB::DurabilityMode durability;
+            unsigned commitEvery; // 0 = the durability mode alone
+        } modes[] = {{"per-write", PeterDB::DURABILITY_PER_WRITE, 0},
+                     {"wal, commit every insert", PeterDB::DURABILITY_WAL, 1},
+                     {"wal, commit every 100 inserts", PeterDB::DURABILITY_WAL, 100}};
+        for (const Mode &mode : modes) {
+            ASSERT_EQ(rbfm.closeFile(fileHandle), success);
+            ASSERT_EQ(rbfm.destroyFile(fileName), success);
+            ASSERT_EQ(rbfm.createFile(fileName), success);
+            ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success);
+            ASSERT_EQ(fileHandle.setDurability(mode.durability), success);
+
+            auto start = std::chrono::steady_clock::now();
+            for (unsigned i = 0; i < numRecords; i++) {
+                size_t recordSize;
+                std::string name = "Anteater" + std::to_string(i);
+                prepareRecord(4, nullsIndicator, (int) name.length(), name, (int) i % 100, 177.8, (int) i, record,
+                              recordSize);
+                ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, record, rid), success);
+                if (mode.commitEvery != 0 && (i + 1) % mode.commitEvery == 0) {
+                    ASSERT_EQ(fileHandle.commit(), success);
+                }
+            }
+            ASSERT_EQ(fileHandle.commit(), success);
+            std::cout << "[ BENCH    ] " << mode.name << ": " << numRecords / elapsedMs(start) << " inserts/ms"
+                      << std::endl;
+        }
+
+    }
+
+    TEST_F(RBFM_Test, DISABLED_bench_background_flusher) {
+        // Logged inserts into a small pool, committing every 100 inserts with an 8 MB log limit. Without a
+        // flusher, evictions write pages in the foreground and a full log makes the commit write back every
+        // dirty page; with one, pages are cleaned in the background and the commit drops checkpointed records.
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+        char record[100];
+        PeterDB::RID rid;
+
+        unsigned numRecords = 300000;
+        ASSERT_EQ(PeterDB::BufferManager::instance().setNumFrames(64), success);
+        for (bool withFlusher : {false, true}) {
+            ASSERT_EQ(rbfm.closeFile(fileHandle), success);
+            ASSERT_EQ(rbfm.destroyFile(fileName), success);
+            ASSERT_EQ(rbfm.createFile(fileName), success);
+            ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success);
+            ASSERT_EQ(fileHandle.setDurability(PeterDB::DURABILITY_WAL), success);
+            fileHandle.setLogLimit(8u << 20);
+
+            PeterDB::PageFlusher flusher;
+            PeterDB::FlusherOptions options = {20000, 50, 25, 50};
+            if (withFlusher) {
+                ASSERT_EQ(flusher.start(options), success);
+            }
+            double slowestCommitMs = 0;
+            auto start = std::chrono::steady_clock::now();
+            for (unsigned i = 0; i < numRecords; i++) {
+                size_t recordSize;
+                std::string name = "Anteater" + std::to_string(i);
+                prepareRecord(4, nullsIndicator, (int) name.length(), name, (int) i % 100, 177.8, (int) i, record,
+                              recordSize);
+                ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, record, rid), success);
+                if ((i + 1) % 100 == 0) {
+                    auto commitStart = std::chrono::steady_clock::now();
+                    ASSERT_EQ(fileHandle.commit(), success);
+                    slowestCommitMs = std::max(slowestCommitMs, elapsedMs(commitStart));
+                }
+            }
+            double ms = elapsedMs(start);
+            ASSERT_EQ(flusher.stop(), success);
+            PeterDB::FlusherStats stats;
+            flusher.getStats(stats);
+            std::cout << "[ BENCH    ] " << (withFlusher ? "with" : "without") << " flusher: "
+                      << numRecords / ms << " inserts/ms, slowest commit " << slowestCommitMs << " ms, "
+                      << stats.pagesWritten << " pages written in the background, " << stats.checkpoints
+                      << " checkpoints" << std::endl;
+        }
+        ASSERT_EQ(PeterDB::BufferManager::instance().setNumFrames(DEFAULT_BUFFER_FRAMES), success);
+
+    }
+
+    TEST_F(RBFM_Test, DISABLED_bench_cold_scan_read_ahead) {
+        // Full scan of a file dropped from the kernel page cache, with and without sequential read-ahead
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+        unsigned numRecords = 1000000;
+        loadEmployees(rbfm, fileHandle, recordDescriptor, nullsIndicator, numRecords);
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success);
+
+        std::vector<std::string> attributeNames = {"EmpName", "Salary"};
+        unsigned bufferSize = 256 * 1024;
+        std::vector<char> batch(bufferSize);
+        std::vector<PeterDB::RID> rids;
+        std::vector<unsigned> offsets;
+        for (unsigned readAhead : {0u, (unsigned) READ_AHEAD_PAGES}) {
+            int fd = open(fileName.c_str(), O_RDONLY);
+            ASSERT_GE(fd, 0);
+            ASSERT_EQ(fdatasync(fd), 0);
+            ASSERT_EQ(posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED), 0);
+            struct stat fileStat;
+            ASSERT_EQ(fstat(fd, &fileStat), 0);
+            close(fd);
+
+            ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success);
+            fileHandle.setReadAhead(readAhead);
+            PeterDB::RBFM_ScanIterator rbfmScanIterator;
+            ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "", PeterDB::NO_OP, nullptr, attributeNames,
+                                rbfmScanIterator), success);
+            auto start = std::chrono::steady_clock::now();
+            unsigned rowCount = 0;
+            while (rbfmScanIterator.getNextBatch(rids, batch.data(), 4096, bufferSize, offsets) != RBFM_EOF) {
+                rowCount += rids.size();
+            }
+            double ms = elapsedMs(start);
+            ASSERT_EQ(rbfmScanIterator.close(), success);
+            ASSERT_EQ(rowCount, numRecords) << "The scan should return every record.";
+            std::cout << "[ BENCH    ] read-ahead " << readAhead << " pages: " << fileStat.st_size / 1024.0 / ms
+                      << " MB/s, " << fileHandle.pagesReadAhead << " pages read ahead" << std::endl;
+            ASSERT_EQ(rbfm.closeFile(fileHandle), success);
+        }
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success);
+
+    }
+
+} // namespace PeterDBTesting
@@ -0,0 +1,1187 @@
+#include "src/include/rbfm.h"
+#include "test/utils/rbfm_test_utils.h"
+#include <atomic>
+#include <new>
+
+// Count every operator new of the test binary; the record manager itself does not call malloc
+static std::atomic<unsigned long> heapAllocations(0);
+
+void *operator new(std::size_t size) {
+    heapAllocations++;
+    void *memory = malloc(size == 0 ? 1 : size);
+    if (memory == nullptr)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void operator delete(void *memory) noexcept {
+    free(memory);
+}
+
+namespace PeterDBTesting {
+
+    // Fill the buffer with a record of a single VarChar field of the given length
+    static void prepareVarCharRecord(int length, char fill, void *buffer) {
+        memset(buffer, 0, 1);
+        memcpy((char *) buffer + 1, &length, sizeof(int));
+        memset((char *) buffer + 1 + sizeof(int), fill, length);
+    }
+
+    TEST_F(RBFM_Test, free_space_map_reuses_pages_with_room) {
+        // Functions tested
+        // 1. Insert records that leave room at the end of their pages
+        // 2. Insert a small record, which has to go to an existing page instead of a new one
+        // 3. Read Record
+
+        std::vector<PeterDB::Attribute> recordDescriptor = {{"Text", PeterDB::TypeVarChar, 3500}};
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+
+        PeterDB::RID rid;
+        for (int i = 0; i < 3; i++) {
+            prepareVarCharRecord(3000, 'a' + i, inBuffer);
+            ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                        << "Inserting a record should succeed.";
+            ASSERT_EQ(rid.pageNum, i) << "Every large record should start a new page.";
+        }
+
+        unsigned pageCount = fileHandle.getNumberOfPages();
+        prepareVarCharRecord(500, 'z', inBuffer);
+        ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                    << "Inserting a record should succeed.";
+        ASSERT_EQ(fileHandle.getNumberOfPages(), pageCount) << "The small record should fit on an existing page.";
+
+        ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rid, outBuffer), success)
+                                    << "Reading a record should succeed.";
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, 1 + sizeof(int) + 500), 0) << "Returned Data should be the same";
+
+        // Nothing has room for another large record
+        prepareVarCharRecord(3000, 'y', inBuffer);
+        ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                    << "Inserting a record should succeed.";
+        ASSERT_EQ(rid.pageNum, pageCount) << "The large record should go to a new page.";
+
+    }
+
+    TEST_F(RBFM_Test, bulk_insert_writes_each_page_once) {
+        // Functions tested
+        // 1. Insert Records in one batch
+        // 2. Check that the pages were only appended, never rewritten
+        // 3. Read every Record back
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+
+        unsigned numRecords = 2000;
+        std::vector<void *> buffers;
+        std::vector<const void *> records;
+        for (unsigned i = 0; i < numRecords; i++) {
+            size_t recordSize;
+            void *buffer = malloc(100);
+            std::string name = "Anteater" + std::to_string(i);
+            prepareRecord((int) recordDescriptor.size(), nullsIndicator, (int) name.length(), name, (int) i, 177.8,
+                          (int) i * 10, buffer, recordSize);
+            buffers.push_back(buffer);
+            records.push_back(buffer);
+        }
+
+        unsigned readPageCount = 0, writePageCount = 0, appendPageCount = 0;
+        ASSERT_EQ(fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount), success);
+
+        std::vector<PeterDB::RID> bulkRids;
+        ASSERT_EQ(rbfm.insertRecords(fileHandle, recordDescriptor, records, bulkRids), success)
+                                    << "Inserting a batch of records should succeed.";
+        ASSERT_EQ(bulkRids.size(), numRecords) << "Every record should get a RID.";
+
+        unsigned updatedReadPageCount = 0, updatedWritePageCount = 0, updatedAppendPageCount = 0;
+        ASSERT_EQ(fileHandle.collectCounterValues(
+                updatedReadPageCount, updatedWritePageCount, updatedAppendPageCount), success);
+        ASSERT_EQ(updatedAppendPageCount - appendPageCount, fileHandle.getNumberOfPages())
+                                    << "Each page should have been appended once.";
+        ASSERT_GT(fileHandle.getNumberOfPages(), 1) << "The batch should span several pages.";
+
+        outBuffer = malloc(100);
+        for (unsigned i = 0; i < numRecords; i++) {
+            size_t recordSize;
+            std::string name = "Anteater" + std::to_string(i);
+            prepareRecord((int) recordDescriptor.size(), nullsIndicator, (int) name.length(), name, (int) i, 177.8,
+                          (int) i * 10, buffers[i], recordSize);
+            ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, bulkRids[i], outBuffer), success)
+                                        << "Reading a record should succeed.";
+            ASSERT_EQ(memcmp(buffers[i], outBuffer, recordSize), 0) << "Returned Data should be the same";
+        }
+
+        for (void *buffer : buffers) {
+            free(buffer);
+        }
+
+    }
+
+    TEST_F(RBFM_Test, scan_filters_and_projects_stored_records) {
+        // Functions tested
+        // 1. Insert Records
+        // 2. Scan with a condition and a projection
+        // 3. Scan with a VarChar condition
+        // 4. Scan without a condition
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+        inBuffer = malloc(100);
+        outBuffer = malloc(100);
+
+        PeterDB::RID rid;
+        unsigned numRecords = 1000;
+        std::vector<PeterDB::RID> insertedRids;
+        for (unsigned i = 0; i < numRecords; i++) {
+            size_t recordSize;
+            std::string name = "Anteater" + std::to_string(i);
+            prepareRecord((int) recordDescriptor.size(), nullsIndicator, (int) name.length(), name, (int) i, 177.8,
+                          (int) i * 10, inBuffer, recordSize);
+            ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                        << "Inserting a record should succeed.";
+            insertedRids.push_back(rid);
+        }
+
+        // Age >= 600, projected as (Salary, EmpName)
+        int minAge = 600;
+        std::vector<std::string> attributeNames = {"Salary", "EmpName"};
+        PeterDB::RBFM_ScanIterator rbfmScanIterator;
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "Age", PeterDB::GE_OP, &minAge, attributeNames,
+                            rbfmScanIterator), success) << "Opening a scan should succeed.";
+
+        unsigned count = 0;
+        while (rbfmScanIterator.getNextRecord(rid, outBuffer) != RBFM_EOF) {
+            unsigned i = minAge + count;
+            ASSERT_EQ(rid.pageNum, insertedRids[i].pageNum) << "Records should come back in storage order.";
+            ASSERT_EQ(rid.slotNum, insertedRids[i].slotNum) << "Records should come back in storage order.";
+            ASSERT_EQ(*(unsigned char *) outBuffer, 0) << "No projected field should be null.";
+
+            int salary;
+            memcpy(&salary, (char *) outBuffer + 1, sizeof(int));
+            ASSERT_EQ(salary, (int) i * 10) << "The first projected field should be the salary.";
+
+            std::string name = "Anteater" + std::to_string(i);
+            int nameLength;
+            memcpy(&nameLength, (char *) outBuffer + 1 + sizeof(int), sizeof(int));
+            ASSERT_EQ(nameLength, (int) name.length()) << "The second projected field should be the name.";
+            ASSERT_EQ(memcmp((char *) outBuffer + 1 + 2 * sizeof(int), name.c_str(), nameLength), 0)
+                                        << "The second projected field should be the name.";
+            count++;
+        }
+        ASSERT_EQ(count, numRecords - minAge) << "Every record with a matching age should be returned.";
+        ASSERT_EQ(rbfmScanIterator.close(), success) << "Closing a scan should succeed.";
+
+        // EmpName = "Anteater42"
+        std::string wanted = "Anteater42";
+        int wantedLength = wanted.length();
+        memcpy(inBuffer, &wantedLength, sizeof(int));
+        memcpy((char *) inBuffer + sizeof(int), wanted.c_str(), wantedLength);
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "EmpName", PeterDB::EQ_OP, inBuffer, {"Age"},
+                            rbfmScanIterator), success) << "Opening a scan should succeed.";
+        ASSERT_EQ(rbfmScanIterator.getNextRecord(rid, outBuffer), success) << "One record should match.";
+        int age;
+        memcpy(&age, (char *) outBuffer + 1, sizeof(int));
+        ASSERT_EQ(age, 42) << "The matching record should be returned.";
+        ASSERT_EQ(rbfmScanIterator.getNextRecord(rid, outBuffer), RBFM_EOF) << "Only one record should match.";
+        ASSERT_EQ(rbfmScanIterator.close(), success) << "Closing a scan should succeed.";
+
+        // No condition
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "", PeterDB::NO_OP, nullptr, {"Age"},
+                            rbfmScanIterator), success) << "Opening a scan should succeed.";
+        count = 0;
+        while (rbfmScanIterator.getNextRecord(rid, outBuffer) != RBFM_EOF) {
+            count++;
+        }
+        ASSERT_EQ(count, numRecords) << "Every record should be returned.";
+        ASSERT_EQ(rbfmScanIterator.close(), success) << "Closing a scan should succeed.";
+
+        ASSERT_NE(rbfm.scan(fileHandle, recordDescriptor, "Nope", PeterDB::EQ_OP, &minAge, {"Age"},
+                            rbfmScanIterator), success) << "Scanning on an unknown attribute should not succeed.";
+
+    }
+
+    TEST_F(RBFM_Test, scan_batch_matches_row_at_a_time_scan) {
+        // Functions tested
+        // 1. Insert Records
+        // 2. Scan them one by one and in batches
+        // 3. Compare the two results
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+        inBuffer = malloc(100);
+        outBuffer = malloc(100);
+
+        PeterDB::RID rid;
+        unsigned numRecords = 1500;
+        for (unsigned i = 0; i < numRecords; i++) {
+            size_t recordSize;
+            std::string name = "Anteater" + std::to_string(i);
+            prepareRecord((int) recordDescriptor.size(), nullsIndicator, (int) name.length(), name, (int) i % 100,
+                          177.8, (int) i * 10, inBuffer, recordSize);
+            ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                        << "Inserting a record should succeed.";
+        }
+
+        int maxAge = 30;
+        std::vector<std::string> attributeNames = {"EmpName", "Salary"};
+        PeterDB::RBFM_ScanIterator rbfmScanIterator;
+
+        std::vector<PeterDB::RID> rowRids;
+        std::vector<std::string> rowRecords;
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "Age", PeterDB::LT_OP, &maxAge, attributeNames,
+                            rbfmScanIterator), success) << "Opening a scan should succeed.";
+        while (rbfmScanIterator.getNextRecord(rid, outBuffer) != RBFM_EOF) {
+            int nameLength;
+            memcpy(&nameLength, (char *) outBuffer + 1, sizeof(int));
+            rowRids.push_back(rid);
+            rowRecords.emplace_back((char *) outBuffer, 1 + 2 * sizeof(int) + nameLength);
+        }
+        ASSERT_EQ(rbfmScanIterator.close(), success) << "Closing a scan should succeed.";
+        ASSERT_EQ(rowRids.size(), numRecords * maxAge / 100) << "Every matching record should be returned.";
+
+        // Small batches, so that batches end both inside a page and across pages
+        unsigned bufferSize = 4096;
+        std::vector<char> batch(bufferSize);
+        std::vector<PeterDB::RID> batchRids;
+        std::vector<unsigned> offsets;
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "Age", PeterDB::LT_OP, &maxAge, attributeNames,
+                            rbfmScanIterator), success) << "Opening a scan should succeed.";
+        ASSERT_NE(rbfmScanIterator.getNextBatch(batchRids, batch.data(), 16, 10, offsets), success)
+                                    << "A buffer too small for a record should be rejected.";
+
+        unsigned count = 0;
+        while (rbfmScanIterator.getNextBatch(batchRids, batch.data(), 37, bufferSize, offsets) != RBFM_EOF) {
+            ASSERT_LE(batchRids.size(), 37) << "A batch should not exceed the row limit.";
+            ASSERT_EQ(offsets.size(), batchRids.size() + 1) << "Every record should have an offset.";
+            ASSERT_LE(offsets.back(), bufferSize) << "A batch should fit in the buffer.";
+            for (unsigned i = 0; i < batchRids.size(); i++, count++) {
+                ASSERT_EQ(batchRids[i].pageNum, rowRids[count].pageNum) << "Batches should return the same rids.";
+                ASSERT_EQ(batchRids[i].slotNum, rowRids[count].slotNum) << "Batches should return the same rids.";
+                ASSERT_EQ(std::string(batch.data() + offsets[i], offsets[i + 1] - offsets[i]), rowRecords[count])
+                                            << "Batches should return the same records.";
+            }
+        }
+        ASSERT_EQ(count, rowRids.size()) << "Batches should return every matching record.";
+        ASSERT_EQ(rbfmScanIterator.close(), success) << "Closing a scan should succeed.";
+
+    }
+
+    TEST_F(RBFM_Test, read_attributes_through_offset_directory) {
+        // Functions tested
+        // 1. Insert a Record with a null field
+        // 2. Read single attributes
+        // 3. Read several attributes at once, out of order
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+        nullsIndicator[0] = 0x40; // Age is null
+        inBuffer = malloc(100);
+        outBuffer = malloc(100);
+
+        PeterDB::RID rid;
+        size_t recordSize;
+        std::string name = "Anteater";
+        prepareRecord((int) recordDescriptor.size(), nullsIndicator, (int) name.length(), name, 24, 177.8, 9000,
+                      inBuffer, recordSize);
+        ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                    << "Inserting a record should succeed.";
+
+        ASSERT_EQ(rbfm.readAttribute(fileHandle, recordDescriptor, rid, "Salary", outBuffer), success)
+                                    << "Reading an attribute should succeed.";
+        ASSERT_EQ(*(unsigned char *) outBuffer, 0) << "Salary should not be null.";
+        ASSERT_EQ(*(int *) ((char *) outBuffer + 1), 9000) << "The returned salary should match.";
+
+        ASSERT_EQ(rbfm.readAttribute(fileHandle, recordDescriptor, rid, "Age", outBuffer), success)
+                                    << "Reading an attribute should succeed.";
+        ASSERT_EQ(*(unsigned char *) outBuffer, 0x80) << "Age should be null.";
+
+        ASSERT_EQ(rbfm.readAttribute(fileHandle, recordDescriptor, rid, "EmpName", outBuffer), success)
+                                    << "Reading an attribute should succeed.";
+        ASSERT_EQ(*(int *) ((char *) outBuffer + 1), (int) name.length()) << "The returned name should match.";
+        ASSERT_EQ(memcmp((char *) outBuffer + 1 + sizeof(int), name.c_str(), name.length()), 0)
+                                    << "The returned name should match.";
+
+        ASSERT_NE(rbfm.readAttribute(fileHandle, recordDescriptor, rid, "Nope", outBuffer), success)
+                                    << "Reading an unknown attribute should not succeed.";
+
+        // (Height, Age, Salary): [null indicator 0x40][height][salary]
+        ASSERT_EQ(rbfm.readAttributes(fileHandle, recordDescriptor, rid, {"Height", "Age", "Salary"}, outBuffer),
+                  success) << "Reading several attributes should succeed.";
+        ASSERT_EQ(*(unsigned char *) outBuffer, 0x40) << "Only the second requested attribute should be null.";
+        ASSERT_FLOAT_EQ(*(float *) ((char *) outBuffer + 1), 177.8) << "The returned height should match.";
+        ASSERT_EQ(*(int *) ((char *) outBuffer + 1 + sizeof(float)), 9000) << "The returned salary should match.";
+
+    }
+
+    TEST_F(RBFM_Test, record_view_reads_fields_in_place) {
+        // Functions tested
+        // 1. Insert Records
+        // 2. Read a Record through a view
+        // 3. Aggregate over a scan of views
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+        inBuffer = malloc(100);
+
+        PeterDB::RID rid;
+        std::vector<PeterDB::RID> rids;
+        unsigned numRecords = 500;
+        for (unsigned i = 0; i < numRecords; i++) {
+            size_t recordSize;
+            std::string name = "Anteater" + std::to_string(i);
+            nullsIndicator[0] = i % 2 ? 0x20 : 0; // Height is null for odd records
+            prepareRecord((int) recordDescriptor.size(), nullsIndicator, (int) name.length(), name, (int) i, 177.8,
+                          (int) i * 10, inBuffer, recordSize);
+            ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                        << "Inserting a record should succeed.";
+            rids.push_back(rid);
+        }
+
+        {
+            PeterDB::RecordView view;
+            ASSERT_EQ(rbfm.readRecordView(fileHandle, rids[7], view), success) << "Reading a view should succeed.";
+            ASSERT_EQ(view.getNumFields(), recordDescriptor.size()) << "The view should see every field.";
+            unsigned length;
+            const char *chars = view.getVarChar(0, length);
+            ASSERT_EQ(std::string(chars, length), "Anteater7") << "The name should match.";
+            ASSERT_EQ(view.getInt(1), 7) << "The age should match.";
+            ASSERT_TRUE(view.isNull(2)) << "The height should be null.";
+            ASSERT_EQ(view.getInt(3), 70) << "The salary should match.";
+            ASSERT_EQ(view.release(), success) << "Releasing a view should succeed.";
+            ASSERT_FALSE(view.isValid()) << "A released view should not be valid.";
+
+            // The destructor releases the pin
+            ASSERT_EQ(rbfm.readRecordView(fileHandle, rids[8], view), success) << "Reading a view should succeed.";
+            ASSERT_FLOAT_EQ(view.getReal(2), 177.8) << "The height should match.";
+        }
+
+        int minAge = 100;
+        PeterDB::RBFM_ScanIterator rbfmScanIterator;
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "Age", PeterDB::GE_OP, &minAge, {}, rbfmScanIterator),
+                  success) << "Opening a scan should succeed.";
+        PeterDB::RecordView view;
+        long long salarySum = 0;
+        unsigned nullHeights = 0;
+        while (rbfmScanIterator.getNextRecordView(rid, view) != RBFM_EOF) {
+            salarySum += view.getInt(3);
+            nullHeights += view.isNull(2);
+        }
+        ASSERT_EQ(rbfmScanIterator.close(), success) << "Closing a scan should succeed.";
+        ASSERT_EQ(salarySum, 10LL * (numRecords * (numRecords - 1) / 2 - minAge * (minAge - 1) / 2))
+                                    << "The aggregate should match.";
+        ASSERT_EQ(nullHeights, (numRecords - minAge) / 2) << "Half of the heights should be null.";
+
+        // Every pin has been released, so the pool can be resized
+        ASSERT_EQ(PeterDB::BufferManager::instance().setNumFrames(DEFAULT_BUFFER_FRAMES), success)
+                                    << "No page should be left pinned.";
+
+    }
+
+    TEST_F(RBFM_Test, update_moves_records_behind_tombstones) {
+        // Functions tested
+        // 1. Fill a page with records
+        // 2. Grow a record until it has to move, twice
+        // 3. Shrink it, scan, and delete it
+
+        std::vector<PeterDB::Attribute> recordDescriptor = {{"Text", PeterDB::TypeVarChar, 3500}};
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+
+        std::vector<PeterDB::RID> rids;
+        PeterDB::RID rid;
+        for (int i = 0; i < 4; i++) {
+            prepareVarCharRecord(1000, 'a' + i, inBuffer);
+            ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                        << "Inserting a record should succeed.";
+            ASSERT_EQ(rid.pageNum, 0) << "The first four records should share a page.";
+            rids.push_back(rid);
+        }
+
+        // Too large for the full page: the record moves and its RID stays valid
+        prepareVarCharRecord(2000, 'x', inBuffer);
+        ASSERT_EQ(rbfm.updateRecord(fileHandle, recordDescriptor, inBuffer, rids[0]), success)
+                                    << "Updating a record should succeed.";
+        ASSERT_EQ(fileHandle.getNumberOfPages(), 2) << "The record should have moved to a new page.";
+        ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rids[0], outBuffer), success)
+                                    << "Reading a moved record should succeed.";
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, 1 + sizeof(int) + 2000), 0) << "Returned Data should be the same";
+
+        // Fill up the page it moved to
+        prepareVarCharRecord(2000, 'w', inBuffer);
+        PeterDB::RID neighbourRid;
+        ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, neighbourRid), success)
+                                    << "Inserting a record should succeed.";
+        ASSERT_EQ(neighbourRid.pageNum, 1) << "The record should share the page of the moved record.";
+
+        // Too large for its new page as well: it moves again, still one hop from home
+        prepareVarCharRecord(3000, 'y', inBuffer);
+        ASSERT_EQ(rbfm.updateRecord(fileHandle, recordDescriptor, inBuffer, rids[0]), success)
+                                    << "Updating a record should succeed.";
+        ASSERT_EQ(fileHandle.getNumberOfPages(), 3) << "The record should have moved to another new page.";
+        ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rids[0], outBuffer), success)
+                                    << "Reading a moved record should succeed.";
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, 1 + sizeof(int) + 3000), 0) << "Returned Data should be the same";
+
+        // Small enough to be rewritten where it is
+        prepareVarCharRecord(10, 'z', inBuffer);
+        ASSERT_EQ(rbfm.updateRecord(fileHandle, recordDescriptor, inBuffer, rids[0]), success)
+                                    << "Updating a record should succeed.";
+        ASSERT_EQ(rbfm.readAttribute(fileHandle, recordDescriptor, rids[0], "Text", outBuffer), success)
+                                    << "Reading an attribute of a moved record should succeed.";
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, 1 + sizeof(int) + 10), 0) << "Returned Data should be the same";
+
+        // A scan reports the moved record once, under its original RID
+        PeterDB::RBFM_ScanIterator rbfmScanIterator;
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "", PeterDB::NO_OP, nullptr, {"Text"}, rbfmScanIterator),
+                  success) << "Opening a scan should succeed.";
+        unsigned count = 0, movedCount = 0;
+        while (rbfmScanIterator.getNextRecord(rid, outBuffer) != RBFM_EOF) {
+            count++;
+            if (rid.pageNum == rids[0].pageNum && rid.slotNum == rids[0].slotNum) {
+                movedCount++;
+                ASSERT_EQ(memcmp(inBuffer, outBuffer, 1 + sizeof(int) + 10), 0) << "Returned Data should be the same";
+            }
+        }
+        ASSERT_EQ(rbfmScanIterator.close(), success) << "Closing a scan should succeed.";
+        ASSERT_EQ(count, 5) << "Every record should be returned once.";
+        ASSERT_EQ(movedCount, 1) << "The moved record should be returned under its original RID.";
+
+        // Deleting the moved record removes it everywhere
+        ASSERT_EQ(rbfm.deleteRecord(fileHandle, recordDescriptor, rids[0]), success)
+                                    << "Deleting a record should succeed.";
+        ASSERT_NE(rbfm.readRecord(fileHandle, recordDescriptor, rids[0], outBuffer), success)
+                                    << "Reading a deleted record should not succeed.";
+        ASSERT_NE(rbfm.updateRecord(fileHandle, recordDescriptor, inBuffer, rids[0]), success)
+                                    << "Updating a deleted record should not succeed.";
+        ASSERT_NE(rbfm.deleteRecord(fileHandle, recordDescriptor, rids[0]), success)
+                                    << "Deleting a deleted record should not succeed.";
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "", PeterDB::NO_OP, nullptr, {"Text"}, rbfmScanIterator),
+                  success) << "Opening a scan should succeed.";
+        count = 0;
+        while (rbfmScanIterator.getNextRecord(rid, outBuffer) != RBFM_EOF) {
+            count++;
+        }
+        ASSERT_EQ(rbfmScanIterator.close(), success) << "Closing a scan should succeed.";
+        ASSERT_EQ(count, 4) << "The deleted record should not be returned.";
+
+        prepareVarCharRecord(1000, 'b', inBuffer);
+        ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rids[1], outBuffer), success)
+                                    << "Reading a record should succeed.";
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, 1 + sizeof(int) + 1000), 0) << "Other records should be untouched.";
+
+    }
+
+    TEST_F(RBFM_Test, deletes_are_reclaimed_by_compaction_and_slot_reuse) {
+        // Functions tested
+        // 1. Fill a page with records
+        // 2. Delete every other record
+        // 3. Insert a record that only fits after compaction, into a reused slot
+        // 4. Read every remaining Record
+
+        std::vector<PeterDB::Attribute> recordDescriptor = {{"Text", PeterDB::TypeVarChar, 3500}};
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+
+        std::vector<PeterDB::RID> rids;
+        PeterDB::RID rid;
+        for (int i = 0; i < 8; i++) {
+            prepareVarCharRecord(480, 'a' + i, inBuffer);
+            ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                        << "Inserting a record should succeed.";
+            ASSERT_EQ(rid.pageNum, 0) << "The records should share a page.";
+            rids.push_back(rid);
+        }
+
+        for (int i = 0; i < 8; i += 2) {
+            ASSERT_EQ(rbfm.deleteRecord(fileHandle, recordDescriptor, rids[i]), success)
+                                        << "Deleting a record should succeed.";
+        }
+
+        // 1500 bytes do not fit in any single hole, only in the compacted page
+        prepareVarCharRecord(1500, 'z', inBuffer);
+        ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                    << "Inserting a record should succeed.";
+        ASSERT_EQ(fileHandle.getNumberOfPages(), 1) << "The freed space should have been reused.";
+        ASSERT_EQ(rid.pageNum, 0) << "The record should go to the compacted page.";
+        ASSERT_EQ(rid.slotNum, rids[0].slotNum) << "The first empty slot should be reused.";
+
+        ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rid, outBuffer), success)
+                                    << "Reading a record should succeed.";
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, 1 + sizeof(int) + 1500), 0) << "Returned Data should be the same";
+        for (int i = 1; i < 8; i += 2) {
+            prepareVarCharRecord(480, 'a' + i, inBuffer);
+            ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rids[i], outBuffer), success)
+                                        << "Reading a record should succeed.";
+            ASSERT_EQ(memcmp(inBuffer, outBuffer, 1 + sizeof(int) + 480), 0)
+                                        << "Records should keep their RIDs across compaction.";
+        }
+        ASSERT_NE(rbfm.readRecord(fileHandle, recordDescriptor, rids[2], outBuffer), success)
+                                    << "Reading a deleted record should not succeed.";
+
+        // Emptying the last slots shrinks the directory
+        ASSERT_EQ(rbfm.deleteRecord(fileHandle, recordDescriptor, rids[7]), success)
+                                    << "Deleting a record should succeed.";
+        ASSERT_NE(rbfm.readRecord(fileHandle, recordDescriptor, rids[7], outBuffer), success)
+                                    << "Reading a deleted record should not succeed.";
+
+    }
+
+    TEST_F(RBFM_Test, stale_free_space_entry_falls_back_to_a_new_page) {
+        // Functions tested
+        // 1. Fill a page with records
+        // 2. Make its free-space map entry claim room the page does not have
+        // 3. Insert a record: it goes to a new page and the entry is corrected
+        // 4. Read every Record
+
+        std::vector<PeterDB::Attribute> recordDescriptor = {{"Text", PeterDB::TypeVarChar, 3500}};
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+
+        std::vector<PeterDB::RID> rids;
+        PeterDB::RID rid;
+        for (int i = 0; i < 8; i++) {
+            prepareVarCharRecord(480, 'a' + i, inBuffer);
+            ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                        << "Inserting a record should succeed.";
+            ASSERT_EQ(rid.pageNum, 0) << "The records should share a page.";
+            rids.push_back(rid);
+        }
+        ASSERT_EQ(fileHandle.setFreeSpace(0, PAGE_SIZE / 2), success) << "Setting the free space should succeed.";
+
+        prepareVarCharRecord(1500, 'z', inBuffer);
+        ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                    << "Inserting a record should succeed.";
+        ASSERT_EQ(rid.pageNum, 1) << "The record should go to a new page.";
+        ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rid, outBuffer), success)
+                                    << "Reading a record should succeed.";
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, 1 + sizeof(int) + 1500), 0) << "Returned Data should be the same";
+
+        PeterDB::PageNum pageNum;
+        ASSERT_EQ(fileHandle.findPageWithFreeSpace(1000, pageNum), success) << "A page should have room.";
+        ASSERT_EQ(pageNum, 1) << "The full page should no longer be offered.";
+        for (int i = 0; i < 8; i++) {
+            prepareVarCharRecord(480, 'a' + i, inBuffer);
+            ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rids[i], outBuffer), success)
+                                        << "Reading a record should succeed.";
+            ASSERT_EQ(memcmp(inBuffer, outBuffer, 1 + sizeof(int) + 480), 0)
+                                        << "The full page should be left as it was.";
+        }
+
+    }
+
+    TEST_F(RBFM_Test, vacuum_resolves_forwards_and_rewrites_densely) {
+        // Functions tested
+        // 1. Spread records over pages, move one and delete most of the others
+        // 2. Online vacuum: the moved record comes home and RIDs stay valid
+        // 3. Offline vacuum: the file is rewritten into fewer pages under new RIDs
+
+        std::vector<PeterDB::Attribute> recordDescriptor = {{"Text", PeterDB::TypeVarChar, 3500}};
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+
+        std::vector<PeterDB::RID> rids;
+        PeterDB::RID rid;
+        for (int i = 0; i < 8; i++) {
+            prepareVarCharRecord(1000, 'a' + i, inBuffer);
+            ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                        << "Inserting a record should succeed.";
+            ASSERT_EQ(rid.pageNum, i / 4) << "Four records should fit on a page.";
+            rids.push_back(rid);
+        }
+
+        prepareVarCharRecord(2000, 'x', inBuffer);
+        ASSERT_EQ(rbfm.updateRecord(fileHandle, recordDescriptor, inBuffer, rids[0]), success)
+                                    << "Updating a record should succeed.";
+        ASSERT_EQ(fileHandle.getNumberOfPages(), 3) << "The record should have moved to a new page.";
+        for (int i : {1, 2, 5, 6, 7}) {
+            ASSERT_EQ(rbfm.deleteRecord(fileHandle, recordDescriptor, rids[i]), success)
+                                        << "Deleting a record should succeed.";
+        }
+
+        PeterDB::VacuumStats stats;
+        ASSERT_EQ(rbfm.vacuum(fileHandle, recordDescriptor, stats), success) << "Online vacuum should succeed.";
+        ASSERT_EQ(stats.recordsMoved, 1) << "The moved record should have been brought home.";
+        ASSERT_EQ(stats.pagesReclaimed, 1) << "The page it had moved to should be empty.";
+        ASSERT_EQ(stats.pagesAfter, 3) << "An online vacuum does not shrink the file.";
+        ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rids[0], outBuffer), success)
+                                    << "Reading the record should succeed.";
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, 1 + sizeof(int) + 2000), 0) << "Returned Data should be the same";
+
+        // The empty page is handed out again
+        prepareVarCharRecord(3000, 'y', inBuffer);
+        ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                    << "Inserting a record should succeed.";
+        ASSERT_EQ(rid.pageNum, 2) << "The emptied page should be reused.";
+        ASSERT_EQ(rbfm.deleteRecord(fileHandle, recordDescriptor, rid), success)
+                                    << "Deleting a record should succeed.";
+
+        // Offline vacuum needs the file closed
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+        std::vector<std::pair<PeterDB::RID, PeterDB::RID>> ridMap;
+        ASSERT_EQ(rbfm.vacuumFile(fileName, recordDescriptor, ridMap, stats), success)
+                                    << "Offline vacuum should succeed.";
+        ASSERT_EQ(stats.pagesBefore, 3);
+        ASSERT_EQ(stats.pagesAfter, 1) << "The three live records should fit on one page.";
+        ASSERT_EQ(stats.pagesReclaimed, 2);
+        ASSERT_EQ(ridMap.size(), 3) << "Every live record should be mapped to its new RID.";
+        ASSERT_FALSE(fileExists(fileName + ".vacuum")) << "The rewritten file should have replaced the old one.";
+
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+        ASSERT_EQ(fileHandle.getNumberOfPages(), 1);
+        for (const std::pair<PeterDB::RID, PeterDB::RID> &entry : ridMap) {
+            int index = 0;
+            while (rids[index].pageNum != entry.first.pageNum || rids[index].slotNum != entry.first.slotNum)
+                index++;
+            if (index == 0)
+                prepareVarCharRecord(2000, 'x', inBuffer);
+            else
+                prepareVarCharRecord(1000, 'a' + index, inBuffer);
+            ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, entry.second, outBuffer), success)
+                                        << "Reading a record under its new RID should succeed.";
+            ASSERT_EQ(memcmp(inBuffer, outBuffer, 1 + sizeof(int) + (index == 0 ? 2000 : 1000)), 0)
+                                        << "Returned Data should be the same";
+        }
+
+    }
+
+    TEST_F(RBFM_Test, zone_map_skips_extents_that_cannot_match) {
+        // Functions tested
+        // 1. Bulk insert records with an increasing key over several extents
+        // 2. Reopen the file and run a selective range scan; only the last extent is read
+        // 3. Update a record of the first extent into the range and scan again
+        // 4. Lose the zone map file; the next conditional scan rebuilds it
+        // 5. Rewrite a page through a plain FileHandle; the saved zone map is no longer trusted
+
+        std::vector<PeterDB::Attribute> recordDescriptor = {{"Key", PeterDB::TypeInt, 4},
+                                                            {"Text", PeterDB::TypeVarChar, 200}};
+        unsigned recordSize = 1 + sizeof(int) + sizeof(int) + 200;
+        unsigned numRecords = 1200;
+        std::vector<char> records(numRecords * recordSize, 0);
+        std::vector<const void *> recordPtrs;
+        for (unsigned i = 0; i < numRecords; i++) {
+            char *record = records.data() + i * recordSize;
+            int key = i, length = 200;
+            memcpy(record + 1, &key, sizeof(int));
+            memcpy(record + 1 + sizeof(int), &length, sizeof(int));
+            memset(record + 1 + 2 * sizeof(int), 'a' + i % 26, length);
+            recordPtrs.push_back(record);
+        }
+        std::vector<PeterDB::RID> rids;
+        ASSERT_EQ(rbfm.insertRecords(fileHandle, recordDescriptor, recordPtrs, rids), success)
+                                    << "Inserting records should succeed.";
+        unsigned numPages = fileHandle.getNumberOfPages();
+        ASSERT_GT(numPages, 3 * ZONE_MAP_EXTENT_PAGES) << "The records should span several extents.";
+
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+        ASSERT_TRUE(fileExists(fileName + ".zonemap")) << "The zone map should be saved with the file.";
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+
+        outBuffer = malloc(PAGE_SIZE);
+        auto countMatches = [&](int lowKey, unsigned &pagesRead) {
+            unsigned readBefore, writeCount, appendCount;
+            fileHandle.collectCounterValues(readBefore, writeCount, appendCount);
+            PeterDB::RBFM_ScanIterator rbfmScanIterator;
+            EXPECT_EQ(rbfm.scan(fileHandle, recordDescriptor, "Key", PeterDB::GE_OP, &lowKey, {"Key"},
+                                rbfmScanIterator), success) << "Opening a scan should succeed.";
+            unsigned count = 0;
+            PeterDB::RID rid;
+            while (rbfmScanIterator.getNextRecord(rid, outBuffer) != RBFM_EOF) {
+                int key;
+                memcpy(&key, (char *) outBuffer + 1, sizeof(int));
+                EXPECT_GE(key, lowKey) << "Every returned record should satisfy the condition.";
+                count++;
+            }
+            rbfmScanIterator.close();
+            unsigned readAfter;
+            fileHandle.collectCounterValues(readAfter, writeCount, appendCount);
+            pagesRead = readAfter - readBefore;
+            return count;
+        };
+
+        unsigned pagesRead;
+        ASSERT_EQ(countMatches(numRecords - 10, pagesRead), 10) << "The scan should find the last records.";
+        ASSERT_LE(pagesRead, ZONE_MAP_EXTENT_PAGES) << "Only the last extent should be read.";
+
+        // Moving a key of the first extent into the range widens that extent's summary
+        int key = numRecords + 100;
+        memcpy(records.data() + 1, &key, sizeof(int));
+        ASSERT_EQ(rbfm.updateRecord(fileHandle, recordDescriptor, records.data(), rids[0]), success)
+                                    << "Updating a record should succeed.";
+        ASSERT_EQ(countMatches(numRecords - 10, pagesRead), 11) << "The updated record should be found.";
+
+        // Without its zone map file the summary is rebuilt by the first conditional scan
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+        remove((fileName + ".zonemap").c_str());
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+        ASSERT_EQ(countMatches(numRecords - 10, pagesRead), 11) << "The rebuilt summary should keep every match.";
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+        ASSERT_EQ(countMatches(numRecords - 10, pagesRead), 11) << "The saved summary should keep every match.";
+        ASSERT_LE(pagesRead, 2 * ZONE_MAP_EXTENT_PAGES) << "Only the first and the last extent should be read.";
+
+        // The last page copied over a page of the second extent keeps the page count but not the write generation
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+        PeterDB::PagedFileManager &pfm = PeterDB::PagedFileManager::instance();
+        PeterDB::FileHandle pageHandle;
+        std::vector<char> page(PAGE_SIZE);
+        ASSERT_EQ(pfm.openFile(fileName, pageHandle), success) << "Opening the file should not fail.";
+        ASSERT_EQ(pageHandle.readPage(numPages - 1, page.data()), success) << "Reading a page should succeed.";
+        ASSERT_EQ(pageHandle.writePage(ZONE_MAP_EXTENT_PAGES, page.data()), success)
+                                    << "Writing a page should succeed.";
+        ASSERT_EQ(pfm.closeFile(pageHandle), success) << "Closing the file should not fail.";
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+        ASSERT_GT(countMatches(numRecords - 10, pagesRead), 11) << "The copied records should be found too.";
+
+    }
+
+    TEST_F(RBFM_Test, pax_layout_stores_columns_in_minipages) {
+        // Functions tested
+        // 1. Create a PAX file and insert records with nulls and varying lengths
+        // 2. Read records and single attributes back; record views are refused
+        // 3. Delete and update records, then run a conditional scan
+        // 4. Read one column chunk by chunk straight from its minipages
+
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+        ASSERT_EQ(rbfm.destroyFile(fileName), success) << "Destroying the file should not fail.";
+        ASSERT_EQ(rbfm.createFile(fileName, PeterDB::LAYOUT_PAX), success) << "Creating a PAX file should succeed.";
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+
+        unsigned numRecords = 300;
+        auto makeRecord = [&](unsigned i, int age, void *buffer, size_t &recordSize) {
+            std::string name(1 + i % 30, 'a' + i % 26);
+            nullsIndicator[0] = i % 7 == 0 ? 0x40 : 0;
+            prepareRecord((int) recordDescriptor.size(), nullsIndicator, (int) name.length(), name, age,
+                          150.0 + i, (int) i * 10, buffer, recordSize);
+        };
+
+        inBuffer = malloc(100);
+        outBuffer = malloc(100);
+        std::vector<PeterDB::RID> rids;
+        for (unsigned i = 0; i < numRecords; i++) {
+            size_t recordSize;
+            PeterDB::RID rid;
+            makeRecord(i, (int) i % 100, inBuffer, recordSize);
+            ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                        << "Inserting a record should succeed.";
+            rids.push_back(rid);
+        }
+        ASSERT_GT(fileHandle.getNumberOfPages(), 1) << "The records should span several pages.";
+
+        for (unsigned i = 0; i < numRecords; i++) {
+            size_t recordSize;
+            makeRecord(i, (int) i % 100, inBuffer, recordSize);
+            ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rids[i], outBuffer), success)
+                                        << "Reading a record should succeed.";
+            ASSERT_EQ(memcmp(inBuffer, outBuffer, recordSize), 0) << "Returned Data should be the same";
+
+            int salary;
+            ASSERT_EQ(rbfm.readAttribute(fileHandle, recordDescriptor, rids[i], "Salary", outBuffer), success)
+                                        << "Reading an attribute should succeed.";
+            memcpy(&salary, (char *) outBuffer + 1, sizeof(int));
+            ASSERT_EQ(salary, (int) i * 10) << "The attribute should come from its own minipage.";
+        }
+
+        PeterDB::RecordView view;
+        ASSERT_NE(rbfm.readRecordView(fileHandle, rids[1], view), success)
+                                    << "Record views should not be available for PAX files.";
+
+        // Delete every third record and give some of the others a larger age
+        std::vector<int> ages(numRecords);
+        std::vector<bool> live(numRecords, true);
+        for (unsigned i = 0; i < numRecords; i++) {
+            ages[i] = (int) i % 100;
+            if (i % 3 == 0) {
+                ASSERT_EQ(rbfm.deleteRecord(fileHandle, recordDescriptor, rids[i]), success)
+                                            << "Deleting a record should succeed.";
+                live[i] = false;
+            } else if (i % 5 == 0) {
+                size_t recordSize;
+                ages[i] += 100;
+                makeRecord(i, ages[i], inBuffer, recordSize);
+                ASSERT_EQ(rbfm.updateRecord(fileHandle, recordDescriptor, inBuffer, rids[i]), success)
+                                            << "Updating a record in place should succeed.";
+            }
+        }
+        ASSERT_NE(rbfm.readRecord(fileHandle, recordDescriptor, rids[3], outBuffer), success)
+                                    << "A deleted record should not be readable.";
+
+        unsigned expectedMatches = 0;
+        long expectedSum = 0;
+        for (unsigned i = 0; i < numRecords; i++) {
+            if (live[i] && i % 7 != 0) {
+                expectedSum += ages[i];
+                expectedMatches += ages[i] >= 50 ? 1 : 0;
+            }
+        }
+
+        int lowAge = 50;
+        PeterDB::RBFM_ScanIterator rbfmScanIterator;
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "Age", PeterDB::GE_OP, &lowAge, {"Age", "Salary"},
+                            rbfmScanIterator), success) << "Opening a scan should succeed.";
+        unsigned matches = 0;
+        PeterDB::RID rid;
+        while (rbfmScanIterator.getNextRecord(rid, outBuffer) != RBFM_EOF) {
+            int age, salary;
+            memcpy(&age, (char *) outBuffer + 1, sizeof(int));
+            memcpy(&salary, (char *) outBuffer + 1 + sizeof(int), sizeof(int));
+            ASSERT_GE(age, lowAge) << "Every returned record should satisfy the condition.";
+            ASSERT_EQ(ages[salary / 10], age) << "The projected fields should belong to the same row.";
+            matches++;
+        }
+        rbfmScanIterator.close();
+        ASSERT_EQ(matches, expectedMatches) << "The scan should find every satisfying record.";
+
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "", PeterDB::NO_OP, nullptr, {"Age"},
+                            rbfmScanIterator), success) << "Opening a scan should succeed.";
+        long sum = 0;
+        std::vector<PeterDB::RID> chunkRids;
+        std::vector<char> values;
+        while (rbfmScanIterator.getNextColumnChunk(chunkRids, values) != RBFM_EOF) {
+            ASSERT_EQ(values.size(), chunkRids.size() * sizeof(int)) << "Ages should be packed back to back.";
+            for (unsigned i = 0; i < chunkRids.size(); i++) {
+                int age;
+                memcpy(&age, values.data() + i * sizeof(int), sizeof(int));
+                sum += age;
+            }
+        }
+        rbfmScanIterator.close();
+        ASSERT_EQ(sum, expectedSum) << "The column chunks should hold every non-null live value.";
+
+    }
+
+    TEST_F(RBFM_Test, record_codec_round_trips_fixed_and_variable_records) {
+        // Functions tested
+        // 1. Encode and decode fixed-size records with and without nulls through a codec
+        // 2. Insert and read them back; scan them with every attribute projected
+        // 3. A codec only depends on the types and lengths of its descriptor
+
+        std::vector<PeterDB::Attribute> recordDescriptor = {{"A", PeterDB::TypeInt, 4},
+                                                            {"B", PeterDB::TypeReal, 4},
+                                                            {"C", PeterDB::TypeInt, 4}};
+        PeterDB::RecordCodec codec(recordDescriptor);
+        std::vector<PeterDB::Attribute> renamed = recordDescriptor;
+        renamed[1].name = "Other";
+        ASSERT_TRUE(codec.matches(renamed)) << "Attribute names should not matter to a codec.";
+        renamed[1].type = PeterDB::TypeVarChar;
+        ASSERT_FALSE(codec.matches(renamed)) << "Attribute types should matter to a codec.";
+
+        unsigned recordSize = 1 + 3 * sizeof(int);
+        unsigned numRecords = 200;
+        std::vector<char> records(numRecords * recordSize, 0);
+        std::vector<unsigned> sizes(numRecords);
+        for (unsigned i = 0; i < numRecords; i++) {
+            char *record = records.data() + i * recordSize;
+            int a = i, c = -(int) i;
+            float b = i / 4.0f;
+            unsigned offset = 1;
+            record[0] = i % 4 == 0 ? (char) 0x40 : 0; // Every fourth record has a null B
+            memcpy(record + offset, &a, sizeof(int));
+            offset += sizeof(int);
+            if (i % 4 != 0) {
+                memcpy(record + offset, &b, sizeof(float));
+                offset += sizeof(float);
+            }
+            memcpy(record + offset, &c, sizeof(int));
+            sizes[i] = offset + sizeof(int);
+        }
+
+        std::vector<char> image(codec.getMaxRecordSize());
+        std::vector<char> decoded(recordSize);
+        for (unsigned i = 0; i < numRecords; i++) {
+            const char *record = records.data() + i * recordSize;
+            unsigned imageSize = codec.encode(record, image.data());
+            ASSERT_EQ(imageSize, 4 + 1 + 3 * 4 + sizes[i] - 1) << "The stored size should follow the header.";
+            ASSERT_EQ(codec.decode(image.data(), decoded.data()), (int) sizes[i]) << "Decoding should give the API size.";
+            ASSERT_EQ(memcmp(decoded.data(), record, sizes[i]), 0) << "Decoding should undo encoding.";
+        }
+
+        std::vector<PeterDB::RID> rids;
+        for (unsigned i = 0; i < numRecords; i++) {
+            PeterDB::RID rid;
+            ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, records.data() + i * recordSize, rid), success)
+                                        << "Inserting a record should succeed.";
+            rids.push_back(rid);
+        }
+        outBuffer = malloc(PAGE_SIZE);
+        for (unsigned i = 0; i < numRecords; i++) {
+            ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rids[i], outBuffer), success)
+                                        << "Reading a record should succeed.";
+            ASSERT_EQ(memcmp(outBuffer, records.data() + i * recordSize, sizes[i]), 0)
+                                        << "Returned Data should be the same";
+        }
+
+        std::ostringstream stream;
+        ASSERT_EQ(rbfm.printRecord(recordDescriptor, records.data() + 4 * recordSize, stream), success)
+                                    << "Printing a record should succeed.";
+        checkPrintRecord("A: 4, B: NULL, C: -4", stream.str());
+
+        PeterDB::RBFM_ScanIterator rbfmScanIterator;
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "", PeterDB::NO_OP, nullptr, {"A", "B", "C"},
+                            rbfmScanIterator), success) << "Opening a scan should succeed.";
+        std::vector<PeterDB::RID> batchRids;
+        std::vector<unsigned> offsets;
+        unsigned scanned = 0;
+        while (rbfmScanIterator.getNextBatch(batchRids, outBuffer, 64, PAGE_SIZE, offsets) != RBFM_EOF) {
+            for (unsigned i = 0; i < batchRids.size(); i++) {
+                unsigned index = scanned + i;
+                ASSERT_EQ(offsets[i + 1] - offsets[i], sizes[index]) << "Each record should keep its size.";
+                ASSERT_EQ(memcmp((char *) outBuffer + offsets[i], records.data() + index * recordSize, sizes[index]),
+                          0) << "Scanned data should be the same";
+            }
+            scanned += batchRids.size();
+        }
+        rbfmScanIterator.close();
+        ASSERT_EQ(scanned, numRecords) << "The scan should return every record.";
+
+    }
+
+    TEST_F(RBFM_Test, steady_state_inserts_and_reads_do_not_allocate) {
+        // Functions tested
+        // 1. Insert, read and delete records once to warm up the codec cache and the scratch buffers
+        // 2. Insert the records again into the pages freed by the deletes and read them back
+        // 3. No heap allocation happens in the second round
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+
+        unsigned numRecords = 150;
+        unsigned recordSize = 100;
+        std::vector<char> records(numRecords * recordSize);
+        std::vector<size_t> sizes(numRecords);
+        for (unsigned i = 0; i < numRecords; i++) {
+            std::string name = "Anteater" + std::to_string(i);
+            prepareRecord((int) recordDescriptor.size(), nullsIndicator, (int) name.length(), name, (int) i, 177.8,
+                          (int) i * 10, records.data() + i * recordSize, sizes[i]);
+        }
+        std::vector<PeterDB::RID> rids(numRecords);
+        outBuffer = malloc(PAGE_SIZE);
+
+        auto insertAndRead = [&]() {
+            unsigned failures = 0;
+            for (unsigned i = 0; i < numRecords; i++) {
+                failures += rbfm.insertRecord(fileHandle, recordDescriptor, records.data() + i * recordSize,
+                                              rids[i]) != success;
+            }
+            for (unsigned i = 0; i < numRecords; i++) {
+                failures += rbfm.readRecord(fileHandle, recordDescriptor, rids[i], outBuffer) != success;
+                failures += memcmp(outBuffer, records.data() + i * recordSize, sizes[i]) != 0;
+            }
+            return failures;
+        };
+        auto deleteAll = [&]() {
+            unsigned failures = 0;
+            for (unsigned i = 0; i < numRecords; i++)
+                failures += rbfm.deleteRecord(fileHandle, recordDescriptor, rids[i]) != success;
+            return failures;
+        };
+
+        ASSERT_EQ(insertAndRead(), 0) << "Inserting and reading records should succeed.";
+        ASSERT_EQ(deleteAll(), 0) << "Deleting records should succeed.";
+        unsigned numPages = fileHandle.getNumberOfPages();
+
+        unsigned long allocationsBefore = heapAllocations;
+        unsigned failures = insertAndRead();
+        unsigned long allocations = heapAllocations - allocationsBefore;
+        ASSERT_EQ(failures, 0) << "Inserting and reading records should succeed.";
+        ASSERT_EQ(fileHandle.getNumberOfPages(), numPages) << "The records should reuse the freed pages.";
+        ASSERT_EQ(allocations, 0) << "Steady-state inserts and reads should not allocate.";
+
+    }
+
+    TEST_F(RBFM_Test, large_values_spill_to_overflow_pages) {
+        // Functions tested
+        // 1. Insert records larger than a page; their long values go to overflow pages
+        // 2. Read them back whole, by record and by attribute
+        // 3. A scan that does not project the long value never reads its overflow pages
+        // 4. Update records across the page limit, delete one, and vacuum online and offline
+
+        std::vector<PeterDB::Attribute> recordDescriptor = {{"Id", PeterDB::TypeInt, 4},
+                                                            {"Body", PeterDB::TypeVarChar, 20000},
+                                                            {"Tag", PeterDB::TypeVarChar, 50}};
+        std::vector<int> bodyLengths = {100, 5000, 12000, 3000, 9000, 20000};
+        auto prepare = [&](int id, int bodyLength, std::vector<char> &record) {
+            int tagLength = 3;
+            record.assign(1 + sizeof(int) * 3 + bodyLength + tagLength, 0);
+            char *field = record.data() + 1;
+            memcpy(field, &id, sizeof(int));
+            memcpy(field + sizeof(int), &bodyLength, sizeof(int));
+            for (int i = 0; i < bodyLength; i++)
+                field[sizeof(int) * 2 + i] = (char) ('a' + (i + id) % 26);
+            memcpy(field + sizeof(int) * 2 + bodyLength, &tagLength, sizeof(int));
+            memcpy(field + sizeof(int) * 3 + bodyLength, "tag", tagLength);
+        };
+
+        std::vector<std::vector<char>> records(bodyLengths.size());
+        std::vector<PeterDB::RID> rids(bodyLengths.size());
+        for (unsigned i = 0; i < bodyLengths.size(); i++) {
+            prepare(i, bodyLengths[i], records[i]);
+            ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, records[i].data(), rids[i]), success)
+                                        << "Inserting a large record should succeed.";
+        }
+        // The four values longer than a page hold 46000 characters, which need at least 12 overflow pages
+        unsigned numPages = fileHandle.getNumberOfPages();
+        ASSERT_GE(numPages, 12 + 1) << "Long values should have gone to overflow pages.";
+
+        outBuffer = malloc(30000);
+        for (unsigned i = 0; i < bodyLengths.size(); i++) {
+            ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rids[i], outBuffer), success)
+                                        << "Reading a large record should succeed.";
+            ASSERT_EQ(memcmp(outBuffer, records[i].data(), records[i].size()), 0) << "Returned Data should be the same";
+            ASSERT_EQ(rbfm.readAttribute(fileHandle, recordDescriptor, rids[i], "Body", outBuffer), success)
+                                        << "Reading a long value should succeed.";
+            ASSERT_EQ(memcmp((char *) outBuffer + 1, records[i].data() + 1 + sizeof(int), sizeof(int) + bodyLengths[i]),
+                      0) << "The whole value should be returned.";
+        }
+
+        auto scanPagesRead = [&](const std::vector<std::string> &attributes, unsigned &count) {
+            EXPECT_EQ(rbfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+            EXPECT_EQ(rbfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+            unsigned readBefore, readAfter, writeCount, appendCount;
+            fileHandle.collectCounterValues(readBefore, writeCount, appendCount);
+            PeterDB::RBFM_ScanIterator rbfmScanIterator;
+            EXPECT_EQ(rbfm.scan(fileHandle, recordDescriptor, "", PeterDB::NO_OP, nullptr, attributes,
+                                rbfmScanIterator), success) << "Opening a scan should succeed.";
+            PeterDB::RID rid;
+            count = 0;
+            while (rbfmScanIterator.getNextRecord(rid, outBuffer) != RBFM_EOF)
+                count++;
+            rbfmScanIterator.close();
+            fileHandle.collectCounterValues(readAfter, writeCount, appendCount);
+            return readAfter - readBefore;
+        };
+        unsigned count;
+        unsigned narrowPages = scanPagesRead({"Id", "Tag"}, count);
+        ASSERT_EQ(count, bodyLengths.size()) << "The scan should return every record.";
+        unsigned widePages = scanPagesRead({"Body"}, count);
+        ASSERT_EQ(count, bodyLengths.size()) << "The scan should return every record.";
+        ASSERT_LE(narrowPages + 12, widePages) << "Only a scan of the long value should read its overflow pages.";
+
+        // A condition on the long value reads it whole
+        std::vector<char> condition(records[5].begin() + 1 + sizeof(int), records[5].end() - sizeof(int) - 3);
+        PeterDB::RBFM_ScanIterator rbfmScanIterator;
+        ASSERT_EQ(rbfm.scan(fileHandle, recordDescriptor, "Body", PeterDB::EQ_OP, condition.data(), {"Id"},
+                            rbfmScanIterator), success) << "Opening a scan should succeed.";
+        PeterDB::RID rid;
+        ASSERT_NE(rbfmScanIterator.getNextRecord(rid, outBuffer), RBFM_EOF) << "The long value should match.";
+        ASSERT_EQ(rid.pageNum, rids[5].pageNum);
+        ASSERT_EQ(rid.slotNum, rids[5].slotNum);
+        ASSERT_EQ(rbfmScanIterator.getNextRecord(rid, outBuffer), RBFM_EOF) << "Only one record should match.";
+        rbfmScanIterator.close();
+
+        // Grow a small record past the page limit and shrink a large one below it
+        prepare(0, 15000, records[0]);
+        ASSERT_EQ(rbfm.updateRecord(fileHandle, recordDescriptor, records[0].data(), rids[0]), success)
+                                    << "Growing a record should succeed.";
+        prepare(2, 200, records[2]);
+        ASSERT_EQ(rbfm.updateRecord(fileHandle, recordDescriptor, records[2].data(), rids[2]), success)
+                                    << "Shrinking a record should succeed.";
+        ASSERT_EQ(rbfm.deleteRecord(fileHandle, recordDescriptor, rids[4]), success)
+                                    << "Deleting a large record should succeed.";
+        for (unsigned i : {0, 1, 2, 3, 5}) {
+            ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rids[i], outBuffer), success)
+                                        << "Reading a record should succeed.";
+            ASSERT_EQ(memcmp(outBuffer, records[i].data(), records[i].size()), 0) << "Returned Data should be the same";
+        }
+
+        PeterDB::VacuumStats stats;
+        ASSERT_EQ(rbfm.vacuum(fileHandle, recordDescriptor, stats), success) << "Online vacuum should succeed.";
+        ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rids[5], outBuffer), success)
+                                    << "Overflow pages should survive an online vacuum.";
+        ASSERT_EQ(memcmp(outBuffer, records[5].data(), records[5].size()), 0) << "Returned Data should be the same";
+
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+        std::vector<std::pair<PeterDB::RID, PeterDB::RID>> ridMap;
+        ASSERT_EQ(rbfm.vacuumFile(fileName, recordDescriptor, ridMap, stats), success)
+                                    << "Offline vacuum should succeed.";
+        ASSERT_EQ(ridMap.size(), 5) << "Every live record should be mapped to its new RID.";
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+        for (const std::pair<PeterDB::RID, PeterDB::RID> &entry : ridMap) {
+            unsigned index = 0;
+            while (rids[index].pageNum != entry.first.pageNum || rids[index].slotNum != entry.first.slotNum)
+                index++;
+            ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, entry.second, outBuffer), success)
+                                        << "Reading a record under its new RID should succeed.";
+            ASSERT_EQ(memcmp(outBuffer, records[index].data(), records[index].size()), 0)
+                                        << "Long values should be copied by an offline vacuum.";
+        }
+
+    }
+
+    TEST_F(RBFM_Test, larger_pages_keep_long_records_inline) {
+        // Functions tested
+        // 1. Records that would spill on default pages stay whole on 32 KB pages
+        // 2. A PAX file with 64 KB pages stores rows too large for a default PAX page
+        // 3. An offline vacuum keeps the page size of the file
+
+        std::vector<PeterDB::Attribute> recordDescriptor = {{"Id", PeterDB::TypeInt, 4},
+                                                            {"Body", PeterDB::TypeVarChar, 20000}};
+        std::vector<int> bodyLengths = {100, 5000, 12000, 3000, 9000, 20000};
+        std::vector<std::vector<char>> records(bodyLengths.size());
+        for (unsigned i = 0; i < bodyLengths.size(); i++) {
+            records[i].assign(1 + sizeof(int) * 2 + bodyLengths[i], 0);
+            memcpy(records[i].data() + 1, &i, sizeof(int));
+            memcpy(records[i].data() + 1 + sizeof(int), &bodyLengths[i], sizeof(int));
+            memset(records[i].data() + 1 + sizeof(int) * 2, 'a' + i, bodyLengths[i]);
+        }
+
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+        ASSERT_EQ(rbfm.destroyFile(fileName), success) << "Destroying the file should not fail.";
+        ASSERT_EQ(rbfm.createFile(fileName, PeterDB::LAYOUT_NSM, 8 * PAGE_SIZE), success)
+                                    << "Creating a file with 32 KB pages should succeed.";
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+        ASSERT_EQ(fileHandle.getPageSize(), 8 * PAGE_SIZE) << "The file should use 32 KB pages.";
+
+        std::vector<PeterDB::RID> rids(bodyLengths.size());
+        for (unsigned i = 0; i < bodyLengths.size(); i++) {
+            ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, records[i].data(), rids[i]), success)
+                                        << "Inserting a record should succeed.";
+        }
+        // 49100 characters fit in two 32 KB pages, with no overflow page
+        ASSERT_LE(fileHandle.getNumberOfPages(), 2) << "Every record should stay inline.";
+        outBuffer = malloc(30000);
+        for (unsigned i = 0; i < bodyLengths.size(); i++) {
+            ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rids[i], outBuffer), success)
+                                        << "Reading a record should succeed.";
+            ASSERT_EQ(memcmp(outBuffer, records[i].data(), records[i].size()), 0) << "Returned Data should be the same";
+        }
+
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+        ASSERT_EQ(rbfm.destroyFile(fileName), success) << "Destroying the file should not fail.";
+        ASSERT_EQ(rbfm.createFile(fileName, PeterDB::LAYOUT_PAX, MAX_PAGE_SIZE), success)
+                                    << "Creating a PAX file with 64 KB pages should succeed.";
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+        for (unsigned i = 0; i < bodyLengths.size(); i++) {
+            ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, records[i].data(), rids[i]), success)
+                                        << "A row larger than a default page should fit in a 64 KB PAX page.";
+        }
+        ASSERT_EQ(fileHandle.getNumberOfPages(), 1) << "Every row should share one page.";
+        ASSERT_EQ(rbfm.deleteRecord(fileHandle, recordDescriptor, rids[2]), success) << "Deleting should succeed.";
+        ASSERT_EQ(rbfm.closeFile(fileHandle), success) << "Closing the file should not fail.";
+
+        std::vector<std::pair<PeterDB::RID, PeterDB::RID>> ridMap;
+        PeterDB::VacuumStats stats;
+        ASSERT_EQ(rbfm.vacuumFile(fileName, recordDescriptor, ridMap, stats), success)
+                                    << "Offline vacuum should succeed.";
+        ASSERT_EQ(rbfm.openFile(fileName, fileHandle), success) << "Opening the file should not fail.";
+        ASSERT_EQ(fileHandle.getPageSize(), MAX_PAGE_SIZE) << "The rebuilt file should keep its page size.";
+        for (const std::pair<PeterDB::RID, PeterDB::RID> &entry : ridMap) {
+            unsigned index = entry.first.slotNum - 1;
+            ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, entry.second, outBuffer), success)
+                                        << "Reading a record under its new RID should succeed.";
+            ASSERT_EQ(memcmp(outBuffer, records[index].data(), records[index].size()), 0)
+                                        << "Returned Data should be the same";
+        }
+
+    }
+
+} // namespace PeterDBTesting